@@ -0,0 +1,343 @@
+/* ************************************************************
+AsyncLog.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "AsyncLog.h"
+#include "Trace.h"
+
+using namespace std;
+using namespace std::chrono;
+
+//Contact state into its 4 byte field, zero padded and not terminated
+static void packContact(char* to, const char* contact)
+{
+	char packed[4] = { 0, 0, 0, 0 };
+	for (int i = 0; (i < 4) && (contact[i] != '\0'); i++) {
+		packed[i] = contact[i];
+	}
+	memcpy(to, packed, 4);
+}
+
+AsyncLog::AsyncLog()
+	: stallLimit(2000), running(false), pushed(0), written(0), stalls(0), highWater(0),
+	flushRequested(false), flushed(0)
+{
+	for (int i = 0; i < LOG_SINKS; i++) {
+		dropped[i] = 0;
+	}
+	lastDebugWrite = steady_clock::now();
+}
+
+AsyncLog::~AsyncLog()
+{
+	Stop();
+}
+
+bool AsyncLog::OpenDebug(const char* filename)
+{
+	Flush();
+	debugFile.open(filename);
+	return debugFile.is_open();
+}
+
+void AsyncLog::Start()
+{
+	if (!running) {
+		running = true;
+		writer = thread(&AsyncLog::Run, this);
+	}
+}
+
+void AsyncLog::Stop()
+{
+	if (running) {
+		{
+			lock_guard<mutex> guard(lock);
+			running = false;
+		}
+		wake.notify_one();
+		writer.join();
+	}
+	Drain();
+	WriteOut(true);
+}
+
+void AsyncLog::Flush()
+{
+	if (!running) {
+		Drain();
+		WriteOut(true);
+		return;
+	}
+
+	uint64_t target = pushed;
+	unique_lock<mutex> guard(lock);
+	flushRequested = true;
+	wake.notify_one();
+	done.wait(guard, [&] { return flushed >= target; });
+}
+
+bool AsyncLog::OpenTrial(const string& filename, int trial, const char* project, int markers)
+{
+	//The writer is idle once Flush returns, and only picks the trial log
+	//up again after the next record is queued
+	Flush();
+	return trialLog.Open(filename, trial, project, markers);
+}
+
+void AsyncLog::CloseTrial()
+{
+	Flush();
+	trialLog.Close();
+}
+
+/*********************************************************************
+
+Control thread side
+
+*********************************************************************/
+
+bool AsyncLog::Reserve(int count, LogSink sink, bool wait)
+{
+	size_t queued = ring.Size();
+	if (LOG_RING_SIZE - queued < (size_t)count) {
+		if (!wait) {
+			dropped[sink]++;
+			return false;
+		}
+
+		//back pressure: give the writer a moment to make room
+		stalls++;
+		steady_clock::time_point deadline = steady_clock::now() + microseconds(stallLimit);
+		while (LOG_RING_SIZE - queued < (size_t)count) {
+			if (steady_clock::now() > deadline) {
+				dropped[sink]++;
+				return false;
+			}
+			this_thread::yield();
+			queued = ring.Size();
+		}
+	}
+
+	if (queued + count > highWater) {
+		highWater = queued + count;
+	}
+	return true;
+}
+
+void AsyncLog::Put(const LogRecord& record)
+{
+	ring.Push(record);
+	pushed++;
+}
+
+void AsyncLog::Text(LogSink sink, const char* text)
+{
+	size_t length = strlen(text);
+	int count = (length == 0) ? 1 : (int)((length + LOG_TEXT_LENGTH - 1) / LOG_TEXT_LENGTH);
+	if (!Reserve(count, sink, sink == LOG_TRIAL)) {
+		return;
+	}
+
+	//long lines are split over several records
+	LogRecord record;
+	record.type = LOG_RECORD_TEXT;
+	record.sink = sink;
+	record.id = 0;
+	for (int i = 0; i < count; i++) {
+		size_t n = min(length - i * LOG_TEXT_LENGTH, (size_t)LOG_TEXT_LENGTH);
+		memcpy(record.text, text + i * LOG_TEXT_LENGTH, n);
+		record.length = (uint8_t)n;
+		record.flags = (i < count - 1) ? LOG_CONTINUE : 0;
+		Put(record);
+	}
+}
+
+void AsyncLog::Value(LogSink sink, const char* label, double value, bool endLine)
+{
+	if (!Reserve(1, sink, sink == LOG_TRIAL)) {
+		return;
+	}
+
+	LogRecord record;
+	record.type = LOG_RECORD_VALUE;
+	record.sink = sink;
+	record.flags = endLine ? 0 : LOG_CONTINUE;
+	record.id = 0;
+	size_t n = min(strlen(label), (size_t)LOG_LABEL_LENGTH);
+	memcpy(record.value.label, label, n);
+	record.length = (uint8_t)n;
+	record.value.value = value;
+	Put(record);
+}
+
+void AsyncLog::Marker(double t, int id, float x, float y, float z, const char* contact)
+{
+	if (!Reserve(1, LOG_TRIAL, true)) {
+		return;
+	}
+
+	LogRecord record;
+	record.type = LOG_RECORD_MARKER;
+	record.sink = LOG_TRIAL;
+	record.flags = 0;
+	record.length = 0;
+	record.id = id;
+	record.marker.t = t;
+	record.marker.x = x;
+	record.marker.y = y;
+	record.marker.z = z;
+	packContact(record.marker.contact, contact);
+	Put(record);
+}
+
+void AsyncLog::Frame(const MarkerFrame* frame, const char* contact)
+{
+	//a frame is logged whole or not at all
+	if (!Reserve(frame->count, LOG_TRIAL, true)) {
+		return;
+	}
+
+	LogRecord record;
+	record.type = LOG_RECORD_MARKER;
+	record.sink = LOG_TRIAL;
+	record.flags = 0;
+	record.length = 0;
+	record.marker.t = frame->time;
+	packContact(record.marker.contact, contact);
+	for (int i = 0; i < frame->count; i++) {
+		record.id = frame->id[i];
+		record.marker.x = frame->x[i];
+		record.marker.y = frame->y[i];
+		record.marker.z = frame->z[i];
+		Put(record);
+	}
+}
+
+/*********************************************************************
+
+Writer thread side
+
+*********************************************************************/
+
+void AsyncLog::Run()
+{
+	unique_lock<mutex> guard(lock, defer_lock);
+	Trace::NameThread("log writer");
+
+	while (true) {
+		Drain();
+
+		guard.lock();
+		bool flushing = flushRequested;
+		bool stopping = !running;
+		guard.unlock();
+
+		WriteOut(flushing || stopping);
+
+		if (flushing || stopping) {
+			//anything queued after the request goes in the next pass
+			if (ring.Size() != 0) {
+				continue;
+			}
+			if (stopping) {
+				break;
+			}
+			guard.lock();
+			flushed = written;
+			flushRequested = false;
+			guard.unlock();
+			done.notify_all();
+		}
+
+		guard.lock();
+		wake.wait_for(guard, milliseconds(2), [&] { return flushRequested || !running; });
+		guard.unlock();
+	}
+
+	guard.lock();
+	flushed = written;
+	flushRequested = false;
+	guard.unlock();
+	done.notify_all();
+}
+
+void AsyncLog::Drain()
+{
+	LogRecord record;
+	uint64_t count = 0;
+	while (ring.Pop(&record)) {
+		Write(record);
+		count++;
+		if ((buffer[LOG_CONSOLE].size() >= LOG_BATCH_BYTES) || (buffer[LOG_DEBUG].size() >= LOG_BATCH_BYTES)) {
+			WriteOut(false);
+		}
+	}
+	written += count;
+}
+
+void AsyncLog::Write(const LogRecord& record)
+{
+	string& line = (record.sink == LOG_TRIAL) ? annotation : buffer[record.sink];
+
+	switch (record.type) {
+	case LOG_RECORD_MARKER:
+		trialLog.Append(record.marker.t, record.id, record.marker.x, record.marker.y, record.marker.z, record.marker.contact);
+		return;
+
+	case LOG_RECORD_TEXT:
+		line.append(record.text, record.length);
+		break;
+
+	case LOG_RECORD_VALUE: {
+		//%g with 6 digits, the same as cout << value
+		char digits[32];
+		to_chars_result result = to_chars(digits, digits + sizeof(digits), record.value.value, chars_format::general, 6);
+		line.append(record.value.label, record.length);
+		line.append(digits, result.ptr - digits);
+		break;
+	}
+	}
+
+	if (record.flags & LOG_CONTINUE) {
+		return;
+	}
+	if (record.sink == LOG_TRIAL) {
+		trialLog.Annotate(annotation);
+		annotation.clear();
+	}
+	else {
+		line += '\n';
+	}
+}
+
+void AsyncLog::WriteOut(bool all)
+{
+	//only whole lines go out
+	string& console = buffer[LOG_CONSOLE];
+	size_t end = console.rfind('\n');
+	if (end != string::npos) {
+		cout.write(console.data(), end + 1);
+		cout.flush();
+		console.erase(0, end + 1);
+	}
+
+	string& debug = buffer[LOG_DEBUG];
+	steady_clock::time_point now = steady_clock::now();
+	if (!debug.empty() && (all || (debug.size() >= LOG_BATCH_BYTES) || (now - lastDebugWrite >= milliseconds(LOG_DEBUG_FLUSH_MS)))) {
+		if (debugFile.is_open()) {
+			debugFile.write(debug.data(), debug.size());
+			debugFile.flush();
+		}
+		debug.clear();
+		lastDebugWrite = now;
+	}
+}
@@ -0,0 +1,145 @@
+/* ************************************************************
+AsyncLog.h
+**************************************************************
+
+Logging off the control thread.
+
+The control thread only copies fixed size records (one cache line each)
+into a lock-free ring. A writer thread drains the ring in batches,
+formats numbers with to_chars and writes each sink in large chunks:
+
+	LOG_CONSOLE		cout, written whenever the ring runs dry
+	LOG_DEBUG		debugLog.txt, written every 64 KB or 250 ms
+	LOG_TRIAL		marker rows and annotations for the open TrialLog
+
+When the ring is full, console and debug lines are dropped straight
+away. Trial rows wait up to stallLimit microseconds for room (back
+pressure) before they are dropped too. Every drop and stall is counted.
+
+Only one thread (the control loop) may log. OpenTrial, CloseTrial and
+Flush wait for the writer to catch up, so they belong between runs, not
+inside the control loop.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "MarkerFrame.h"
+#include "SpscQueue.h"
+#include "TrialLog.h"
+
+#define LOG_RING_SIZE                   16384
+#define LOG_TEXT_LENGTH                 56
+#define LOG_LABEL_LENGTH                48
+#define LOG_BATCH_BYTES                 65536
+#define LOG_DEBUG_FLUSH_MS              250
+
+#define LOG_RECORD_TEXT                 0
+#define LOG_RECORD_VALUE                1
+#define LOG_RECORD_MARKER               2
+
+#define LOG_CONTINUE                    1
+
+enum LogSink {
+	LOG_CONSOLE,
+	LOG_DEBUG,
+	LOG_TRIAL,
+	LOG_SINKS
+};
+
+struct LogRecord {
+	uint8_t type;			// LOG_RECORD_*
+	uint8_t sink;			// LogSink
+	uint8_t flags;			// LOG_CONTINUE if the line goes on in the next record
+	uint8_t length;			// text bytes used
+	int32_t id;				// marker ID
+	union {
+		struct {
+			double t;
+			float x, y, z;
+			char contact[4];
+		} marker;
+		struct {
+			double value;
+			char label[LOG_LABEL_LENGTH];
+		} value;
+		char text[LOG_TEXT_LENGTH];
+	};
+};
+
+class AsyncLog {
+public:
+	AsyncLog();
+	~AsyncLog();
+
+	bool OpenDebug(const char* filename);
+
+	void Start();
+	//Writes out everything queued, then stops the writer
+	void Stop();
+
+	//Blocks until everything queued so far has been written
+	void Flush();
+
+	//Trial log files, only between runs
+	bool OpenTrial(const std::string& filename, int trial, const char* project, int markers);
+	void CloseTrial();
+
+	//A line of text, e.g. Text(LOG_CONSOLE, "First Contact Made!")
+	void Text(LogSink sink, const char* text);
+	void Text(LogSink sink, const std::string& text) { Text(sink, text.c_str()); }
+
+	//label followed by value (formatted like cout << value), ending the
+	//line unless endLine is false. To LOG_TRIAL it is an annotation.
+	void Value(LogSink sink, const char* label, double value, bool endLine = true);
+
+	//Marker rows for the open trial
+	void Marker(double t, int id, float x, float y, float z, const char* contact);
+	void Frame(const MarkerFrame* frame, const char* contact);
+
+	uint64_t Dropped(LogSink sink) const { return dropped[sink]; }
+	uint64_t Stalls() const { return stalls; }
+	//Most records ever waiting in the ring
+	uint64_t HighWater() const { return highWater; }
+
+	int stallLimit;			// microseconds a trial row may wait for room
+
+private:
+	//Room for count records, waiting up to stallLimit if wait is set
+	bool Reserve(int count, LogSink sink, bool wait);
+	void Put(const LogRecord& record);
+	void Drain();
+	void Run();
+	void Write(const LogRecord& record);
+	void WriteOut(bool all);
+
+	SpscQueue<LogRecord, LOG_RING_SIZE> ring;
+
+	std::atomic<bool> running;
+	std::atomic<uint64_t> pushed;
+	std::atomic<uint64_t> written;
+	std::atomic<uint64_t> dropped[LOG_SINKS];
+	std::atomic<uint64_t> stalls;
+	std::atomic<uint64_t> highWater;
+
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool flushRequested;
+	uint64_t flushed;
+	std::thread writer;
+
+	//writer thread only
+	std::string buffer[LOG_SINKS];
+	std::string annotation;
+	std::ofstream debugFile;
+	TrialLog trialLog;
+	std::chrono::steady_clock::time_point lastDebugWrite;
+};
@@ -0,0 +1,312 @@
+/* ************************************************************
+BatchJournal.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <fstream>
+#include <sstream>
+#include "BatchJournal.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/*********************************************************************
+
+BatchJournal
+
+*********************************************************************/
+
+BatchJournal::BatchJournal()
+	: file(NULL), planned(0), done(false), damaged(0)
+{
+}
+
+BatchJournal::~BatchJournal()
+{
+	Close();
+}
+
+//Replaces the file at path with text, written aside and swapped in so a
+//crash leaves either the old file or the new one
+static bool replaceFile(const char* path, const string& text)
+{
+	string temporary = string(path) + ".tmp";
+	ofstream out(temporary.c_str(), ios::binary);
+	out << text;
+	out.close();
+	if (!out) {
+		return false;
+	}
+#ifdef _WIN32
+	return MoveFileExA(temporary.c_str(), path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return rename(temporary.c_str(), path) == 0;
+#endif
+}
+
+bool BatchJournal::Open(const char* path, unsigned long long fingerprint, int planned)
+{
+	Close();
+	this->path = path;
+	this->planned = planned;
+	trials.clear();
+	done = false;
+	damaged = 0;
+
+	string text;
+	ifstream in(path, ios::binary);
+	if (in) {
+		ostringstream contents;
+		contents << in.rdbuf();
+		text = contents.str();
+	}
+	in.close();
+
+	//a crash partway through a write leaves a line without its newline
+	bool torn = !text.empty() && (text[text.size() - 1] != '\n');
+	if (torn) {
+		size_t end = text.rfind('\n');
+		text.erase((end == string::npos) ? 0 : end + 1);
+		damaged++;
+	}
+	bool header = !text.empty();
+	if (header && !Read(text, fingerprint)) {
+		printf("Journal: %s belongs to a different plan; use another output name or remove it\n", path);
+		return false;
+	}
+
+	//the cut line is dropped before anything is appended after it
+	if (torn && !replaceFile(path, text)) {
+		printf("Journal: cannot write %s\n", path);
+		return false;
+	}
+	file = fopen(path, "ab");
+	if (file == NULL) {
+		printf("Journal: cannot write %s\n", path);
+		return false;
+	}
+	if (!header) {
+		Write("batch " + to_string(fingerprint) + " " + to_string(planned));
+	}
+
+	if (!trials.empty()) {
+		int ran = 0;
+		for (size_t i = 0; i < trials.size(); i++) {
+			ran += trials[i].ran ? 1 : 0;
+		}
+		printf("Journal: %s, %d of %d planned trials ran\n", path, ran, planned);
+	}
+	if (damaged > 0) {
+		printf("Journal: %d damaged lines skipped\n", damaged);
+	}
+	return true;
+}
+
+void BatchJournal::Close()
+{
+	if (file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+}
+
+bool BatchJournal::Read(const string& text, unsigned long long fingerprint)
+{
+	istringstream lines(text);
+	string line;
+	while (getline(lines, line)) {
+		istringstream fields(line);
+		string key;
+		if (!(fields >> key)) {
+			continue;
+		}
+
+		bool valid = true;
+		int trial;
+		JournalTrial* record = NULL;
+		if (key == "batch") {
+			unsigned long long recorded;
+			int count;
+			valid = (bool)(fields >> recorded >> count);
+			if (valid && (recorded != fingerprint)) {
+				return false;
+			}
+		}
+		else if (key == "start") {
+			JournalTrial started = JournalTrial();
+			started.next = -1;
+			valid = (fields >> started.trial >> started.index) && (started.index >= 0) && (started.index < planned) &&
+				getline(fields >> ws, started.filename);
+			//a trial started again replaces the run that did not finish
+			if (valid && !trials.empty() && (trials.back().trial == started.trial)) {
+				trials.back() = started;
+			}
+			else if (valid) {
+				trials.push_back(started);
+			}
+		}
+		else if ((key == "ran") || (key == "ended") || (key == "placed")) {
+			valid = (fields >> trial) && ((record = Find(trial)) != NULL);
+			if (valid && (key == "ran")) {
+				record->ran = true;
+			}
+			else if (valid && (key == "ended")) {
+				valid = (fields >> record->endX >> record->endZ >> record->next) && (record->next >= 0) && (record->next < planned);
+				record->ended = valid;
+			}
+			else if (valid) {
+				record->placed = true;
+			}
+		}
+		else if (key == "done") {
+			done = true;
+		}
+		else {
+			valid = false;
+		}
+
+		if (!valid) {
+			damaged++;
+		}
+	}
+	return true;
+}
+
+JournalTrial* BatchJournal::Find(int trial)
+{
+	for (size_t i = trials.size(); i-- > 0;) {
+		if (trials[i].trial == trial) {
+			return &trials[i];
+		}
+	}
+	return NULL;
+}
+
+void BatchJournal::Write(const string& line)
+{
+	if (file == NULL) {
+		return;
+	}
+	//one whole line per write, on disk before the batch goes on
+	string record = line + "\n";
+	bool written = (fwrite(record.data(), 1, record.size(), file) == record.size()) && (fflush(file) == 0);
+#ifdef _WIN32
+	written = written && (_commit(_fileno(file)) == 0);
+#else
+	written = written && (fsync(fileno(file)) == 0);
+#endif
+	if (!written) {
+		printf("Journal: cannot write %s\n", path.c_str());
+	}
+}
+
+bool BatchJournal::Complete() const
+{
+	int ran = 0;
+	for (size_t i = 0; i < trials.size(); i++) {
+		ran += trials[i].ran ? 1 : 0;
+	}
+	return done || (ran >= planned);
+}
+
+BatchResume BatchJournal::Restore(TrialScheduler* scheduler, InitialCondition* first) const
+{
+	BatchResume resume = { 0, !trials.empty(), false };
+
+	InitialCondition condition;
+	for (size_t i = 0; i < trials.size(); i++) {
+		const JournalTrial& trial = trials[i];
+		if (trial.ran) {
+			scheduler->Take(trial.index, &condition);
+		}
+		if (trial.ended) {
+			const InitialCondition& from = scheduler->Condition(trial.index);
+			scheduler->Observe(from.x, from.z, trial.endX, trial.endZ);
+		}
+	}
+
+	if (trials.empty()) {
+		scheduler->Take(0, first);
+		return resume;
+	}
+	const JournalTrial& last = trials.back();
+	if (!last.ran) {
+		resume.trial = last.trial;
+		scheduler->Take(last.index, first);
+		return resume;
+	}
+	resume.trial = last.trial + 1;
+	if (last.ended) {
+		resume.placed = last.placed;
+		scheduler->Take(last.next, first);
+		return resume;
+	}
+	//the pickup stopped before a start was chosen; plan from where the
+	//trial was expected to leave the snake
+	float x, z;
+	scheduler->PredictEnd(scheduler->Condition(last.index), &x, &z);
+	scheduler->Next(x, z, first);
+	return resume;
+}
+
+void BatchJournal::Started(int trial, int index, const string& filename)
+{
+	JournalTrial started = JournalTrial();
+	started.trial = trial;
+	started.index = index;
+	started.filename = filename;
+	started.next = -1;
+	if (!trials.empty() && (trials.back().trial == trial)) {
+		trials.back() = started;
+	}
+	else {
+		trials.push_back(started);
+	}
+	Write("start " + to_string(trial) + " " + to_string(index) + " " + filename);
+}
+
+void BatchJournal::Ran(int trial)
+{
+	JournalTrial* record = Find(trial);
+	if (record != NULL) {
+		record->ran = true;
+	}
+	Write("ran " + to_string(trial));
+}
+
+void BatchJournal::Ended(int trial, float endX, float endZ, int next)
+{
+	JournalTrial* record = Find(trial);
+	if (record != NULL) {
+		record->ended = true;
+		record->endX = endX;
+		record->endZ = endZ;
+		record->next = next;
+	}
+	char line[96];
+	snprintf(line, sizeof(line), "ended %d %.3f %.3f %d", trial, endX, endZ, next);
+	Write(line);
+}
+
+void BatchJournal::Placed(int trial)
+{
+	JournalTrial* record = Find(trial);
+	if (record != NULL) {
+		record->placed = true;
+	}
+	Write("placed " + to_string(trial));
+}
+
+void BatchJournal::Finished()
+{
+	done = true;
+	Write("done");
+}
@@ -0,0 +1,103 @@
+/* ************************************************************
+BatchJournal.h
+**************************************************************
+
+How far a batch has got, kept next to its trial files, so a batch that
+stops partway (the snake's motors not answering, a marker not found,
+"Gantry Not Found", a crash) carries on where it stopped when the same
+plan is launched again instead of starting over.
+
+The journal is <output>.journal, one line per step a trial gets through:
+
+	batch   fingerprint trials          the plan the journal belongs to
+	start   trial planned file          trial number, planned trial, trial file
+	ran     trial                       the snake run finished, its file is complete
+	ended   trial x z next              where it left the snake (machine mm) and
+	                                    the planned trial chosen to run next
+	placed  trial                       the snake was left at the next start
+	done                                every planned trial has run
+
+Lines are only appended, each flushed to disk before the batch goes on.
+A line cut short by a crash has no newline; the next launch cuts it off
+before appending, so the journal only ever holds steps the batch really
+got through.
+
+A launch picks up after the last step recorded:
+
+	placed      the next trial number from the start chosen, where the
+	            snake already is
+	ran, ended  the next trial number, from the start chosen or (if the
+	            pickup failed before one was) from the scheduler's choice;
+	            the snake is put there by hand
+	start       the same trial number again, from the same start; the file
+	            the run left behind is kept, the journal names the new one
+
+Trial numbers, and so the trial file names, carry on from the last
+launch. The trials that ran are marked run in the scheduler and where
+they left the snake is replayed into its drift estimate.
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "TrialScheduler.h"
+
+struct JournalTrial {
+	int trial;				// trial number, as in the file name
+	int index;				// planned trial
+	std::string filename;
+	bool ran;				// the run finished and its file is complete
+	bool ended;				// endX, endZ and next are known
+	float endX, endZ;		// machine mm, where the run left the snake
+	int next;				// planned trial chosen to run after it
+	bool placed;			// the snake was left at next's start
+};
+
+struct BatchResume {
+	int trial;				// trial number to run first
+	bool resumed;			// an earlier launch ran part of the batch
+	bool placed;			// the snake is at the first start already
+};
+
+class BatchJournal {
+public:
+	BatchJournal();
+	~BatchJournal();
+
+	//Reads what earlier launches recorded in path and opens it to record
+	//this one; false if it belongs to another plan or cannot be written
+	bool Open(const char* path, unsigned long long fingerprint, int planned);
+	void Close();
+
+	//Every planned trial has run
+	bool Complete() const;
+	//Trials recorded, one per trial number
+	const std::vector<JournalTrial>& Trials() const { return trials; }
+
+	//Marks the trials that ran in scheduler (conditions added in plan
+	//order), replays where they left the snake and sets first to the
+	//condition to run next
+	BatchResume Restore(TrialScheduler* scheduler, InitialCondition* first) const;
+
+	//Steps of a trial, written through to disk; nothing is written unless
+	//the journal is open
+	void Started(int trial, int index, const std::string& filename);
+	void Ran(int trial);
+	void Ended(int trial, float endX, float endZ, int next);
+	void Placed(int trial);
+	void Finished();
+
+private:
+	bool Read(const std::string& text, unsigned long long fingerprint);
+	JournalTrial* Find(int trial);
+	void Write(const std::string& line);
+
+	FILE* file;
+	std::string path;
+	std::vector<JournalTrial> trials;
+	int planned;
+	bool done;
+	int damaged;			// lines skipped when reading
+};
@@ -0,0 +1,266 @@
+/* ************************************************************
+BatchBench.cpp
+**************************************************************
+
+A batch of trials: the order the starts are run in and resuming the
+batch after the app stops partway.
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "BatchJournal.h"
+#include "Bench.h"
+#include "GantryCommand.h"
+#include "MoveDuration.h"
+#include "TrialScheduler.h"
+
+using namespace std;
+
+/*********************************************************************
+
+TrialScheduler
+
+*********************************************************************/
+
+//Runs the design with the snake's end displacement drawn from
+//(drift, spread), returns the total carry in mm; every condition must
+//come up exactly once
+static double scheduleRun(const vector<InitialCondition>& design, int policy, float driftX, float driftZ,
+	float spread, unsigned seed, bool* covered)
+{
+	mt19937 random(seed);
+	normal_distribution<float> noise(0, spread);
+
+	TrialScheduler scheduler;
+	scheduler.driftX = driftX;
+	scheduler.driftZ = driftZ;
+	scheduler.optimize = (policy == 2);
+	for (size_t i = 0; i < design.size(); i++) {
+		scheduler.Add(design[i].x, design[i].z);
+	}
+
+	//the first trial runs from wherever the snake was put down
+	float startX = 0, startZ = 0;
+	vector<int> seen(design.size(), 0);
+	double carry = 0;
+	for (size_t trial = 0; trial < design.size(); trial++) {
+		float endX = startX + driftX + noise(random);
+		float endZ = startZ + driftZ + noise(random);
+		if (trial > 0) {
+			scheduler.Observe(startX, startZ, endX, endZ);
+		}
+
+		InitialCondition next;
+		if (policy == 0) {
+			next = design[trial];
+		}
+		else if (!scheduler.Next(endX, endZ, &next)) {
+			break;
+		}
+		seen[next.index]++;
+		carry += hypot(next.x - endX, next.z - endZ);
+		startX = next.x;
+		startZ = next.z;
+	}
+
+	*covered = true;
+	for (size_t i = 0; i < seen.size(); i++) {
+		*covered = *covered && (seen[i] == 1);
+	}
+	return carry;
+}
+
+//Runs a grid of starts against snakes with a random end displacement and
+//checks each policy runs every start once and 2-opt carries least
+void TrialSchedulerBench()
+{
+	//a 5 x 5 grid of starts 100 mm apart, like randx and randz over a box
+	vector<InitialCondition> design;
+	for (int i = 0; i < 25; i++) {
+		InitialCondition condition;
+		condition.index = i;
+		condition.x = (float)(-200 + 100 * (i % 5));
+		condition.z = (float)(-1000 + 100 * (i / 5));
+		design.push_back(condition);
+	}
+
+	MoveDuration durations(SimulatedGantry());
+	static const char* policyNames[] = { "design order", "nearest first", "nearest + 2-opt" };
+	float drifts[][2] = { { 0, 0 }, { 0, 300 }, { 50, 600 }, { -150, 900 } };
+	for (int d = 0; d < 4; d++) {
+		double perTrial[3];
+		for (int policy = 0; policy < 3; policy++) {
+			double total = 0;
+			bool allCovered = true;
+			const int runs = 20;
+			for (int r = 0; r < runs; r++) {
+				bool covered;
+				total += scheduleRun(design, policy, drifts[d][0], drifts[d][1], 150, 1000 + r, &covered);
+				allCovered = allCovered && covered;
+			}
+			perTrial[policy] = total / runs / design.size();
+			Check(allCovered, "drift (%4.0f, %4.0f) mm, %-16s every start once, carry %4.0f mm per trial (%.1f s of move)",
+				drifts[d][0], drifts[d][1], policyNames[policy], perTrial[policy], durations.Move((float)perTrial[policy], 0));
+		}
+		//2-opt may find nothing to improve on nearest first
+		Check((perTrial[2] <= perTrial[1] + 1) && (perTrial[2] < perTrial[0]), "drift (%4.0f, %4.0f) mm: 2-opt carries least",
+			drifts[d][0], drifts[d][1]);
+	}
+}
+
+/*********************************************************************
+
+BatchJournal
+
+*********************************************************************/
+
+struct SimulatedBatch {
+	vector<int> runs;		// finished runs per planned trial
+	vector<int> numbers;	// trial number of every finished run
+	int crashes;
+	int starts;				// trials started, again or not
+	double restore;			// s from opening the journal to the first trial
+};
+
+//A gantry move and its "done moving"; false once the board stops answering
+static bool simulatedStep(SerialDemux* SP)
+{
+	SendCommand(SP, GantryCommand::MoveZ(5));
+	SendCommand(SP, GantryCommand::Wait());
+	string message;
+	return SP->Wait(MESSAGE_MOTION, &message, 300);
+}
+
+//The process dying partway through writing line
+static bool simulatedCrash(BatchJournal* journal, const char* path, const string& line, mt19937& random,
+	SimulatedBatch* batch)
+{
+	if (uniform_real_distribution<double>(0, 1)(random) > 0.05) {
+		return false;
+	}
+	journal->Close();
+	FILE* file = fopen(path, "ab");
+	fputs(line.c_str(), file);
+	fclose(file);
+	batch->crashes++;
+	return true;
+}
+
+//One launch of the batch until it stops or every planned trial has run
+static void simulatedLaunch(BatchJournal* journal, TrialScheduler* scheduler, SerialDemux* SP, const char* path,
+	chrono::steady_clock::time_point opened, mt19937& random, SimulatedBatch* batch)
+{
+	normal_distribution<float> noise(0, 100);
+	InitialCondition condition;
+	BatchResume resume = journal->Restore(scheduler, &condition);
+	batch->restore += Since(opened);
+	int planned = (int)batch->runs.size();
+	for (int trial = resume.trial; trial < planned; trial++) {
+		journal->Started(trial, condition.index, to_string(trial) + "journal-sim.gtl");
+		batch->starts++;
+
+		//the run; motors not answering or the gantry lost stop it here
+		for (int step = 0; step < 3; step++) {
+			if (!simulatedStep(SP) || simulatedCrash(journal, path, "ran " + to_string(trial), random, batch)) {
+				return;
+			}
+		}
+		journal->Ran(trial);
+		batch->runs[condition.index]++;
+		batch->numbers.push_back(trial);
+
+		//the pickup, where markers or the gantry go missing
+		if (!simulatedStep(SP) || simulatedCrash(journal, path, "ended " + to_string(trial) + " 12.5", random, batch)) {
+			return;
+		}
+		float endX = condition.x + noise(random);
+		float endZ = condition.z + 300 + noise(random);
+		scheduler->Observe(condition.x, condition.z, endX, endZ);
+		if (!scheduler->Next(endX, endZ, &condition)) {
+			journal->Finished();
+			return;
+		}
+		journal->Ended(trial, endX, endZ, condition.index);
+
+		//the drop-off at the next start
+		for (int step = 0; step < 2; step++) {
+			if (!simulatedStep(SP) || simulatedCrash(journal, path, "placed " + to_string(trial), random, batch)) {
+				return;
+			}
+		}
+		journal->Placed(trial);
+	}
+}
+
+//Runs a batch through launches that die partway, from a simulated
+//Arduino that stops answering and crashes that cut the last journal line
+//short, and checks every planned trial runs exactly once
+void BatchJournalBench()
+{
+	const char* path = "journal-sim.journal";
+	const int planned = 16;
+	remove(path);
+
+	SimulatedBatch batch;
+	batch.runs.assign(planned, 0);
+	batch.crashes = 0;
+	batch.starts = 0;
+	batch.restore = 0;
+	mt19937 random(7);
+
+	int launches = 0, hangs = 0;
+	bool complete = false;
+	while (!complete && (launches < 100)) {
+		launches++;
+		GantrySettings gantry = SimulatedGantry();
+		gantry.travelSpeed = 5000;
+		gantry.travelAcceleration = 0;
+		SimulatedRig rig(gantry);
+		//a third of the launches lose the board partway
+		if (uniform_real_distribution<double>(0, 1)(random) < 0.33) {
+			rig.arduino->hangAfter = 2 + random() % 30;
+			hangs++;
+		}
+
+		//4 x 4 starts 100 mm apart, trials drifting 300 mm forward
+		TrialScheduler scheduler;
+		scheduler.driftZ = 300;
+		for (int i = 0; i < planned; i++) {
+			scheduler.Add((float)(-200 + 100 * (i % 4)), (float)(-800 + 100 * (i / 4)));
+		}
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		BatchJournal journal;
+		if (!journal.Open(path, 42, planned)) {
+			break;
+		}
+		complete = journal.Complete();
+		if (!complete) {
+			simulatedLaunch(&journal, &scheduler, rig.SP, path, start, random, &batch);
+		}
+		journal.Close();
+	}
+
+	bool once = complete;
+	for (int i = 0; i < planned; i++) {
+		once = once && (batch.runs[i] == 1);
+	}
+	vector<int> numbers = batch.numbers;
+	sort(numbers.begin(), numbers.end());
+	for (int i = 0; i < (int)numbers.size(); i++) {
+		once = once && (numbers[i] == i);
+	}
+
+	Check(once, "%d planned trials over %d launches (%d lost the board, %d crashed mid-write) each ran once, in order",
+		planned, launches, hangs, batch.crashes);
+	Check(batch.restore / launches < 0.05, "journal read and scheduler restored in %.2f ms per launch, under 50 ms",
+		1000 * batch.restore / launches);
+	remove(path);
+}
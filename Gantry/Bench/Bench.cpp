@@ -0,0 +1,105 @@
+/* ************************************************************
+Bench.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include "Bench.h"
+#include "GantryCommand.h"
+
+using namespace std;
+
+static int failures = 0;
+
+bool Check(bool passed, const char* format, ...)
+{
+	char text[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+
+	printf("  %-4s  %s\n", passed ? "pass" : "FAIL", text);
+	if (!passed) {
+		failures++;
+	}
+	return passed;
+}
+
+int Failures()
+{
+	return failures;
+}
+
+double Since(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+Timings Percentiles(vector<double>& samples)
+{
+	Timings timings = { 0, 0, 0 };
+	if (samples.empty()) {
+		return timings;
+	}
+	sort(samples.begin(), samples.end());
+	size_t n = samples.size();
+	timings.p50 = samples[n / 2];
+	timings.p99 = samples[min(n - 1, n * 99 / 100)];
+	timings.max = samples[n - 1];
+	return timings;
+}
+
+bool WaitMotion(SerialDemux* SP, int timeout)
+{
+	string motionMessage;
+	SP->Flush(MESSAGE_MOTION);
+	SendCommand(SP, GantryCommand::Wait());
+	return SP->Wait(MESSAGE_MOTION, &motionMessage, timeout);
+}
+
+GantrySettings SimulatedGantry()
+{
+	GantrySettings gantry;
+	gantry.travelSpeed = 6000 / 60.0f;
+	gantry.travelAcceleration = 200;
+	return gantry;
+}
+
+/*********************************************************************
+
+SimulatedRig
+
+*********************************************************************/
+
+SimulatedRig::SimulatedRig(const GantrySettings& gantry, bool pollGrbl)
+	: grbl(NULL)
+{
+	arduino = new SimulatedArduino();
+	arduino->feedRate = gantry.travelSpeed;
+	arduino->acceleration = gantry.travelAcceleration;
+	SP = new SerialDemux(arduino);
+	if (pollGrbl) {
+		grbl = new GrblStatusPoller(SP, 20);
+		grbl->Start();
+	}
+	tracking = new SimulatedTracking(arduino);
+	tracking->Initialize();
+	settler = new PoseSettler(tracking);
+}
+
+SimulatedRig::~SimulatedRig()
+{
+	if (grbl != NULL) {
+		grbl->Stop();
+	}
+	delete settler;
+	delete tracking;
+	delete grbl;
+	//the demultiplexer deletes the board
+	delete SP;
+}
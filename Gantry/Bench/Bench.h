@@ -0,0 +1,97 @@
+/* ************************************************************
+Bench.h
+**************************************************************
+
+Benchmarks and simulations of the app's modules, built as their own
+program (GantryBench) so none of it ships in GantryApp.
+
+Build GantryBench from the .cpp files in this folder with every Gantry
+.cpp except GantryApp.cpp, with Gantry on the include path and
+MOCK_TRACKING_TOOLS defined (MockNPTrackingTools.cpp in place of
+NPTrackingTools.lib). Then
+
+	GantryBench				runs every bench
+	GantryBench trace loop	runs the named ones
+	GantryBench --list		lists them
+
+Each bench checks its results against a limit with Check, which prints
+the line as pass or FAIL. GantryBench exits with 1 if any check failed.
+
+Benches that need the rig run on SimulatedRig: the simulated Arduino
+behind the serial demultiplexer, simulated cameras following its gantry
+and a pose settler on them. The simulated gantry runs at SimulatedGantry,
+faster than GRBL's defaults so a move takes seconds here, not minutes.
+Every bench gives the same settings to the board and to the model it
+checks.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "ExperimentPlan.h"
+#include "GrblStatus.h"
+#include "PoseSettler.h"
+#include "SerialDemux.h"
+#include "SimulatedDevices.h"
+
+//Prints the formatted line as pass or FAIL and counts the failures;
+//returns passed
+bool Check(bool passed, const char* format, ...);
+int Failures();
+
+//s since start
+double Since(std::chrono::steady_clock::time_point start);
+
+//Median, 99th percentile and largest of a set of timings, sorts them
+struct Timings {
+	double p50, p99, max;
+};
+Timings Percentiles(std::vector<double>& samples);
+
+//"wait" for the move just sent, then its "done moving"; false if it does
+//not come within timeout ms
+bool WaitMotion(SerialDemux* SP, int timeout);
+
+//Travel speed and acceleration of the simulated gantry
+GantrySettings SimulatedGantry();
+
+class SimulatedRig {
+public:
+	SimulatedRig(const GantrySettings& gantry = SimulatedGantry(), bool pollGrbl = false);
+	~SimulatedRig();
+
+	SimulatedArduino* arduino;	// owned by SP
+	SerialDemux* SP;
+	GrblStatusPoller* grbl;		// NULL unless pollGrbl
+	SimulatedTracking* tracking;
+	PoseSettler* settler;
+};
+
+//Logging
+void LogJitterBench();
+void TraceBench();
+void LoopStatsBench();
+
+//Tracking
+void MarkerTrackerBench();
+void SnakeShapeBench();
+void MarkerFramePoolBench();
+void PoseSettlerBench();
+
+//Gantry
+void GantryEstimatorBench();
+void GantryCalibrationBench();
+void VisualServoBench();
+void MotionPlannerBench();
+void MoveDurationBench();
+void ResetGraphBench();
+
+//Serial
+void SerialDemuxBench();
+void SerialCaptureBench();
+
+//Batch
+void TrialSchedulerBench();
+void BatchJournalBench();
@@ -0,0 +1,89 @@
+/* ************************************************************
+BenchMain.cpp
+**************************************************************
+
+GantryBench: runs the benches named on the command line, or all of them
+(see Bench.h).
+*/
+
+#include "stdafx.h"
+
+#include <cstdio>
+#include <string>
+#include "Bench.h"
+
+using namespace std;
+
+struct BenchEntry {
+	const char* name;
+	const char* description;
+	void (*run)();
+};
+
+static const BenchEntry benches[] = {
+	{ "log", "trial logging jitter, AsyncLog against ofstream", LogJitterBench },
+	{ "trace", "cost of a trace span and the exported trace", TraceBench },
+	{ "loop", "loop timing histogram percentiles and cost", LoopStatsBench },
+	{ "track", "online marker labelling on shuffled frames", MarkerTrackerBench },
+	{ "pool", "marker frame fill from the pool against new/delete", MarkerFramePoolBench },
+	{ "settle", "pose settler on jittered, swinging and drifting bodies", PoseSettlerBench },
+	{ "shape", "snake shape estimator on synthetic snakes", SnakeShapeBench },
+	{ "gantry", "gantry position estimator against noisy tracking", GantryEstimatorBench },
+	{ "calibration", "probing a rotated and scaled gantry", GantryCalibrationBench },
+	{ "servo", "closed loop alignment of the simulated gantry", VisualServoBench },
+	{ "motion", "planned pickup move against the old one", MotionPlannerBench },
+	{ "duration", "predicted waits against the old sleeps", MoveDurationBench },
+	{ "reset", "drop-off as a reset graph on the simulated rig", ResetGraphBench },
+	{ "demux", "serial replies sorted under mixed traffic", SerialDemuxBench },
+	{ "capture", "serial session captured and replayed", SerialCaptureBench },
+	{ "schedule", "carry travel per trial for each start order", TrialSchedulerBench },
+	{ "journal", "batch resumed through crashes and a lost board", BatchJournalBench },
+};
+static const int benchCount = sizeof(benches) / sizeof(benches[0]);
+
+static const BenchEntry* findBench(const string& name)
+{
+	for (int i = 0; i < benchCount; i++) {
+		if (name == benches[i].name) {
+			return &benches[i];
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+	if ((argc >= 2) && (string(argv[1]) == "--list")) {
+		for (int i = 0; i < benchCount; i++) {
+			printf("%-12s %s\n", benches[i].name, benches[i].description);
+		}
+		return 0;
+	}
+
+	vector<const BenchEntry*> run;
+	for (int i = 1; i < argc; i++) {
+		const BenchEntry* bench = findBench(argv[i]);
+		if (bench == NULL) {
+			printf("No bench named %s (GantryBench --list)\n", argv[i]);
+			return 1;
+		}
+		run.push_back(bench);
+	}
+	if (run.empty()) {
+		for (int i = 0; i < benchCount; i++) {
+			run.push_back(&benches[i]);
+		}
+	}
+
+	for (size_t i = 0; i < run.size(); i++) {
+		printf("%s: %s\n", run[i]->name, run[i]->description);
+		run[i]->run();
+	}
+
+	if (Failures() > 0) {
+		printf("%d checks FAILED\n", Failures());
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,295 @@
+/* ************************************************************
+LoggingBench.cpp
+**************************************************************
+
+Trial logging, tracing and loop timing: what each costs the control
+loop.
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AsyncLog.h"
+#include "Bench.h"
+#include "GantryCommand.h"
+#include "LoopStats.h"
+#include "MarkerFrame.h"
+#include "Trace.h"
+
+using namespace std;
+
+#define BENCH_LOG_SECONDS               5
+#define BENCH_LOG_MARKERS               12
+#define BENCH_TRACE_RUNS                3
+// GantryApp's LOOP_SLEEP_MS and LOOP_DEADLINE_MS, and a camera frame at its
+// CAMERA_FRAME_RATE
+#define BENCH_LOOP_SLEEP_MS             8
+#define BENCH_LOOP_DEADLINE_MS          12
+#define BENCH_LOOP_FRAME_MS             (1000.0 / 120)
+#define BENCH_LOOP_PASSES               300
+
+/*********************************************************************
+
+AsyncLog
+
+*********************************************************************/
+
+//Control loop tick jitter with the trial data logged through AsyncLog and
+//logged the old way (ofstream, endl per marker line)
+void LogJitterBench()
+{
+	//one tick per camera frame, every marker logged
+	const double rate = 120;
+	const int markers = BENCH_LOG_MARKERS;
+	int ticks = (int)(BENCH_LOG_SECONDS * rate);
+	chrono::duration<double> period(1 / rate);
+
+	MarkerFrame frame;
+	frame.Reserve(markers);
+	frame.count = markers;
+	for (int i = 0; i < markers; i++) {
+		frame.id[i] = i;
+		frame.x[i] = 0.05f * i;
+		frame.y[i] = 0.02f;
+		frame.z[i] = 0.01f * i;
+	}
+
+	Timings timings[2];
+	for (int mode = 0; mode < 2; mode++) {
+		vector<double> work;
+		work.reserve(ticks);
+
+		ofstream csv;
+		AsyncLog* logger = NULL;
+		if (mode == 0) {
+			csv.open("logbench.csv");
+		}
+		else {
+			logger = new AsyncLog();
+			logger->Start();
+			logger->OpenTrial("logbench.gtl", 0, "benchmark", markers);
+		}
+
+		chrono::steady_clock::time_point next = chrono::steady_clock::now();
+		for (int tick = 0; tick < ticks; tick++) {
+			next += chrono::duration_cast<chrono::steady_clock::duration>(period);
+			this_thread::sleep_until(next);
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+			frame.time = tick / rate;
+			if (mode == 0) {
+				for (int i = 0; i < markers; i++) {
+					csv << to_string(frame.time) << ",\t\t" << to_string(i) << ",\t\t" << frame.x[i] << ",\t\t" << frame.y[i] << ",\t\t" << frame.z[i] << ",\t\t" << "0100" << endl;
+				}
+			}
+			else {
+				logger->Frame(&frame, "0100");
+			}
+
+			work.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+		}
+		timings[mode] = Percentiles(work);
+
+		if (mode == 0) {
+			csv.close();
+			remove("logbench.csv");
+		}
+		else {
+			logger->CloseTrial();
+			Check(logger->Dropped(LOG_TRIAL) == 0, "async: %llu trial records dropped, ring high water %llu",
+				(unsigned long long)logger->Dropped(LOG_TRIAL), (unsigned long long)logger->HighWater());
+			delete logger;
+			remove("logbench.gtl");
+		}
+	}
+
+	Check(timings[1].p99 < 100, "async: work p99 %.1f us under 100 us (p50 %.1f us, max %.1f us)",
+		timings[1].p99, timings[1].p50, timings[1].max);
+	Check(timings[1].p99 < timings[0].p99, "async: work p99 %.1f us under ofstream's %.1f us",
+		timings[1].p99, timings[0].p99);
+}
+
+/*********************************************************************
+
+Trace
+
+*********************************************************************/
+
+static double spanTime(int spans)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int i = 0; i < spans; i++) {
+		TraceScope scope("benchmark span");
+	}
+	return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / spans;
+}
+
+static double instantTime(int instants)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int i = 0; i < instants; i++) {
+		Trace::Instant("command", "moveZ-150.5\r");
+	}
+	return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / instants;
+}
+
+//Best of BENCH_TRACE_RUNS, each in a new trace, so a run the scheduler
+//cut into does not count
+static double bestTime(double (*time)(int), int events, bool tracing)
+{
+	double best = INFINITY;
+	for (int run = 0; run < BENCH_TRACE_RUNS; run++) {
+		if (tracing) {
+			Trace::Start();
+		}
+		best = min(best, time(events));
+	}
+	return best;
+}
+
+//ns per span and per instant with tracing on and off, on one thread and
+//on four at once, then the exported trace
+void TraceBench()
+{
+	const int spans = 200000;
+
+	Trace::Stop();
+	double off = bestTime(spanTime, spans, false);
+	Check(off < 20, "tracing off: %.1f ns per span, under 20 ns", off);
+
+	double on = bestTime(spanTime, spans, true);
+	Check(on < 500, "tracing on: %.1f ns per span, under 500 ns", on);
+	double instant = bestTime(instantTime, spans, true);
+	Check(instant < 500, "tracing on: %.1f ns per instant, under 500 ns", instant);
+
+	//four threads recording at once, each in its own chunks
+	Trace::Start();
+	double perSpan[4];
+	vector<thread> workers;
+	for (int i = 0; i < 4; i++) {
+		workers.push_back(thread([i, spans, &perSpan]() {
+			char name[16];
+			snprintf(name, sizeof(name), "worker %d", i);
+			Trace::NameThread(name);
+			perSpan[i] = spanTime(spans / 4);
+		}));
+	}
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+	double worst = *max_element(perSpan, perSpan + 4);
+	//no lock between threads, so only sharing the cores slows them: each
+	//span takes up to twice one thread's for every worker on a core
+	int cores = max(1, min(4, (int)thread::hardware_concurrency()));
+	double sharing = 4.0 / cores;
+	Check(worst < 2 * sharing * on, "4 threads on %d cores: %.1f %.1f %.1f %.1f ns per span, under %.0f times one thread's",
+		cores, perSpan[0], perSpan[1], perSpan[2], perSpan[3], 2 * sharing);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	bool exported = Trace::Export("trace-bench.json");
+	double seconds = Since(start);
+	Trace::Stop();
+
+	FILE* file = fopen("trace-bench.json", "rb");
+	long size = 0;
+	if (file != NULL) {
+		fseek(file, 0, SEEK_END);
+		size = ftell(file);
+		fclose(file);
+	}
+	remove("trace-bench.json");
+	Check(exported && (size > 0), "export: %.1f MB in %.2f s", size / 1e6, seconds);
+	Check(Trace::Dropped() == 0, "export: %llu events dropped", (unsigned long long)Trace::Dropped());
+}
+
+/*********************************************************************
+
+LoopStats
+
+*********************************************************************/
+
+//Nominal passes of the run loop on the simulated rig: the contact request
+//and read through the demux around the sleep, and a millisecond standing in
+//for the Dynamixel sync write. Times them against the loop deadline and
+//against one camera frame
+static void nominalPasses()
+{
+	SimulatedRig rig;
+	LoopStats stats(BENCH_LOOP_DEADLINE_MS / 1000.0);
+	LoopStats frame(BENCH_LOOP_FRAME_MS / 1000.0);
+	string contactState;
+	for (int i = 0; i < BENCH_LOOP_PASSES; i++) {
+		stats.Begin();
+		frame.Begin();
+		SendCommand(rig.SP, GantryCommand::RequestContact());
+		this_thread::sleep_for(chrono::milliseconds(BENCH_LOOP_SLEEP_MS));
+		rig.SP->WaitLatest(MESSAGE_CONTACT, &contactState, 0);
+		this_thread::sleep_for(chrono::milliseconds(1));
+		stats.End();
+		frame.End();
+	}
+	//the odd pass the scheduler holds up is a miss, a typical one must not be
+	double p90 = stats.PassTimes().Percentile(0.9) / 1e6;
+	Check(p90 < BENCH_LOOP_DEADLINE_MS, "nominal pass: p50 %.2f ms, p90 %.2f ms under the %d ms deadline, %llu of %llu missed (%llu over a %.2f ms frame)",
+		stats.PassTimes().Percentile(0.5) / 1e6, p90, BENCH_LOOP_DEADLINE_MS, (unsigned long long)stats.Misses(),
+		(unsigned long long)stats.Passes(), (unsigned long long)frame.Misses(), BENCH_LOOP_FRAME_MS);
+}
+
+//Checks the histogram percentiles against exact ones on random pass
+//times, then the cost of the instrumentation itself, then that a nominal
+//pass of the run loop meets its deadline
+void LoopStatsBench()
+{
+	//pass times around the 8 ms contact sleep, with a slow tail
+	mt19937 random(3);
+	lognormal_distribution<double> normal(log(9.5e6), 0.08);
+	exponential_distribution<double> stall(1 / 6e6);
+	vector<int64_t> samples;
+	LatencyHistogram histogram;
+	for (int i = 0; i < 100000; i++) {
+		double ns = normal(random);
+		if (i % 50 == 0) {
+			ns += stall(random);
+		}
+		samples.push_back((int64_t)ns);
+		histogram.Record((int64_t)ns);
+	}
+	sort(samples.begin(), samples.end());
+
+	double points[] = { 0.5, 0.9, 0.99, 0.999 };
+	for (int i = 0; i < 4; i++) {
+		int64_t exact = samples[(size_t)ceil(points[i] * samples.size()) - 1];
+		int64_t estimate = histogram.Percentile(points[i]);
+		double error = (double)(estimate - exact) / exact;
+		Check(fabs(error) <= 1.0 / LATENCY_SUB_BUCKETS, "p%g: exact %.3f ms, histogram %.3f ms, %+.2f%% within %.2f%%",
+			100 * points[i], exact / 1e6, estimate / 1e6, 100 * error, 100.0 / LATENCY_SUB_BUCKETS);
+	}
+	Check(histogram.Max() == samples.back(), "max: exact %.3f ms, histogram %.3f ms",
+		samples.back() / 1e6, histogram.Max() / 1e6);
+
+	LoopStats stats(0.020);
+	int first = stats.Phase("first");
+	int second = stats.Phase("second");
+	const int passes = 1000000;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int i = 0; i < passes; i++) {
+		stats.Begin();
+		stats.Mark(first);
+		stats.Mark(second);
+		stats.End();
+	}
+	double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / passes;
+	Check(ns / 4 < 100, "%.1f ns per Begin, Mark or End, under 100 ns", ns / 4);
+	Check((stats.Passes() == (uint64_t)passes) && (stats.Skipped() == 0), "%llu passes timed, %llu skipped",
+		(unsigned long long)stats.Passes(), (unsigned long long)stats.Skipped());
+
+	nominalPasses();
+}
@@ -0,0 +1,509 @@
+/* ************************************************************
+MotionBench.cpp
+**************************************************************
+
+The gantry: its position estimate, calibration, closed loop alignment,
+planned moves, predicted waits and the drop-off, on a simulated clock
+or on the simulated rig.
+*/
+
+#include "stdafx.h"
+
+#define _USE_MATH_DEFINES
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include "Bench.h"
+#include "GantryCalibration.h"
+#include "GantryCommand.h"
+#include "GantryEstimator.h"
+#include "MagnetSensor.h"
+#include "MotionPlanner.h"
+#include "MoveDuration.h"
+#include "ResetGraph.h"
+#include "TrackingSession.h"
+#include "VisualServo.h"
+
+using namespace std;
+
+//ms a simulated move may take before a bench gives up on it
+#define BENCH_MOVE_TIMEOUT              30000
+
+/*********************************************************************
+
+GantryEstimator
+
+*********************************************************************/
+
+static void simulateGantry(bool withGrbl)
+{
+	//a gantry on a simulated clock: moves start late and run a little slow,
+	//tracking is noisy with the odd wrong sample
+	const double step = 0.001;
+	const float trueFeed = 24;
+	const float offsetX = 0.3f, offsetZ = -0.2f;
+	mt19937 random(3);
+	normal_distribution<float> trackingNoise(0, 0.0005f);
+	uniform_real_distribution<float> uniform(0, 1);
+
+	GantryEstimator estimator;
+	double t0 = GrblClock();
+	estimator.Reset();
+
+	float machineX = 0, machineZ = 0;
+	float fromX = 0, fromZ = 0, toX = 0, toZ = 0;
+	double moveStart = 0, moveEnd = 0;
+	double nextMove = 0.5, nextTracking = 0, nextGrbl = 0;
+	float lastTrackingX = 0, lastTrackingZ = 0;
+	bool haveTracking = false;
+
+	double sumEstimate = 0, sumRaw = 0;
+	double sumSettledEstimate = 0, sumSettledRaw = 0;
+	int samples = 0, settledSamples = 0, outliers = 0, moves = 0;
+	int clean = 0, rejectedOutliers = 0, rejectedClean = 0;
+	double within = 0;
+	int withinCount = 0;
+	bool waitingWithin = false;
+
+	for (double t = 0; t < 60; t += step) {
+		double now = t0 + t;
+
+		if (t >= nextMove) {
+			//a relative move like the pickup alignment makes
+			float mx = (uniform(random) - 0.5f) * 400;
+			float mz = (uniform(random) - 0.5f) * 400;
+			estimator.AddCommand(now, mx, mz);
+			double latency = 0.05 + 0.1 * uniform(random);
+			fromX = machineX;
+			fromZ = machineZ;
+			toX = machineX + mx;
+			toZ = machineZ + mz;
+			moveStart = t + latency;
+			moveEnd = moveStart + sqrt(mx * mx + mz * mz) / trueFeed;
+			nextMove = moveEnd + 2 + 2 * uniform(random);
+			waitingWithin = true;
+			moves++;
+		}
+
+		float f = (t <= moveStart) ? 0 : (t >= moveEnd) ? 1 : (float)((t - moveStart) / (moveEnd - moveStart));
+		machineX = fromX + (toX - fromX) * f;
+		machineZ = fromZ + (toZ - fromZ) * f;
+		float trueX, trueZ;
+		estimator.calibration.ToTracking(machineX, machineZ, &trueX, &trueZ);
+		trueX += offsetX;
+		trueZ += offsetZ;
+
+		if (withGrbl && (t >= nextGrbl)) {
+			GrblStatus status;
+			status.state = (f > 0 && f < 1) ? GRBL_RUN : GRBL_IDLE;
+			//reported to 0.001 mm
+			status.mpos[0] = roundf(machineX * 1000) / 1000;
+			status.mpos[1] = 0;
+			status.mpos[2] = roundf(machineZ * 1000) / 1000;
+			status.time = now;
+			estimator.AddGrbl(status);
+			nextGrbl = t + 0.05;
+		}
+
+		if (t >= nextTracking) {
+			float x = trueX + trackingNoise(random);
+			float z = trueZ + trackingNoise(random);
+			bool outlier = uniform(random) < 0.01f;
+			if (outlier) {
+				//another rigid body taken for the gantry
+				x += 0.05f;
+				outliers++;
+			}
+			else {
+				clean++;
+			}
+			int rejected = estimator.Rejected();
+			estimator.AddTracking(now, x, z);
+			rejected = estimator.Rejected() - rejected;
+			(outlier ? rejectedOutliers : rejectedClean) += rejected;
+			lastTrackingX = x;
+			lastTrackingZ = z;
+			haveTracking = true;
+			nextTracking = t + 0.1;
+		}
+
+		GantryEstimate estimate;
+		if (haveTracking && (fmod(t, 0.01) < step) && estimator.Estimate(now, &estimate)) {
+			double e = hypot(estimate.x - trueX, estimate.z - trueZ);
+			double r = hypot(lastTrackingX - trueX, lastTrackingZ - trueZ);
+			sumEstimate += e * e;
+			sumRaw += r * r;
+			samples++;
+			if (t > moveEnd) {
+				sumSettledEstimate += e * e;
+				sumSettledRaw += r * r;
+				settledSamples++;
+				if (waitingWithin && (e < 0.0005) && (estimate.Sigma() < 0.0005)) {
+					within += t - moveEnd;
+					withinCount++;
+					waitingWithin = false;
+				}
+			}
+		}
+	}
+
+	const char* name = withGrbl ? "tracking + GRBL" : "tracking alone";
+	double raw = sqrt(sumRaw / samples), fused = sqrt(sumEstimate / samples);
+	double settledRaw = sqrt(sumSettledRaw / max(settledSamples, 1));
+	double settledFused = sqrt(sumSettledEstimate / max(settledSamples, 1));
+	Check(fused < raw, "%s: estimate rms %.2f mm under last tracking's %.2f mm", name, 1000 * fused, 1000 * raw);
+	Check(settledFused < settledRaw, "%s: at rest rms %.2f mm under last tracking's %.2f mm",
+		name, 1000 * settledFused, 1000 * settledRaw);
+	Check(rejectedOutliers == outliers, "%s: %d of %d wrong tracking samples rejected", name, rejectedOutliers, outliers);
+	Check(rejectedClean * 100 <= clean, "%s: %d of %d good tracking samples rejected, at most 1%%", name, rejectedClean, clean);
+	Check(withinCount >= moves * 9 / 10, "%s: within 0.5 mm and confident after %d of %d moves, %.3f s after each ends",
+		name, withinCount, moves, within / max(withinCount, 1));
+}
+
+//The estimator on a simulated gantry with noisy tracking, with and
+//without GRBL reports
+void GantryEstimatorBench()
+{
+	simulateGantry(true);
+	simulateGantry(false);
+}
+
+/*********************************************************************
+
+GantryCalibration
+
+*********************************************************************/
+
+//Probes a simulated gantry whose rails are rotated and scaled against the
+//cameras, then checks long moves land closer with the fitted map
+void GantryCalibrationBench()
+{
+	SimulatedRig rig(SimulatedGantry(), true);
+
+	//rails 1.5 degrees off the camera axes, steps/mm 2% high on X and 1.5% low on Z
+	double angle = 1.5 * M_PI / 180;
+	double sx = -0.001 * 1.02, sz = 0.001 * 0.985;
+	GantryCalibration truth;
+	truth.linear[0][0] = cos(angle) * sx;
+	truth.linear[0][1] = -sin(angle) * sz;
+	truth.linear[1][0] = sin(angle) * sx;
+	truth.linear[1][1] = cos(angle) * sz;
+	truth.origin[0] = 0.25;
+	truth.origin[1] = -0.15;
+	rig.tracking->gantryFrame = truth;
+
+	GantryCalibration nominal;
+	GantryCalibration fitted;
+	if (!Check(ProbeCalibration(rig.SP, rig.settler, rig.grbl, &fitted, 100), "probing")) {
+		return;
+	}
+	double worst = 0;
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 2; j++) {
+			worst = max(worst, fabs(fitted.linear[i][j] - truth.linear[i][j]) / 0.001);
+		}
+	}
+	Check(worst < 0.005, "linear map within %.2f%% of the true one, under 0.5%%", 100 * worst);
+
+	//long moves like the first approach to the snake, each map from the same start
+	float targets[][2] = { { 0.4f, 0.3f }, { -0.5f, 0.2f }, { 0.2f, -0.6f } };
+	for (int i = 0; i < 3; i++) {
+		const GantryCalibration* maps[] = { &nominal, &fitted };
+		float landed[2];
+		for (int m = 0; m < 2; m++) {
+			float gx, gz, x0, z0, x1, z1, moveX, moveZ;
+			rig.arduino->Position(&gx, &gz);
+			truth.ToTracking(gx, gz, &x0, &z0);
+			maps[m]->ToMachine(targets[i][0], targets[i][1], &moveX, &moveZ);
+
+			SendCommand(rig.SP, GantryCommand::MoveZX(moveZ, moveX));
+			WaitMotion(rig.SP, BENCH_MOVE_TIMEOUT);
+
+			rig.arduino->Position(&gx, &gz);
+			truth.ToTracking(gx, gz, &x1, &z1);
+			landed[m] = 1000 * hypot(x1 - x0 - targets[i][0], z1 - z0 - targets[i][1]);
+
+			//back to the start for the other map
+			SendCommand(rig.SP, GantryCommand::MoveZX(-moveZ, -moveX));
+			WaitMotion(rig.SP, BENCH_MOVE_TIMEOUT);
+		}
+		Check((landed[1] < 1) && (landed[1] < landed[0]), "move (%5.2f, %5.2f) m: lands %.2f mm off calibrated, under 1 mm (%.2f mm off nominal)",
+			targets[i][0], targets[i][1], landed[1], landed[0]);
+	}
+}
+
+/*********************************************************************
+
+VisualServo
+
+*********************************************************************/
+
+//Aligns the simulated gantry from a few starting offsets, by moves on a
+//board that ignores jogs as the rig's does and by jogs on one that takes
+//them, and checks where the head really ended
+void VisualServoBench()
+{
+	SimulatedRig rig(SimulatedGantry(), true);
+	GantryEstimator estimator;
+	estimator.feedRate = SimulatedGantry().travelSpeed;
+	VisualServo servo(rig.tracking, rig.SP, rig.grbl, &estimator);
+
+	//offsets the fine adjustment starts from after the first move (m)
+	float offsets[][2] = { { 0.004f, -0.003f }, { -0.03f, 0.02f }, { 0.08f, 0.05f }, { 0, 0.0005f } };
+	for (int mode = 0; mode < 2; mode++) {
+		servo.jog = (mode == 1);
+		rig.arduino->jogging = servo.jog;
+		for (int i = 0; i < 4; i++) {
+			float gx, gz;
+			rig.arduino->Position(&gx, &gz);
+			float targetX = -gx / 1000 + offsets[i][0];
+			float targetZ = gz / 1000 + offsets[i][1];
+
+			ServoResult result;
+			bool aligned = servo.Align(targetX, targetZ, &result);
+
+			//where the simulated head really is, not what the servo believes
+			rig.arduino->Position(&gx, &gz);
+			float trueX = -gx / 1000, trueZ = gz / 1000;
+			double error = hypot(trueX - targetX, trueZ - targetZ);
+			Check(aligned && (error < servo.tolerance) && (servo.jog || (result.jogs == 0)), "%s, offset (%6.1f, %6.1f) mm: %s in %.2f s, %d moves, %d jogs, true error %.2f mm",
+				servo.jog ? "jogs" : "moves", 1000 * offsets[i][0], 1000 * offsets[i][1], aligned ? "aligned" : "timed out",
+				result.seconds, result.moves, result.jogs, 1000 * error);
+		}
+	}
+}
+
+/*********************************************************************
+
+MotionPlanner
+
+*********************************************************************/
+
+//Runs the pickup move the old way (moveZ..,X.., rots, sleeps) and as one
+//planned trajectory, and checks the planned one is no slower and ends
+//where it should
+void MotionPlannerBench()
+{
+	SimulatedRig rig;
+	GantryEstimator estimator;
+	MotionPlanner planner(rig.SP, NULL, &estimator, SimulatedGantry());
+
+	//pickup moves (machine mm) and end effector positions like the app's,
+	//the last across most of the arena
+	float moves[][3] = { { 40, -30, 150 }, { -60, 20, 90 }, { 10, 0, 190 }, { -25, 45, 120 }, { 300, -400, 150 } };
+	const int cases = sizeof(moves) / sizeof(moves[0]);
+	for (int i = 0; i < cases; i++) {
+		float x = moves[i][0], z = moves[i][1];
+		int motor = (int)moves[i][2];
+
+		//the old pickup: move, rotate a second later, two waits a second apart
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		SendCommand(rig.SP, GantryCommand::MoveZX(z, x));
+		Sleep(1000);
+		SendCommand(rig.SP, GantryCommand::Rotate(motor));
+		Sleep(1000);
+		WaitMotion(rig.SP, BENCH_MOVE_TIMEOUT);
+		double sequential = Since(start);
+
+		//back where it started, then the same move planned
+		SendCommand(rig.SP, GantryCommand::MoveZX(-z, -x));
+		SendCommand(rig.SP, GantryCommand::Rotate((int)planner.rotation));
+		WaitMotion(rig.SP, BENCH_MOVE_TIMEOUT);
+		Sleep(500);
+
+		float x0, z0;
+		rig.arduino->Position(&x0, &z0);
+		start = chrono::steady_clock::now();
+		Trajectory trajectory = planner.Plan(x, z, (float)motor);
+		planner.Execute(trajectory);
+		WaitMotion(rig.SP, BENCH_MOVE_TIMEOUT);
+		double planned = Since(start);
+		float servo = rig.arduino->Servo();
+
+		float gx, gz;
+		rig.arduino->Position(&gx, &gz);
+		double error = hypot(gx - x0 - x, gz - z0 - z);
+		//on a long move the travel outlasts both, so the two take as long
+		Check((planned <= sequential + 0.05) && (error < 0.01) && (fabs(servo - motor) < 1),
+			"move (%5.0f, %5.0f) mm, servo %3d: planned %.2f s, old %.2f s, end error %.3f mm, servo at %.0f",
+			x, z, motor, planned, sequential, error, servo);
+
+		//the next case starts from here
+		SendCommand(rig.SP, GantryCommand::Rotate(120));
+		planner.rotation = 120;
+		WaitMotion(rig.SP, BENCH_MOVE_TIMEOUT);
+		Sleep(500);
+	}
+}
+
+/*********************************************************************
+
+MoveDuration
+
+*********************************************************************/
+
+//Drop-off on the simulated rig from the same start each time, with the
+//old sleeps if durations is NULL; s it took
+static double dropOffRun(SimulatedRig* rig, MagnetSensor* magnets, MoveDuration* durations)
+{
+	float gx, gz;
+	rig->arduino->Position(&gx, &gz);
+	SendCommand(rig->SP, GantryCommand::MoveZX(40 - gz, 30 - gx));
+	WaitMotion(rig->SP, BENCH_MOVE_TIMEOUT);
+
+	//Firgelli times a fifth of the rig's, as in the reset bench
+	DropOff dropOff;
+	dropOff.SP = rig->SP;
+	dropOff.magnets = magnets;
+	dropOff.durations = durations;
+	dropOff.lowerTime /= 5;
+	dropOff.retryTime /= 5;
+	dropOff.liftTime /= 5;
+	dropOff.dropTime /= 5;
+	dropOff.clearTime /= 5;
+	dropOff.raiseTime /= 5;
+	dropOff.awayTime /= 5;
+	dropOff.awayDistance = 100;
+	PoseSettler* settler = rig->settler;
+	dropOff.locateStart = [settler](float* machineX, float* machineZ) {
+		RigidBodyPose pose;
+		if (!settler->Acquire(0, &pose)) {
+			return false;
+		}
+		*machineX = pose.x * 1000;
+		*machineZ = -pose.z * 1000;
+		return true;
+	};
+
+	ResetGraph graph;
+	AddDropOffStages(&graph, &dropOff);
+	bool complete = graph.Run();
+	Check(complete, "drop-off with %s: %.2f s", (durations != NULL) ? "predicted waits" : "fixed sleeps", graph.Elapsed());
+	return graph.Elapsed();
+}
+
+//Times moves and strokes on the simulated rig against their deadlines,
+//then runs the drop-off with the old sleeps, with the Firgelli unmeasured
+//and with it measured
+void MoveDurationBench()
+{
+	SimulatedRig rig;
+	MoveDuration durations(SimulatedGantry());
+
+	//moves from a jog to the drop-off move away
+	float moves[][2] = { { 5, 0 }, { 0, -30 }, { 60, 80 }, { 0, -150 } };
+	for (int i = 0; i < 4; i++) {
+		SendCommand(rig.SP, GantryCommand::MoveZX(moves[i][1], moves[i][0]));
+		double predicted = durations.Move(moves[i][0], moves[i][1]);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		bool done = durations.WaitMotion(rig.SP, "move", predicted, 0);
+		double taken = Since(start);
+		Check(done && (taken <= durations.Deadline(predicted)), "move (%4.0f, %4.0f) mm: %.2f s, predicted %.2f s, deadline %.2f s",
+			moves[i][0], moves[i][1], taken, predicted, durations.Deadline(predicted));
+	}
+
+	//Firgelli five times faster than the rig's, running 5% under its rated speed
+	durations.firgelliSpeed *= 5;
+	rig.arduino->firgelliTime = 1.05f * durations.firgelliStroke / durations.firgelliSpeed;
+	float strokes[][2] = { { 0, 1 }, { 1, 0.3f }, { 0.3f, 0 } };
+	for (int i = 0; i < 3; i++) {
+		SendCommand(rig.SP, (strokes[i][1] > strokes[i][0]) ? GantryCommand::LowerY() : GantryCommand::RaiseY());
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		float target = strokes[i][1];
+		while (fabs(rig.arduino->Firgelli() - target) > 0.01f) {
+			this_thread::sleep_for(chrono::milliseconds(5));
+		}
+		SendCommand(rig.SP, GantryCommand::StopY());
+		double taken = Since(start);
+		double predicted = durations.Firgelli(strokes[i][0], target);
+		Check(taken <= durations.Deadline(predicted), "stroke %.1f to %.1f: %.2f s, predicted %.2f s, deadline %.2f s",
+			strokes[i][0], target, taken, predicted, durations.Deadline(predicted));
+	}
+
+	//unmeasured, the Firgelli waits are the sleeps whatever the prediction
+	durations.firgelliMeasured = false;
+	double sleeps[] = { 13, 22, 10.4 };
+	for (int i = 0; i < 3; i++) {
+		double wait = durations.FirgelliWait(0, 1, sleeps[i]);
+		Check(wait == sleeps[i], "unmeasured Firgelli: waits %.2f s for a %.2f s sleep, predicted %.2f s",
+			wait, sleeps[i], durations.Deadline(durations.Firgelli(0, 1)));
+	}
+
+	MagnetSensor magnets(rig.SP);
+	double fixed = dropOffRun(&rig, &magnets, NULL);
+	double unmeasured = dropOffRun(&rig, &magnets, &durations);
+	durations.Report();
+	durations.firgelliMeasured = true;
+	double measured = dropOffRun(&rig, &magnets, &durations);
+	durations.Report();
+	Check(unmeasured < fixed + 0.5, "drop-off: %.2f s unmeasured, no slower than %.2f s with fixed sleeps", unmeasured, fixed);
+	Check(measured < unmeasured, "drop-off: %.2f s measured, %.2f s unmeasured", measured, unmeasured);
+}
+
+/*********************************************************************
+
+ResetGraph
+
+*********************************************************************/
+
+//Runs the drop-off as a reset graph on the simulated rig with shortened
+//Firgelli times
+void ResetGraphBench()
+{
+	SimulatedRig rig;
+	MagnetSensor magnets(rig.SP);
+	TrackingSession session(rig.tracking, SimulatedTracking::rigidBodies);
+	session.Open("");
+	session.SetProfile(PROFILE_RIGID_BODIES);
+	MotionPlanner planner(rig.SP, NULL, NULL, SimulatedGantry());
+
+	//Firgelli times a fifth of the rig's, the simulated stroke to match
+	DropOff dropOff;
+	dropOff.SP = rig.SP;
+	dropOff.magnets = &magnets;
+	dropOff.session = &session;
+	dropOff.planner = &planner;
+	dropOff.lowerTime /= 5;
+	dropOff.retryTime /= 5;
+	dropOff.liftTime /= 5;
+	dropOff.dropTime /= 5;
+	dropOff.clearTime /= 5;
+	dropOff.raiseTime /= 5;
+	dropOff.awayDistance = 100;
+	rig.arduino->firgelliTime = (float)dropOff.lowerTime * 0.8f;
+
+	PoseSettler* settler = rig.settler;
+	dropOff.locateStart = [settler](float* machineX, float* machineZ) {
+		RigidBodyPose pose;
+		if (!settler->Acquire(0, &pose)) {
+			return false;
+		}
+		//back to machine zero
+		*machineX = pose.x * 1000;
+		*machineZ = -pose.z * 1000;
+		return true;
+	};
+	dropOff.homeSnake = []() {
+		this_thread::sleep_for(chrono::milliseconds(1500));
+	};
+
+	//start somewhere over the arena
+	SendCommand(rig.SP, GantryCommand::MoveZX(40, 30));
+	WaitMotion(rig.SP, BENCH_MOVE_TIMEOUT);
+
+	ResetGraph graph;
+	AddDropOffStages(&graph, &dropOff);
+	bool complete = graph.Run();
+	graph.Report();
+
+	float gx, gz;
+	rig.arduino->Position(&gx, &gz);
+	Check(complete, "drop-off %s in %.2f s, gantry at (%.1f, %.1f) mm", complete ? "complete" : "failed",
+		graph.Elapsed(), gx, gz);
+	Check(session.Profile() == PROFILE_RAW_MARKERS, "tracking rearmed for raw markers");
+}
@@ -0,0 +1,309 @@
+/* ************************************************************
+SerialBench.cpp
+**************************************************************
+
+The serial demultiplexer under mixed traffic: every reply has to land
+in its own mailbox. Then a session on the simulated board captured and
+replayed: the replay has to give back the same replies at the same
+points in the session.
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Bench.h"
+#include "GantryCommand.h"
+#include "SerialCapture.h"
+
+using namespace std;
+
+#define BENCH_DEMUX_SECONDS             3
+//unsolicited contact, magnet and "done moving" lines per second
+#define BENCH_DEMUX_CHATTER             600
+//ms a replayed session waits for each reply
+#define BENCH_REPLAY_TIMEOUT            3000
+
+//What each mailbox may hold, judged from the text alone, not by Classify
+static bool looksLike(MessageType type, const string& line)
+{
+	switch (type) {
+	case MESSAGE_CONTACT:
+		return (line.size() == 4) && (line.find_first_not_of("01") == string::npos);
+	case MESSAGE_MAGNET: {
+		char* end = NULL;
+		strtod(line.c_str(), &end);
+		return !line.empty() && (*end == '\0') && (line.find('.') != string::npos);
+	}
+	case MESSAGE_STATUS:
+		return (line.size() > 2) && (line[0] == '<') && (line.back() == '>');
+	case MESSAGE_MOTION:
+		return line == "done moving";
+	default:
+		return false;
+	}
+}
+
+//Lines a contact state and a magnet reading could be confused on
+static void classifyLines()
+{
+	struct Line {
+		const char* text;
+		MessageType type;
+	};
+	static const Line lines[] = {
+		{ "0100", MESSAGE_CONTACT }, { "1111", MESSAGE_CONTACT }, { "1000", MESSAGE_CONTACT },
+		{ "1.000", MESSAGE_MAGNET }, { "1.30", MESSAGE_MAGNET }, { "1000.00", MESSAGE_MAGNET },
+		{ "-0.01", MESSAGE_MAGNET }, { "0.", MESSAGE_MAGNET },
+		{ "<Idle|MPos:0.000,0.000,0.000|FS:0,0>", MESSAGE_STATUS }, { "done moving", MESSAGE_MOTION },
+		{ "1000 ", MESSAGE_OTHER }, { "01001", MESSAGE_OTHER }, { "2", MESSAGE_OTHER }, { ".", MESSAGE_OTHER },
+		{ "", MESSAGE_OTHER }, { "ok", MESSAGE_OTHER },
+	};
+	int wrong = 0;
+	for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+		MessageType type = SerialDemux::Classify(lines[i].text);
+		if (type != lines[i].type) {
+			printf("  \"%s\" classified %d, expected %d\n", lines[i].text, type, lines[i].type);
+			wrong++;
+		}
+	}
+	Check(wrong == 0, "%d of %d lines classified wrong", wrong, (int)(sizeof(lines) / sizeof(lines[0])));
+}
+
+//Contact, magnet and status requests from their own threads with the
+//board chattering unsolicited lines of every kind in between
+void SerialDemuxBench()
+{
+	classifyLines();
+
+	SimulatedRig rig;
+	rig.arduino->SetChatter(BENCH_DEMUX_CHATTER);
+	SerialDemux* SP = rig.SP;
+
+	static const char* names[] = { "contact", "motion", "magnet", "status" };
+	atomic<bool> running(true);
+	atomic<int> received[MESSAGE_OTHER];
+	atomic<int> wrong[MESSAGE_OTHER];
+	for (int type = 0; type < MESSAGE_OTHER; type++) {
+		received[type] = 0;
+		wrong[type] = 0;
+	}
+
+	vector<thread> clients;
+	for (int t = 0; t < MESSAGE_OTHER; t++) {
+		MessageType type = (MessageType)t;
+		clients.push_back(thread([type, SP, &running, &received, &wrong]() {
+			string reply;
+			while (running) {
+				//motion lines only come from the chatter
+				if (type == MESSAGE_CONTACT) {
+					SendCommand(SP, GantryCommand::RequestContact());
+				}
+				else if (type == MESSAGE_MAGNET) {
+					SP->WriteData("maga\r", 5);
+				}
+				else if (type == MESSAGE_STATUS) {
+					SP->WriteData("?", 1);
+				}
+				if (SP->Wait(type, &reply, 100)) {
+					received[type]++;
+					if (!looksLike(type, reply)) {
+						printf("  %s mailbox got \"%s\"\n", names[type], reply.c_str());
+						wrong[type]++;
+					}
+				}
+			}
+		}));
+	}
+
+	//anything left unsorted
+	int other = 0;
+	char buffer[256];
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	while (Since(start) < BENCH_DEMUX_SECONDS) {
+		int read = SP->ReadData(buffer, sizeof(buffer));
+		if (read > 0) {
+			other += read;
+		}
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+	running = false;
+	for (size_t i = 0; i < clients.size(); i++) {
+		clients[i].join();
+	}
+	rig.arduino->SetChatter(0);
+
+	for (int type = 0; type < MESSAGE_OTHER; type++) {
+		Check((received[type] > 0) && (wrong[type] == 0), "%s: %d replies, %d not %s, %d dropped",
+			names[type], (int)received[type], (int)wrong[type], names[type], SP->Dropped((MessageType)type));
+	}
+	Check(other == 0, "%d bytes left unsorted", other);
+}
+
+/*********************************************************************
+
+SerialCapture
+
+*********************************************************************/
+
+struct SessionStep {
+	string command;
+	MessageType reply;		// MESSAGE_OTHER for a command with no reply
+};
+
+static SessionStep step(const GantryCommand& command, MessageType reply)
+{
+	SessionStep s = { string(command.Data(), command.Length()), reply };
+	return s;
+}
+
+//Contact and magnet requests, a move and its "done moving", and a status
+//request, which replay leaves out of the write count; ends on a reply
+static vector<SessionStep> sessionSteps()
+{
+	vector<SessionStep> steps;
+	steps.push_back(step(GantryCommand::RequestContact(), MESSAGE_CONTACT));
+	steps.push_back(step(GantryCommand::MagnetsOn(), MESSAGE_OTHER));
+	SessionStep maga = { "maga\r", MESSAGE_MAGNET };
+	steps.push_back(maga);
+	steps.push_back(step(GantryCommand::MoveZX(0, 40), MESSAGE_OTHER));
+	steps.push_back(step(GantryCommand::Wait(), MESSAGE_MOTION));
+	SessionStep status = { "?", MESSAGE_STATUS };
+	steps.push_back(status);
+	SessionStep magb = { "magb\r", MESSAGE_MAGNET };
+	steps.push_back(magb);
+	steps.push_back(step(GantryCommand::MagnetsOff(), MESSAGE_OTHER));
+	steps.push_back(step(GantryCommand::RequestContact(), MESSAGE_CONTACT));
+	return steps;
+}
+
+//Runs the steps, keeping each reply ("" if none came) and the s from its
+//write; returns how many replies were already there before their write
+static int runSession(SerialDemux* SP, const vector<SessionStep>& steps, vector<string>* replies, vector<double>* seconds)
+{
+	int early = 0;
+	for (size_t i = 0; i < steps.size(); i++) {
+		const SessionStep& s = steps[i];
+		string reply;
+		//a status reply only waits for the write before the request
+		if ((s.reply != MESSAGE_OTHER) && (s.reply != MESSAGE_STATUS) && SP->Wait(s.reply, &reply, 20)) {
+			printf("  \"%s\" before its write\n", reply.c_str());
+			early++;
+		}
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		SP->WriteData(s.command.data(), (unsigned int)s.command.size());
+		if (s.reply == MESSAGE_OTHER) {
+			continue;
+		}
+		if (!SP->Wait(s.reply, &reply, BENCH_REPLAY_TIMEOUT)) {
+			reply.clear();
+		}
+		replies->push_back(reply);
+		seconds->push_back(Since(start));
+	}
+	return early;
+}
+
+static double total(const vector<double>& seconds)
+{
+	double sum = 0;
+	for (size_t i = 0; i < seconds.size(); i++) {
+		sum += seconds[i];
+	}
+	return sum;
+}
+
+//Replays path through the demux; the replies, their times and the writes
+//that did not match the capture
+static int replaySession(const char* path, ReplayMode mode, vector<string>* replies, vector<double>* seconds, int* mismatches)
+{
+	ReplaySerialLink* replay = new ReplaySerialLink(path, mode);
+	if (!replay->IsLoaded()) {
+		delete replay;
+		*mismatches = -1;
+		return 0;
+	}
+	SerialDemux* SP = new SerialDemux(replay);
+	int early = runSession(SP, sessionSteps(), replies, seconds);
+	*mismatches = replay->Mismatches();
+	delete SP;
+	return early;
+}
+
+//Captures a session on the simulated board through the demux, replays it
+//fast and in real time, and replays it again with the last record cut
+//short
+void SerialCaptureBench()
+{
+	const char* path = "serialbench.gsc";
+	const char* cutPath = "serialbench-cut.gsc";
+	vector<SessionStep> steps = sessionSteps();
+
+	vector<string> captured;
+	vector<double> capturedSeconds;
+	{
+		SimulatedArduino* arduino = new SimulatedArduino();
+		arduino->feedRate = SimulatedGantry().travelSpeed;
+		arduino->acceleration = SimulatedGantry().travelAcceleration;
+		CaptureSerialLink* capture = new CaptureSerialLink(arduino, path);
+		Check(capture->IsRecording(), "capturing to %s", path);
+		SerialDemux* SP = new SerialDemux(capture);
+		runSession(SP, steps, &captured, &capturedSeconds);
+		delete SP;
+	}
+	int missing = 0;
+	for (size_t i = 0; i < captured.size(); i++) {
+		missing += captured[i].empty() ? 1 : 0;
+	}
+	//"done moving", the reply a fast replay does not wait for
+	size_t move = 2;
+	Check(missing == 0, "capture: %d replies in %.2f s, %d missing, move reply after %.2f s",
+		(int)captured.size(), total(capturedSeconds), missing, capturedSeconds[move]);
+
+	static const char* modeNames[] = { "REPLAY_REALTIME", "REPLAY_FAST" };
+	ReplayMode modes[] = { REPLAY_FAST, REPLAY_REALTIME };
+	for (int m = 0; m < 2; m++) {
+		vector<string> replies;
+		vector<double> seconds;
+		int mismatches;
+		int early = replaySession(path, modes[m], &replies, &seconds, &mismatches);
+		Check((replies == captured) && (mismatches == 0) && (early == 0),
+			"%s: %d replies, %s, %d mismatched writes, %d before their write",
+			modeNames[modes[m]], (int)replies.size(), (replies == captured) ? "byte-identical" : "DIFFERENT", mismatches, early);
+		if (modes[m] == REPLAY_FAST) {
+			Check(seconds[move] < 0.1, "%s: move reply after %.2f s, under 0.1 s", modeNames[modes[m]], seconds[move]);
+		}
+		else {
+			Check(seconds[move] >= 0.95 * capturedSeconds[move], "%s: move reply after %.2f s, captured %.2f s",
+				modeNames[modes[m]], seconds[move], capturedSeconds[move]);
+		}
+	}
+
+	//a run stopped mid-write leaves the last record short
+	{
+		ifstream in(path, ios::binary);
+		string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		ofstream out(cutPath, ios::binary | ios::trunc);
+		out.write(bytes.data(), bytes.size() - 2);
+	}
+	vector<string> replies;
+	vector<double> seconds;
+	int mismatches;
+	int early = replaySession(cutPath, REPLAY_FAST, &replies, &seconds, &mismatches);
+	bool prefix = (replies.size() == captured.size()) && replies.back().empty() &&
+		equal(replies.begin(), replies.end() - 1, captured.begin());
+	Check(prefix && (mismatches == 0) && (early == 0), "cut short: %d of %d replies as captured, the last %s, %d mismatched writes",
+		prefix ? (int)replies.size() - 1 : 0, (int)captured.size(), replies.back().empty() ? "dropped" : "still there", mismatches);
+
+	remove(path);
+	remove(cutPath);
+}
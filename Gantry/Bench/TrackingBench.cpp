@@ -0,0 +1,481 @@
+/* ************************************************************
+TrackingBench.cpp
+**************************************************************
+
+Marker labelling and the snake shape estimator on synthetic frames with
+known answers.
+*/
+
+#include "stdafx.h"
+
+#define _USE_MATH_DEFINES
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Bench.h"
+#include "GrblStatus.h"
+#include "MarkerFrame.h"
+#include "MarkerTracker.h"
+#include "PoseSettler.h"
+#include "SnakeShape.h"
+#include "TrackingBackend.h"
+
+using namespace std;
+
+//markers along the snake, as the app's SNAKE_MARKERS
+#define BENCH_SNAKE_MARKERS             14
+#define BENCH_TRACKING_FRAMES           12000
+//frames timed together, so the clock costs little against a fill
+#define BENCH_FILL_BATCH                1000
+
+/*********************************************************************
+
+MarkerTracker
+
+*********************************************************************/
+
+//Labels synthetic frames of rows markers per row and counts how often a
+//marker's ID changed; the label p99 has to be under limit us
+static void trackRun(int rows, int perRow, float spacing, float hide, double limit)
+{
+	//markers on wavy lines 10 cm apart moving like the snake at 120 Hz, each
+	//hidden with probability hide per frame for a few frames, reported in a
+	//new order every frame as Motive does
+	const int markers = rows * perRow;
+	const int frames = BENCH_TRACKING_FRAMES;
+	const double rate = 120;
+	mt19937 random(1);
+	normal_distribution<float> noise(0, 0.0003f);
+	uniform_real_distribution<float> uniform(0, 1);
+
+	vector<int> hidden(markers, 0);
+	vector<int> lastId(markers, -1);
+	vector<int> order;
+	vector<double> work;
+	work.reserve(frames);
+	int switches = 0;
+
+	MarkerFrame frame;
+	frame.Reserve(markers);
+	MarkerTracker tracker;
+
+	for (int n = 0; n < frames; n++) {
+		double t = n / rate;
+		order.clear();
+		for (int i = 0; i < markers; i++) {
+			if (hidden[i] > 0) {
+				//seen again for at least a frame, so no gap outlasts maxMissed
+				if (--hidden[i] == 0) {
+					order.push_back(i);
+				}
+			}
+			else if (uniform(random) < hide) {
+				hidden[i] = 2 + (int)(uniform(random) * 12);
+			}
+			else {
+				order.push_back(i);
+			}
+		}
+		shuffle(order.begin(), order.end(), random);
+
+		frame.time = t;
+		frame.count = (int)order.size();
+		for (int k = 0; k < frame.count; k++) {
+			int i = order[k];
+			float s = (i % perRow) * spacing + 0.05f * (float)t;
+			frame.x[k] = s + noise(random);
+			frame.y[k] = 0.02f + 0.1f * (i / perRow) + noise(random);
+			frame.z[k] = 0.05f * sin(2 * 3.14159265f * (s / 0.4f - 0.5f * (float)t)) + noise(random);
+			frame.id[k] = -1;
+		}
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		tracker.Label(&frame);
+		work.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+
+		for (int k = 0; k < frame.count; k++) {
+			int i = order[k];
+			if ((lastId[i] != -1) && (lastId[i] != frame.id[k])) {
+				switches++;
+			}
+			lastId[i] = frame.id[k];
+		}
+	}
+
+	Timings timings = Percentiles(work);
+	Check(timings.p99 < limit, "%d markers %.0f mm apart: label p99 %.1f us under %.0f us (p50 %.1f us, max %.1f us)",
+		markers, 1000 * spacing, timings.p99, limit, timings.p50, timings.max);
+	Check(switches == 0, "%d frames: %d ID switches, %d IDs used, %d tracks, %d components labelled greedy",
+		frames, switches, tracker.IdsUsed(), tracker.Tracks(), tracker.GreedyComponents());
+	if (spacing < tracker.gate) {
+		Check(tracker.GreedyComponents() > 0, "rows of %d markers closer than the gate: over %d to a component, labelled greedy",
+			perRow, MARKER_TRACKER_MAX_COMPONENT);
+	}
+}
+
+//The snake's markers, then scenes of hundreds of markers that still have
+//to be labelled within a camera frame. The last is too dense to solve:
+//markers less than a gate apart chain each row into one component. There
+//a marker that comes back in the frame a neighbour hides can shift the
+//tracks between them along by one, as a few matches a spacing off cost
+//less than leaving two unmatched, so markers hide ten times less often
+void MarkerTrackerBench()
+{
+	const double frame = 1e6 / 120;
+	trackRun(1, BENCH_SNAKE_MARKERS, 0.035f, 0.01f, 100);
+	trackRun(10, 20, 0.035f, 0.01f, frame);
+	trackRun(20, 25, 0.035f, 0.01f, frame);
+	trackRun(4, 100, 0.012f, 0.001f, frame);
+}
+
+/*********************************************************************
+
+SnakeShape
+
+*********************************************************************/
+
+static double angleError(double a, double b)
+{
+	double d = fmod(a - b + 540.0, 360.0) - 180.0;
+	return fabs(d);
+}
+
+//Checks the estimator against synthetic snakes with known pose
+void SnakeShapeBench()
+{
+	const int markers = BENCH_SNAKE_MARKERS;
+	const int frames = BENCH_TRACKING_FRAMES;
+	const double rate = 120;
+	const double spacing = 0.035;
+	mt19937 random(1);
+	normal_distribution<float> noise(0, 0.0005f);
+
+	MarkerFrame frame;
+	frame.Reserve(markers);
+	vector<int> order(markers);
+	vector<double> work;
+	work.reserve(frames);
+
+	//1. serpentine gait travelling along a known heading, markers shuffled
+	SnakeShapeEstimator estimator;
+	double direction = 30;
+	double speed = 0.05, amplitude = 0.04, wavelength = 0.35, frequency = 0.5;
+	double headingMax = 0, comMax = 0;
+	double ux = cos(direction * M_PI / 180), uz = sin(direction * M_PI / 180);
+	for (int n = 0; n < frames; n++) {
+		double t = n / rate;
+		for (int i = 0; i < markers; i++) {
+			order[i] = i;
+		}
+		shuffle(order.begin(), order.end(), random);
+
+		//body coordinates: s along the direction of travel, w across it
+		double sumS = 0, sumW = 0;
+		frame.time = t;
+		frame.sequence = n;
+		frame.count = markers;
+		for (int k = 0; k < markers; k++) {
+			int i = order[k];
+			double s = speed * t - i * spacing;
+			double w = amplitude * sin(2 * M_PI * (s / wavelength - frequency * t));
+			sumS += s;
+			sumW += w;
+			frame.x[k] = (float)(s * ux - w * uz) + noise(random);
+			frame.y[k] = 0.02f + noise(random);
+			frame.z[k] = (float)(s * uz + w * ux) + noise(random);
+			frame.id[k] = i;
+		}
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		estimator.Update(&frame);
+		work.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+
+		SnakeShape shape;
+		estimator.Latest(&shape);
+		double cx = (sumS * ux - sumW * uz) / markers, cz = (sumS * uz + sumW * ux) / markers;
+		comMax = max(comMax, (double)hypot(shape.x - cx, shape.z - cz));
+		//the first half second is the velocity settling
+		if (t > 0.5) {
+			headingMax = max(headingMax, angleError(shape.heading, direction));
+		}
+	}
+
+	Timings timings = Percentiles(work);
+	Check(timings.p99 < 50, "%d markers: update p99 %.2f us under 50 us (p50 %.2f us, max %.1f us)",
+		markers, timings.p99, timings.p50, timings.max);
+	Check(headingMax < 5, "serpentine along %.0f deg: heading error max %.2f deg, under 5 deg", direction, headingMax);
+	Check(comMax < 0.001, "serpentine: center of mass error max %.2f mm, under 1 mm", 1000 * comMax);
+
+	//2. markers on arcs of known radius, both bend directions
+	double radii[] = { 0.25, 0.5, 1.0, -0.5 };
+	for (int r = 0; r < 4; r++) {
+		double radius = radii[r];
+		double arc = (markers - 1) * spacing;
+		estimator.Reset();
+		double curvatureMean = 0;
+		int samples = 50;
+		for (int m = 0; m < samples; m++) {
+			frame.time = m / rate;
+			frame.count = markers;
+			for (int i = 0; i < markers; i++) {
+				double phi = (i * spacing - arc / 2) / radius;
+				frame.x[i] = (float)(radius * sin(phi) + 0.01 * m) + noise(random);
+				frame.y[i] = 0.02f;
+				frame.z[i] = (float)(radius * (1 - cos(phi))) + noise(random);
+			}
+			estimator.Update(&frame);
+			SnakeShape shape;
+			estimator.Latest(&shape);
+			curvatureMean += shape.curvature / samples;
+		}
+		Check(fabs(curvatureMean * radius - 1) < 0.1, "arc radius %5.2f m: curvature %7.3f 1/m, true %7.3f within 10%%",
+			radius, curvatureMean, 1 / radius);
+	}
+}
+
+/*********************************************************************
+
+MarkerFramePool
+
+*********************************************************************/
+
+//A camera frame that never changes, so a fill costs only the copy and
+//whatever it allocates
+class FixedMarkers : public TrackingBackend {
+public:
+	FixedMarkers(int markers) : x(markers), y(markers), z(markers)
+	{
+		for (int i = 0; i < markers; i++) {
+			x[i] = 0.035f * i;
+			y[i] = 0.02f;
+			z[i] = 0.01f * i;
+		}
+	}
+
+	bool Initialize() { return true; }
+	bool LoadProject(const char* path) { return true; }
+	void Shutdown() {}
+
+	bool Update() { return true; }
+	double FrameTimeStamp() { return 0; }
+	int FrameMarkerCount() { return (int)x.size(); }
+	void FrameMarkers(float* px, float* py, float* pz, int count)
+	{
+		for (int i = 0; i < count; i++) {
+			px[i] = x[i];
+			py[i] = y[i];
+			pz[i] = z[i];
+		}
+	}
+
+	void RigidBodyLocation(int index, RigidBodyPose* pose) {}
+	bool IsRigidBodyTracked(int index) { return false; }
+	bool RigidBodyEnabled(int index) { return false; }
+	void SetRigidBodyEnabled(int index, bool enabled) {}
+	void FlushCameraQueues() {}
+
+private:
+	vector<float> x, y, z;
+};
+
+//Fills frames from the pool the way TrackingProducer does, against the
+//same frame in columns allocated and deleted every frame as the tracking
+//loop used to, and checks the pool's buffers are never reallocated
+void MarkerFramePoolBench()
+{
+	const int markers = BENCH_SNAKE_MARKERS;
+	const int batches = 200;
+	FixedMarkers backend(markers);
+	MarkerFramePool pool(8, 64);
+
+	//the buffer each pool frame starts with
+	vector<MarkerFrame*> frames;
+	vector<float*> buffers;
+	for (int i = 0; i < pool.Size(); i++) {
+		frames.push_back(pool.Acquire());
+		buffers.push_back(frames.back()->x);
+	}
+	for (size_t i = 0; i < frames.size(); i++) {
+		pool.Release(frames[i]);
+	}
+
+	vector<double> pooled, allocated;
+	//its columns are allocated for each frame and never owned
+	MarkerFrame heap;
+	for (int b = 0; b < batches; b++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (int n = 0; n < BENCH_FILL_BATCH; n++) {
+			MarkerFrame* frame = pool.Acquire();
+			FillMarkerFrame(&backend, &pool, frame);
+			pool.Release(frame);
+		}
+		pooled.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / BENCH_FILL_BATCH);
+
+		//the same frame, in arrays allocated for it
+		start = chrono::steady_clock::now();
+		for (int n = 0; n < BENCH_FILL_BATCH; n++) {
+			int count = backend.FrameMarkerCount();
+			pool.NotePeak(count);
+			heap.x = new float[count];
+			heap.y = new float[count];
+			heap.z = new float[count];
+			heap.id = new int[count];
+			heap.time = backend.FrameTimeStamp();
+			heap.received = GrblClock();
+			heap.count = count;
+			backend.FrameMarkers(heap.x, heap.y, heap.z, count);
+			for (int i = 0; i < count; i++) {
+				heap.id[i] = i;
+			}
+			delete[] heap.x;
+			delete[] heap.y;
+			delete[] heap.z;
+			delete[] heap.id;
+		}
+		allocated.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / BENCH_FILL_BATCH);
+	}
+
+	int moved = 0;
+	for (int i = 0; i < pool.Size(); i++) {
+		MarkerFrame* frame = pool.Acquire();
+		for (size_t k = 0; k < buffers.size(); k++) {
+			if (frame == frames[k]) {
+				moved += (frame->x != buffers[k]) ? 1 : 0;
+			}
+		}
+	}
+
+	Timings fromPool = Percentiles(pooled);
+	Timings fromHeap = Percentiles(allocated);
+	Check(fromPool.p50 < fromHeap.p50, "%d markers: pool fill p50 %.1f ns per frame under new/delete's %.1f ns (p99 %.1f against %.1f)",
+		markers, fromPool.p50, fromHeap.p50, fromPool.p99, fromHeap.p99);
+	Check(moved == 0, "%d frames filled, %d of %d pool buffers reallocated", batches * BENCH_FILL_BATCH, moved, pool.Size());
+}
+
+/*********************************************************************
+
+PoseSettler
+
+*********************************************************************/
+
+struct PoseScript {
+	const char* name;
+	float jitter;		// std deviation of the position, m
+	float angleJitter;	// std deviation of the heading, degrees
+	float drift;		// m/s along x
+	float sway;			// m, 5 Hz swing after a move, dying away over 0.25 s
+	int dropEvery;		// every nth frame without the body, 0 never
+	bool settles;
+};
+
+//One rigid body at rest at (0.1, 0.05, -0.2) m, 30 degrees about y, as
+//the script disturbs it, on a 120 Hz frame clock
+class ScriptedPose : public TrackingBackend {
+public:
+	ScriptedPose(const PoseScript& script)
+		: script(script), rate(120), frame(-1), random(5)
+	{
+		start = chrono::steady_clock::now();
+	}
+
+	bool Initialize() { return true; }
+	bool LoadProject(const char* path) { return true; }
+	void Shutdown() {}
+
+	bool Update()
+	{
+		long long now = (long long)(Since(start) * rate);
+		if (now != frame) {
+			frame = now;
+			Next();
+		}
+		return true;
+	}
+	double FrameTimeStamp() { return frame / rate; }
+	int FrameMarkerCount() { return 0; }
+	void FrameMarkers(float* x, float* y, float* z, int count) {}
+
+	void RigidBodyLocation(int index, RigidBodyPose* pose) { *pose = current; }
+	bool IsRigidBodyTracked(int index) { return tracked; }
+	bool RigidBodyEnabled(int index) { return true; }
+	void SetRigidBodyEnabled(int index, bool enabled) {}
+	void FlushCameraQueues() {}
+
+	//Where the body rests at the current frame, x only moves
+	float RestX() { return 0.1f + script.drift * (float)(frame / rate); }
+
+private:
+	void Next()
+	{
+		normal_distribution<float> noise(0, script.jitter);
+		normal_distribution<float> turn(0, script.angleJitter);
+		double t = frame / rate;
+		float swing = script.sway * (float)(exp(-t / 0.25) * cos(2 * M_PI * 5 * t));
+		current = RigidBodyPose();
+		current.x = RestX() + swing + noise(random);
+		current.y = 0.05f + noise(random);
+		current.z = -0.2f + noise(random);
+		double angle = (30 + turn(random)) * M_PI / 180;
+		current.qy = (float)sin(angle / 2);
+		current.qw = (float)cos(angle / 2);
+		tracked = (script.dropEvery == 0) || (frame % script.dropEvery != 0);
+	}
+
+	PoseScript script;
+	double rate;
+	chrono::steady_clock::time_point start;
+	long long frame;
+	RigidBodyPose current;
+	bool tracked;
+	mt19937 random;
+};
+
+//Feeds the settler bodies that settle (camera jitter, a swing dying away,
+//a slow creep, dropped frames) and bodies that never do (jitter or
+//rotation beyond tolerance, a creep the spread alone would let through,
+//a fast drift) and checks which returned
+void PoseSettlerBench()
+{
+	static const PoseScript scripts[] = {
+		{ "camera jitter", 0.0001f, 0.02f, 0, 0, 0, true },
+		{ "swing after a move", 0.0001f, 0.02f, 0, 0.003f, 0, true },
+		{ "slow creep", 0.0001f, 0.02f, 0.001f, 0, 0, true },
+		{ "every 30th frame lost", 0.0001f, 0.02f, 0, 0, 30, true },
+		{ "jitter past tolerance", 0.001f, 0.02f, 0, 0, 0, false },
+		{ "rotation jitter", 0.0001f, 0.5f, 0, 0, 0, false },
+		{ "creep, 5 mm/s", 0.0001f, 0.02f, 0.005f, 0, 0, false },
+		{ "fast drift", 0.0001f, 0.02f, 0.02f, 0, 0, false },
+	};
+
+	for (size_t i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++) {
+		const PoseScript& script = scripts[i];
+		ScriptedPose backend(script);
+		PoseSettler settler(&backend);
+		settler.timeout = 2;
+
+		RigidBodyPose pose;
+		SettleResult result;
+		bool settled = settler.Acquire(0, &pose, &result);
+
+		if (script.settles) {
+			//the mean of the window, so half the window's creep behind
+			float restX = backend.RestX() - script.drift * POSE_SETTLE_WINDOW / 120 / 2;
+			float error = (float)sqrt(pow(pose.x - restX, 2) + pow(pose.y - 0.05f, 2) + pow(pose.z + 0.2f, 2));
+			Check(settled && (error < settler.positionTolerance) && ((script.dropEvery == 0) || (result.untracked > 0)),
+				"%-22s settled in %.2f s, %d frames (%d untracked), %.2f mm from rest",
+				script.name, result.seconds, result.frames, result.untracked, 1000 * error);
+		}
+		else {
+			//every frame of the timeout looked at, none skipped or doubled
+			int expected = (int)(settler.timeout * 120);
+			Check(!settled && (result.seconds >= settler.timeout) && (abs(result.frames - expected) <= expected / 20),
+				"%-22s timed out after %.2f s, %d frames, spread %.2f mm %.2f deg, shift %.2f mm",
+				script.name, result.seconds, result.frames, 1000 * result.positionSpread, result.angleSpread,
+				1000 * result.positionShift);
+		}
+	}
+}
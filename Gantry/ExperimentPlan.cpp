@@ -0,0 +1,351 @@
+/* ************************************************************
+ExperimentPlan.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "ExperimentPlan.h"
+
+using namespace std;
+
+//Dynamixel goal positions are 0..1023 around 512, 1024 over 300 degrees
+#define GOAL_HALF_RANGE                 511
+#define GOAL_PER_RADIAN                 (1024.0 / 3)
+
+double SteeringSettings::ContactAngle(double duration, int sign) const
+{
+	if (sign > 0) {
+		return (negativeSlope * duration + negativeIntercept) / gain;
+	}
+	return (positiveSlope * duration + positiveIntercept) / gain;
+}
+
+/*********************************************************************
+
+ExperimentPlan
+
+*********************************************************************/
+
+ExperimentPlan::ExperimentPlan()
+{
+	gait.amplitude = 0.4;
+	gait.offset = 0;
+	gait.cycles = 5;
+	gait.phaseStep = 0.0025;
+
+	steering.contactSamples = 3;
+	steering.contactWindow = 1.0;
+	steering.positiveSlope = 14.1;
+	steering.positiveIntercept = 2.3;
+	steering.negativeSlope = -25.2;
+	steering.negativeIntercept = 2.1;
+	steering.gain = 0.85;
+}
+
+string ExperimentPlan::DevicePath(const string& port)
+{
+	return "\\\\.\\" + port;
+}
+
+void ExperimentPlan::Error(const string& where, const string& problem)
+{
+	errors.push_back(where + ": " + problem);
+}
+
+//Reads exactly count numbers from the rest of the line
+static bool readNumbers(istringstream& line, double* values, int count)
+{
+	for (int i = 0; i < count; i++) {
+		if (!(line >> values[i])) {
+			return false;
+		}
+	}
+	string extra;
+	return !(line >> extra);
+}
+
+bool ExperimentPlan::Load(const char* path)
+{
+	errors.clear();
+	ifstream file(path);
+	if (!file) {
+		Error(path, "cannot be read");
+		printf("Plan: %s cannot be read\n", path);
+		return false;
+	}
+
+	struct Start {
+		float xic, zic;
+	};
+	vector<Start> starts;
+	vector<double> amplitudes;
+	int repeats = 1;
+
+	string text;
+	int number = 0;
+	while (getline(file, text)) {
+		number++;
+		size_t comment = text.find('#');
+		if (comment != string::npos) {
+			text.erase(comment);
+		}
+		istringstream line(text);
+		string key;
+		if (!(line >> key)) {
+			continue;
+		}
+		string where = string(path) + ":" + to_string(number);
+		double v[6];
+
+		if ((key == "project") || (key == "output") || (key == "gantry_port") || (key == "snake_port")) {
+			string value, extra;
+			if (!(line >> value) || (line >> extra)) {
+				Error(where, key + " takes one name without spaces");
+				continue;
+			}
+			if (key == "project") {
+				projectPath = value;
+			}
+			else if (key == "output") {
+				outputName = value;
+			}
+			else if (key == "gantry_port") {
+				gantryPort = value;
+			}
+			else {
+				snakePort = value;
+			}
+		}
+		else if ((key == "amplitude") || (key == "offset") || (key == "cycles") || (key == "phase_step") ||
+			(key == "contact_samples") || (key == "contact_window") || (key == "steer_gain") || (key == "repeat")) {
+			if (!readNumbers(line, v, 1)) {
+				Error(where, key + " takes one number");
+				continue;
+			}
+			if (key == "amplitude") {
+				gait.amplitude = v[0];
+			}
+			else if (key == "offset") {
+				gait.offset = v[0];
+			}
+			else if (key == "cycles") {
+				gait.cycles = (int)v[0];
+			}
+			else if (key == "phase_step") {
+				gait.phaseStep = v[0];
+			}
+			else if (key == "contact_samples") {
+				steering.contactSamples = (int)v[0];
+			}
+			else if (key == "contact_window") {
+				steering.contactWindow = v[0];
+			}
+			else if (key == "steer_gain") {
+				steering.gain = v[0];
+			}
+			else {
+				repeats = (int)v[0];
+			}
+		}
+		else if ((key == "gantry_rate") || (key == "gantry_acceleration")) {
+			if (!readNumbers(line, v, 1)) {
+				Error(where, key + " takes one number");
+				continue;
+			}
+			if (key == "gantry_rate") {
+				gantry.travelSpeed = (float)(v[0] / 60);
+			}
+			else {
+				gantry.travelAcceleration = (float)v[0];
+			}
+		}
+		else if ((key == "steer_positive") || (key == "steer_negative")) {
+			if (!readNumbers(line, v, 2)) {
+				Error(where, key + " takes a slope and an intercept");
+				continue;
+			}
+			if (key == "steer_positive") {
+				steering.positiveSlope = v[0];
+				steering.positiveIntercept = v[1];
+			}
+			else {
+				steering.negativeSlope = v[0];
+				steering.negativeIntercept = v[1];
+			}
+		}
+		else if (key == "start") {
+			if (!readNumbers(line, v, 2)) {
+				Error(where, "start takes Xic Zic");
+				continue;
+			}
+			Start start = { (float)v[0], (float)v[1] };
+			starts.push_back(start);
+		}
+		else if (key == "line") {
+			if (!readNumbers(line, v, 5) || (v[0] < 1)) {
+				Error(where, "line takes n Xic Zic dXic dZic, n at least 1");
+				continue;
+			}
+			for (int k = 0; k < (int)v[0]; k++) {
+				Start start = { (float)(v[1] + k * v[3]), (float)(v[2] + k * v[4]) };
+				starts.push_back(start);
+			}
+		}
+		else if (key == "grid") {
+			if (!readNumbers(line, v, 6) || (v[2] <= 0) || (v[5] <= 0) || (v[1] < v[0]) || (v[4] < v[3])) {
+				Error(where, "grid takes Xic0 Xic1 dXic Zic0 Zic1 dZic, from low to high, steps above 0");
+				continue;
+			}
+			//half a step of slack so the far edge is not lost to rounding
+			for (double z = v[3]; z <= v[4] + v[5] / 2; z += v[5]) {
+				for (double x = v[0]; x <= v[1] + v[2] / 2; x += v[2]) {
+					Start start = { (float)x, (float)z };
+					starts.push_back(start);
+				}
+			}
+		}
+		else if (key == "sweep_amplitude") {
+			double amplitude;
+			while (line >> amplitude) {
+				amplitudes.push_back(amplitude);
+			}
+			if (!line.eof() || amplitudes.empty()) {
+				Error(where, "sweep_amplitude takes one or more numbers");
+			}
+		}
+		else {
+			Error(where, "unknown setting " + key);
+		}
+	}
+
+	if (amplitudes.empty()) {
+		amplitudes.push_back(gait.amplitude);
+	}
+	trials.clear();
+	for (int r = 0; r < repeats; r++) {
+		for (size_t s = 0; s < starts.size(); s++) {
+			for (size_t a = 0; a < amplitudes.size(); a++) {
+				PlannedTrial trial;
+				trial.xic = starts[s].xic;
+				trial.zic = starts[s].zic;
+				trial.amplitude = amplitudes[a];
+				trials.push_back(trial);
+			}
+		}
+	}
+
+	vector<string> parsing = errors;
+	bool valid = Validate();
+	errors.insert(errors.begin(), parsing.begin(), parsing.end());
+	if (!parsing.empty() || !valid) {
+		for (size_t i = 0; i < errors.size(); i++) {
+			printf("Plan: %s\n", errors[i].c_str());
+		}
+		return false;
+	}
+	return true;
+}
+
+bool ExperimentPlan::Validate()
+{
+	errors.clear();
+	if (projectPath.empty()) {
+		Error("project", "missing");
+	}
+	else if (!ifstream(projectPath.c_str())) {
+		Error("project", projectPath + " cannot be read");
+	}
+	if (outputName.empty()) {
+		Error("output", "missing");
+	}
+
+	//COMn, which DevicePath turns into \\.\COMn
+	bool comPort = (gantryPort.size() > 3) && (gantryPort.compare(0, 3, "COM") == 0) &&
+		(gantryPort.find_first_not_of("0123456789", 3) == string::npos);
+	if (!comPort) {
+		Error("gantry_port", "'" + gantryPort + "' is not COMn");
+	}
+	if (snakePort.empty()) {
+		Error("snake_port", "missing");
+	}
+
+	if (gantry.travelSpeed <= 0) {
+		Error("gantry_rate", "must be above 0");
+	}
+	if (gantry.travelAcceleration <= 0) {
+		Error("gantry_acceleration", "must be above 0");
+	}
+	if (gait.cycles < 1) {
+		Error("cycles", "must be at least 1");
+	}
+	if ((gait.phaseStep <= 0) || (gait.phaseStep > 0.1)) {
+		Error("phase_step", "must be above 0 and at most 0.1 cycles");
+	}
+	if (steering.contactSamples < 1) {
+		Error("contact_samples", "must be at least 1");
+	}
+	if (steering.contactWindow <= 0) {
+		Error("contact_window", "must be above 0");
+	}
+	if (steering.gain <= 0) {
+		Error("steer_gain", "must be above 0");
+	}
+
+	if (trials.empty()) {
+		Error("trials", "none given (start, line or grid)");
+	}
+	//the joints must stay inside the Dynamixel goal range
+	double offset = fabs(gait.offset);
+	if ((gait.amplitude <= 0) || (gait.amplitude * GOAL_PER_RADIAN + offset > GOAL_HALF_RANGE)) {
+		Error("amplitude", to_string(gait.amplitude) + " is outside the joint range");
+	}
+	for (size_t i = 0; i < trials.size(); i++) {
+		if ((trials[i].amplitude <= 0) || (trials[i].amplitude * GOAL_PER_RADIAN + offset > GOAL_HALF_RANGE)) {
+			Error("trial " + to_string(i), "amplitude " + to_string(trials[i].amplitude) + " is outside the joint range");
+			break;
+		}
+	}
+	return errors.empty();
+}
+
+unsigned long long ExperimentPlan::Fingerprint() const
+{
+	ostringstream text;
+	text.precision(9);
+	text << outputName << ' ' << gait.amplitude << ' ' << gait.offset << ' ' << gait.cycles << ' ' << gait.phaseStep << ' '
+		<< steering.contactSamples << ' ' << steering.contactWindow << ' ' << steering.positiveSlope << ' '
+		<< steering.positiveIntercept << ' ' << steering.negativeSlope << ' ' << steering.negativeIntercept << ' '
+		<< steering.gain;
+	for (size_t i = 0; i < trials.size(); i++) {
+		text << ' ' << trials[i].xic << ' ' << trials[i].zic << ' ' << trials[i].amplitude;
+	}
+
+	//FNV-1a
+	unsigned long long hash = 14695981039346656037ULL;
+	string bytes = text.str();
+	for (size_t i = 0; i < bytes.size(); i++) {
+		hash = (hash ^ (unsigned char)bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+void ExperimentPlan::Print() const
+{
+	printf("project %s, output %s, gantry %s, snake %s\n", projectPath.c_str(), outputName.c_str(),
+		gantryPort.c_str(), snakePort.c_str());
+	printf("gantry: %.0f mm/min, %.1f mm/s^2\n", 60 * gantry.travelSpeed, gantry.travelAcceleration);
+	printf("gait: amplitude %.3f rad, offset %.1f, %d cycles, %.4f cycles per pass\n",
+		gait.amplitude, gait.offset, gait.cycles, gait.phaseStep);
+	printf("steering: %d samples, %.2f s window, +(%.2f d + %.2f), -(%.2f d + %.2f), gain %.2f\n",
+		steering.contactSamples, steering.contactWindow, steering.positiveSlope, steering.positiveIntercept,
+		steering.negativeSlope, steering.negativeIntercept, steering.gain);
+	printf("%d trials:\n", (int)trials.size());
+	for (size_t i = 0; i < trials.size(); i++) {
+		printf("  %3d  Xic %8.1f  Zic %8.1f  amplitude %.3f\n", (int)i, trials[i].xic, trials[i].zic, trials[i].amplitude);
+	}
+}
@@ -0,0 +1,122 @@
+/* ************************************************************
+ExperimentPlan.h
+**************************************************************
+
+Everything a batch needs, read from one text file at startup instead of
+cin prompts and constants spread through the code, so a batch can run
+unattended and one launch can sweep several configurations.
+
+	GantryApp plan.txt
+
+The file is one setting per line, # starts a comment:
+
+	project         Snake12.ttp         Motive project
+	output          Ianoutput.csv       base name of the trial files
+	gantry_port     COM13               Arduino / GRBL
+	snake_port      COM22               Dynamixel bus
+	gantry_rate     500                 mm/min, GRBL max rate ($110 / $112)
+	gantry_acceleration 10              mm/s^2, GRBL acceleration ($120 / $122)
+
+	amplitude       0.4                 B0, rad
+	offset          0                   Dynamixel goal offset, position units
+	cycles          5                   gait cycles per trial
+	phase_step      0.0025              gait cycles per control loop pass
+
+	contact_samples 3                   readings in a row that start or end a contact
+	contact_window  1.0                 s to wait for a second contact
+	steer_positive  14.1 2.3            contact angle = slope * duration + intercept
+	steer_negative  -25.2 2.1
+	steer_gain      0.85                turn the snake makes per commanded
+
+and the trials, in machine mm offsets of the start (Xic, Zic):
+
+	start   Xic Zic                     one start
+	line    n Xic Zic dXic dZic         n starts along a line
+	grid    Xic0 Xic1 dXic Zic0 Zic1 dZic
+	sweep_amplitude a1 a2 ...           every start once per amplitude
+	repeat  n                           the whole set n times
+
+The trials are every start for every swept amplitude, repeated. The
+first trial runs from the first start, where the snake is put down by
+hand; the trial scheduler orders the rest.
+
+The gantry limits are the one place the app learns how fast GRBL moves
+the head; the motion planner, the move duration model and the gantry
+estimator all take them from the plan. Give the lower of the X and Z
+settings GRBL prints for $$. Left out, they are GRBL's own defaults.
+
+Load checks every line and then the plan as a whole, and reports every
+problem with its line before anything is opened or moves.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct GaitSettings {
+	double amplitude;		// B0, rad
+	double offset;			// Dynamixel goal offset, position units
+	int cycles;				// gait cycles per trial (stmax)
+	double phaseStep;		// gait cycles per control loop pass
+};
+
+struct SteeringSettings {
+	int contactSamples;		// readings in a row that start or end a contact
+	double contactWindow;	// s to wait for a second contact
+	double positiveSlope, positiveIntercept;	// deg per s, deg, steering positive
+	double negativeSlope, negativeIntercept;	// deg per s, deg, steering negative
+	double gain;			// turn the snake makes per commanded turn
+
+	//Commanded contact angle, deg, for a contact of duration s
+	double ContactAngle(double duration, int sign) const;
+};
+
+struct GantrySettings {
+	float travelSpeed;			// mm/s, GRBL max rate / 60
+	float travelAcceleration;	// mm/s^2, GRBL acceleration
+
+	//GRBL's defaults, 500 mm/min and 10 mm/s^2
+	GantrySettings() : travelSpeed(500 / 60.0f), travelAcceleration(10) {}
+};
+
+struct PlannedTrial {
+	float xic, zic;			// mm, initial condition offsets
+	double amplitude;		// B0, rad
+};
+
+class ExperimentPlan {
+public:
+	ExperimentPlan();
+
+	//Reads and checks the plan; false, with every problem printed, if it
+	//cannot be run
+	bool Load(const char* path);
+	//Checks the settings and trials as they are now
+	bool Validate();
+
+	//Prints the settings and the trial list
+	void Print() const;
+	//Hash of the output name, settings and trials, which decide what a
+	//batch records; the ports, the project and the gantry limits may change
+	//between launches
+	unsigned long long Fingerprint() const;
+
+	std::string projectPath;
+	std::string outputName;
+	std::string gantryPort;	// COMn
+	std::string snakePort;
+	GantrySettings gantry;
+	GaitSettings gait;
+	SteeringSettings steering;
+	std::vector<PlannedTrial> trials;
+
+	//Problems found by the last Load or Validate
+	std::vector<std::string> errors;
+
+	//Windows device path of a COMn port
+	static std::string DevicePath(const std::string& port);
+
+private:
+	void Error(const std::string& where, const std::string& problem);
+};
@@ -26,16 +26,26 @@ Steps marked with + are probably already done and only included for completeness
 4.	+ Open the command line if not already open
 5.	+ Type D: to switch to the D drive
 6.	+ Type cd D:\Gantry\GantryApp\GantryApp\Debug to switch to the appropriate directory
-7.	Type GantryApp  to begin the app
+7.	Type GantryApp plan.txt  to run the batch described in plan.txt (see ExperimentPlan.h), and skip to step 11.
+	Type GantryApp  alone to be prompted for the settings instead
 8.	Give the name of the most current Optitrack calibration file when prompted (current file is Snake12.ttp )
 9.	Give the name of a .csv file to write the optitrack data. This file will be created if it doesn�t exist already. Ex. Ianoutput.csv
 10.	Type COM13  when prompted for the Com Port
 11.	Program will start to run. Monitor progress in the command line, and follow steps bellow if something goes wrong:
 
+Trial data is written to binary .gtl files (see TrialLog.h). Type GantryApp --to-csv <file>.gtl to get the old .csv layout back.
+Each trial's timeline, reset included, is written to <trial file>.trace.json; open it in ui.perfetto.dev or chrome://tracing (see Trace.h).
+Each trial file ends with the run's loop timing: passes, deadline misses and percentiles per loop phase (see LoopStats.h).
+Without GantryCalibration.txt the app asks before probing the calibration, which moves the gantry (see GantryCalibration.h).
+Marker IDs in the trial data are assigned online (see MarkerTracker.h) and follow each marker through a run.
+To run without Motive or cameras, build with MOCK_TRACKING_TOOLS and MockNPTrackingTools.cpp in place of NPTrackingTools.lib.
+Benchmarks and simulations of the modules build separately as GantryBench (see Bench/Bench.h).
+
 In case of error:
 1.	Type control + C to stop the Cpp program from running
 2.	Immediately unplug power to all gantry components.
 	Note: Steppers and and frigelli will continue to follow their last command even when the program is ended.
+3.	Once the problem is fixed, type GantryApp plan.txt again to carry on a plan batch at the trial where it stopped (see BatchJournal.h).
 */
 
 
@@ -58,11 +68,38 @@ In case of error:
 #include <iostream>
 #include <fstream>
 #include "SerialClass.h"	// Library described above
+#include "SerialLink.h"
+#include "SerialCapture.h"
+#include "SerialDemux.h"
+#include "SimulatedDevices.h"
+#include "GrblStatus.h"
+#include "MarkerFrame.h"
+#include "TrackingBackend.h"
+#include "MarkerTracker.h"
+#include "SnakeShape.h"
+#include "TrackingProducer.h"
+#include "TrialLog.h"
+#include "AsyncLog.h"
+#include "PoseSettler.h"
+#include "GantryCalibration.h"
+#include "GantryEstimator.h"
+#include "VisualServo.h"
+#include "MotionPlanner.h"
+#include "MoveDuration.h"
+#include "ResetGraph.h"
+#include "TrialScheduler.h"
+#include "ExperimentPlan.h"
+#include "BatchJournal.h"
+#include "LoopStats.h"
+#include "Trace.h"
+#include "TrackingSession.h"
 #include <string>
 #include "NPTrackingTools.h"
 #include "RigidBodySettings.h"
 #include "Snake.h"
 #include "dynamixel_sdk.h"
+#include "MagnetSensor.h"
+#include "GantryCommand.h"
 #include <thread>         // std::thread
 
 
@@ -74,11 +111,7 @@ replace the following com port*/
 
 //String for incoming data
 #define MAX_DATA_LENGTH                 255
-char incomingSnakeData[MAX_DATA_LENGTH];
 char incomingData[MAX_DATA_LENGTH];
-char incomingMagDataA[MAX_DATA_LENGTH];
-char incomingMagDataB[MAX_DATA_LENGTH];
-char incomingWaitData[MAX_DATA_LENGTH];
 //char prevData[MAX_DATA_LENGTH];
 
 // Control table address
@@ -115,6 +148,65 @@ char incomingWaitData[MAX_DATA_LENGTH];
 
 #define ESC_ASCII_VALUE                 0x1b
 
+// Set to 1 to record every byte to and from the Arduino to <output filename>.gsc
+// (written on a thread of its own, see SerialCapture.h)
+#define SERIAL_CAPTURE                  0
+// Replay a capture instead of opening the COM port (REPLAY_REALTIME or REPLAY_FAST)
+//#define SERIAL_REPLAY_FILE              "Ianoutput.csv.gsc"
+#define SERIAL_REPLAY_MODE              REPLAY_REALTIME
+// Run against SimulatedDevices instead of the rig
+#define SIMULATED_DEVICES               0
+
+// Poll GRBL status reports ('?') between runs; needs the sketch to pass '?'
+// straight to GRBL (see GrblStatus.h), so off until the rig's sketch does
+#define GRBL_STATUS_POLLING             0
+// GRBL status reports per second while polling
+#define GRBL_STATUS_RATE                20
+
+// Markers on the snake, recorded in the trial log header
+#define SNAKE_MARKERS                   14
+
+// How close the visual servo brings the gantry head to the snake target (m)
+#define GANTRY_ALIGN_TOLERANCE          0.001
+// Align by streaming jog increments instead of moveZ..,X.. corrections; needs
+// the sketch to pass jogZ and jstp to GRBL (see VisualServo.h), so off until
+// the rig's sketch does
+#define VISUAL_SERVO_JOGS               0
+
+// Tracking to gantry calibration, probed at startup when the file is missing
+#define GANTRY_CALIBRATION_FILE         "GantryCalibration.txt"
+// Gantry travel along each axis while probing the calibration (mm)
+#define CALIBRATION_PROBE_SPAN          100
+
+// Firgelli stroke (mm) and speed under the snake's weight (mm/s), which predict
+// the waits after yneg and ypos
+#define FIRGELLI_STROKE                 200
+#define FIRGELLI_SPEED                  22
+// Set to 1 once the stroke and speed above are measured on the rig, to end
+// the Firgelli waits at their predictions (the old sleeps stay as upper
+// bounds); until then the waits are the old sleeps and the predictions only
+// reported
+#define FIRGELLI_MEASURED               0
+
+// Timeline of every trial and the reset after it, <trial file>.trace.json (see Trace.h)
+#define TRACE_TRIALS                    1
+
+// Camera frames per second, as set in the Motive project
+#define CAMERA_FRAME_RATE               120
+// Sleep in each pass of the run loop while the contact reply comes in (ms), and
+// what the rest of the pass is allowed (ms): the contact request, the frames,
+// the controller and the Dynamixel sync write
+#define LOOP_SLEEP_MS                   8
+#define LOOP_IO_BUDGET_MS               4
+// Longest a pass of the run loop should take (ms): the period it is built for,
+// which is longer than a camera frame, so a pass reads the latest frame rather
+// than every one. The gait steps a fixed phaseStep per pass, so a longer pass
+// slows the snake down
+#define LOOP_DEADLINE_MS                (LOOP_SLEEP_MS + LOOP_IO_BUDGET_MS)
+
+// Play the markers of an earlier trial file back instead of the cameras
+//#define TRACKING_REPLAY_FILE            "0Ianoutput.csv10.5.31Trial0.gtl"
+
 #pragma endregion
 
 //define subfunctions
@@ -122,7 +214,6 @@ int snakeUpdatePosition(double t, int ContactCondition);
 int snakeAmplitudeModulation(double t, int ContactCondition);
 int snakeAMM2(double t, float delA, float AMMTest);
 void snakeInitialPosition();
-//void CollectData(double t, ofstream outputFile);
 
 char wait[10];
 
@@ -192,6 +283,9 @@ enum GantryState {
 	SETSPEED
 };
 
+//Gait of the trial being run, from the experiment plan
+GaitSettings gait;
+
 dynamixel::PortHandler *portHandler;
 dynamixel::PacketHandler *packetHandler;
 dynamixel::GroupSyncWrite *groupSyncWrite;
@@ -200,8 +294,129 @@ int dxl_comm_result;
 uint16_t dxl_model_number;                      // Dynamixel model number
 
 // application reads from the specified serial port and reports the collected data
-int main()
+int main(int argc, char* argv[])
 {
+	//GantryApp --to-csv trial.gtl [trial.csv] converts a trial log and exits
+	if ((argc >= 3) && (string(argv[1]) == "--to-csv")) {
+		string csvFile = (argc >= 4) ? string(argv[3]) : string(argv[2]) + ".csv";
+		return TrialLogToCsv(argv[2], csvFile.c_str()) ? 0 : 1;
+	}
+
+	//GantryApp --check-plan plan.txt checks a plan and lists its trials without opening any device
+	if ((argc >= 3) && (string(argv[1]) == "--check-plan")) {
+		ExperimentPlan check;
+		check.snakePort = DEVICENAME;
+		bool valid = check.Load(argv[2]);
+		check.Print();
+		return valid ? 0 : 1;
+	}
+
+	/*******************************************************************
+	Experiment Plan
+	*******************************************************************/
+
+#pragma region "Experiment Plan"
+
+	cout << "Welcome to the gantry app!\n\n";
+
+	//GantryApp plan.txt runs the batch the plan describes (see ExperimentPlan.h);
+	//without one the settings are asked for and the trials are a line of starts
+	ExperimentPlan plan;
+	plan.snakePort = DEVICENAME;
+	if (argc >= 2) {
+		if (!plan.Load(argv[1])) {
+			cout << "The plan cannot be run, nothing has been started" << endl;
+			return 1;
+		}
+	}
+	else {
+		//Motive project (Must be in the application directory), opened once the tracking backend is set up
+		cout << "Project Path: \n";
+		cin >> plan.projectPath;
+		cout << plan.projectPath << "\n\n";
+
+		//Open a file for output data
+		cout << "Output Filename: ";
+		cin >> plan.outputName;
+
+		//Request number of trials
+		int NumTrials;
+		cout << "Number of trials";
+		cin >> NumTrials;
+
+		//Select COM number
+		cout << "Select Com Port: ";
+		cin >> plan.gantryPort;
+
+		for (int k = 0; k < NumTrials; k++) {
+			//int randx = rand() % 15;
+			//int randx = rand() % 29;
+			//int randz = rand() % 41;
+			//int randz = rand() % 41;
+
+			//int randz = -3; //-3 is back of box
+			int randz = 0;
+			int randx = 5; // 2 is center line- now 4?
+			
+			//int randx = 0;
+
+			//int randz = 21;
+			//int randx = 50;
+
+			//int randx = 13;
+
+			//int randz = 24;
+			//int randx = 19;
+
+			//int randx;
+			//if (trial < 100) {
+				//int randx = 28 + 30;
+			//}
+			//else{
+				//randx = -20;
+			//}
+
+			//int randz = 27; 
+			//int randx = 5;
+
+			//randx = 9;
+			//int randz = 20 + 5;
+
+			float Zic = -370 + randz * 10 + k * 20 + 40 - 675 + 10;
+			float Xic = -140 + 60 + 120 + randx * 10 + 10 - 30 - 170;
+
+			PlannedTrial planned;
+			planned.xic = Xic;
+			planned.zic = Zic;
+			planned.amplitude = plan.gait.amplitude;
+			plan.trials.push_back(planned);
+		}
+
+		if (!plan.Validate()) {
+			for (size_t i = 0; i < plan.errors.size(); i++) {
+				cout << "Plan: " << plan.errors[i] << endl;
+			}
+			return 1;
+		}
+	}
+	plan.Print();
+	gait = plan.gait;
+	const int NumTrials = (int)plan.trials.size();
+
+	//A plan batch keeps a journal next to its trial files (see BatchJournal.h),
+	//so launching the same plan again carries on where the last launch stopped
+	BatchJournal* journal = new BatchJournal();
+	if (argc >= 2) {
+		if (!journal->Open((plan.outputName + ".journal").c_str(), plan.Fingerprint(), NumTrials)) {
+			return 1;
+		}
+		if (journal->Complete()) {
+			cout << "Every trial in the plan has been run already" << endl;
+			return 0;
+		}
+	}
+
+#pragma endregion
 
 	/*******************************************************************
 	Dynamixel Initialization
@@ -212,7 +427,7 @@ int main()
 	// Initialize PortHandler instance
 	// Set the port path
 	// Get methods and members of PortHandlerLinux or PortHandlerWindows
-	portHandler = dynamixel::PortHandler::getPortHandler(DEVICENAME);
+	portHandler = dynamixel::PortHandler::getPortHandler(plan.snakePort.c_str());
 
 	// Initialize PacketHandler instance
 	// Set the protocol version
@@ -341,8 +556,6 @@ int main()
 	int dataLength = 255;
 	int readResult = 0;
 
-	char comNum[10];
-
 	bool writeResult;
 	bool writeResult3;
 	bool writeResultclear;
@@ -351,33 +564,13 @@ int main()
 	State state = TRACKING_SNAKE;
 	GantryState gstate = UPDATE_POSITION;
 
-	//Optitrack project variables
-	char project_Path[255];
-
 	//Output file variables
 	string filename = string();
 	string basefilename = string();
 	string finalfilename = string();
-	ofstream outputFile;
-	ofstream debugLog;
-
-
-
-	//Initialize NPTrackingTools
-	TT_Initialize();
-
-	cout << "Welcome to the gantry app!\n\n";
-
-	//Open Motive project (Must be in the application directory)
-	cout << "Project Path: \n";
-	cin >> project_Path;
-	cout << project_Path << "\n\n";
-	CheckResult(TT_LoadProject(project_Path));
-
-	//Open a file for output data
-	cout << "Output Filename: ";
-	cin >> filename;
-	basefilename = filename;
+	//Trial data, debugLog.txt and the run loop's console output are written on a separate thread
+	AsyncLog* logger = new AsyncLog();
+	basefilename = plan.outputName;
 
 
 	/*time_t now = time(0);
@@ -392,13 +585,9 @@ int main()
 	filename.append(".csv");
 
 	outputFile.open(filename);*/
-	debugLog.open("debugLog.txt");
-	debugLog << "Open DB" << endl;
-
-	//Request number of trials
-	int NumTrials;
-	cout << "Number of trials";
-	cin >> NumTrials;
+	logger->OpenDebug("debugLog.txt");
+	logger->Start();
+	logger->Text(LOG_DEBUG, "Open DB");
 
 	//Initialize Optitrack variables
 	bool G_Trackable = false;
@@ -413,43 +602,164 @@ int main()
 	//float hyaw, hpitch, hroll, hx = 0, hy = 0, hz = 0, hqx, hqy, hqz, hqw;
 	double t0 = 0;
 	double t = 0;
-	double prev_t = 0;
 	float* pos = new float[2];
-	outputFile << "Time,\t\tMarker ID,\t\tX Pos,\t\tY Pos,\t\tZ Pos\n";
 	int init_count = 0;
-	float* xPos;
-	float* yPos;
-	float* zPos;
+	//Marker frames are recycled, sized to the most markers seen. The pool
+	//covers everything the tracking queue can hold plus the frames in use.
+	MarkerFramePool* framePool = new MarkerFramePool(2 * TRACKING_QUEUE_SIZE, 64);
 	float angle;
 	int numMarkers;
-	const int stmax = 5;
+	const int stmax = plan.gait.cycles;
 
 	//Create Snake object
 	//Snake* snake = new Snake(14, &xPos, &yPos, &zPos, &numMarkers);
 
-	//Select COM number
-	cout << "Select Com Port: ";
-	cin >> comNum;
-
-
-	//Adds \\.\ before the COM number
-	for (int i = 4; i >= 0; i--) {
-		comNum[4 + i] = comNum[i];
-		comNum[i] = '\\';
-	}
-
-	comNum[2] = '.';
-	comNum[9] = '\0';
-	if (comNum[8] == '\n') {
-		comNum[8] = '\0';
-	}
-
 	//Open COM port
-	Serial* SP = new Serial(comNum);
+#if SIMULATED_DEVICES
+	SimulatedArduino* arduino = new SimulatedArduino();
+	arduino->feedRate = plan.gantry.travelSpeed;
+	arduino->acceleration = plan.gantry.travelAcceleration;
+	SerialLink* link = arduino;
+#elif defined(SERIAL_REPLAY_FILE)
+	SerialLink* link = new ReplaySerialLink(SERIAL_REPLAY_FILE, SERIAL_REPLAY_MODE);
+#else
+	SerialLink* link = new HardwareSerialLink(ExperimentPlan::DevicePath(plan.gantryPort).c_str());
+#if SERIAL_CAPTURE
+	string captureFilename = basefilename + ".gsc";
+	link = new CaptureSerialLink(link, captureFilename.c_str());
+	logger->Text(LOG_DEBUG, "Serial capture " + captureFilename);
+#endif
+#endif
+
+	//One reader thread sorts everything the Arduino sends into mailboxes
+	SerialDemux* SP = new SerialDemux(link);
+
+	//Gantry position and state from GRBL, polled in the background
+	GrblStatusPoller* grbl = new GrblStatusPoller(SP, GRBL_STATUS_RATE);
+#if GRBL_STATUS_POLLING
+	grbl->Start();
+#endif
+	GrblStatus grblStatus;
 
 	if (SP->IsConnected())
 		cout << "We're connected\n\n";
-	debugLog << "Connected" << endl;
+	logger->Text(LOG_DEBUG, "Connected");
+
+	//Magnet contact check shares the Arduino port
+	MagnetSensor* magnetSensor = new MagnetSensor(SP);
+
+	//Camera frames for the snake run are read on their own thread
+#if SIMULATED_DEVICES
+	TrackingBackend* tracking = new SimulatedTracking(arduino);
+#elif defined(TRACKING_REPLAY_FILE)
+	TrackingBackend* tracking = new ReplayTrackingBackend(TRACKING_REPLAY_FILE, SERIAL_REPLAY_MODE);
+#else
+	TrackingBackend* tracking = new MotiveBackend();
+#endif
+
+	//One Motive session for every trial, only the enabled rigid bodies change
+	TrackingSession* session = new TrackingSession(tracking, numRigidBodies);
+	if (!session->Open(plan.projectPath.c_str())) {
+		printf("Could not open Motive project %s\n", plan.projectPath.c_str());
+		exit(1);
+	}
+	TrackingProducer* tracker = new TrackingProducer(tracking, framePool);
+
+	//Marker IDs follow each marker from frame to frame within a run
+	MarkerTracker* labeler = new MarkerTracker();
+	tracker->SetLabeler(labeler);
+
+	//Center of mass, heading and curvature of the snake, updated every frame
+	SnakeShapeEstimator* snakeShape = new SnakeShapeEstimator();
+	tracker->SetShapeEstimator(snakeShape);
+	SnakeShape startShape, endShape;
+	bool haveStartShape = false;
+
+	//Time of each phase of a run loop pass, and of the camera update on the tracking thread
+	LoopStats* loopStats = new LoopStats(LOOP_DEADLINE_MS / 1000.0);
+	int loopContactRequest = loopStats->Phase("contact request");
+	int loopSleep = loopStats->Phase("sleep");
+	int loopContactRead = loopStats->Phase("contact read");
+	int loopFrames = loopStats->Phase("frames");
+	int loopController = loopStats->Phase("controller");
+	int loopSnakeWrite = loopStats->Phase("snake write");
+	LatencyHistogram* cameraUpdate = new LatencyHistogram();
+	tracker->SetUpdateTimes(cameraUpdate);
+	loopStats->Include("Tracking update", cameraUpdate);
+
+	//Rigid body reads between runs wait for the pose to hold still
+	PoseSettler* settler = new PoseSettler(tracking);
+	RigidBodyPose settled;
+	//unsettled gantry reads while it travels
+	RigidBodyPose gantryBody;
+
+	//Gantry head position between settled reads, from tracking, GRBL and the moves sent
+	GantryEstimator* gantryEstimator = new GantryEstimator();
+	gantryEstimator->feedRate = plan.gantry.travelSpeed;
+	GantryEstimate gantryPose;
+
+	//Final alignment over the snake is closed loop on the tracked gantry
+	VisualServo* servo = new VisualServo(tracking, SP, grbl, gantryEstimator);
+	servo->tolerance = GANTRY_ALIGN_TOLERANCE;
+#if VISUAL_SERVO_JOGS
+	servo->jog = true;
+#endif
+	ServoResult servoResult;
+
+	//Pickup move: travel and end effector turn on one trajectory
+	MotionPlanner* planner = new MotionPlanner(SP, grbl, gantryEstimator, plan.gantry);
+
+	//Waits after gantry and Firgelli commands sized to each command
+	MoveDuration* durations = new MoveDuration(plan.gantry);
+	durations->firgelliStroke = FIRGELLI_STROKE;
+	durations->firgelliSpeed = FIRGELLI_SPEED;
+#if FIRGELLI_MEASURED
+	durations->firgelliMeasured = true;
+#endif
+
+	//Starts the plan has to cover, in machine mm from the tracking origin;
+	//the first trial runs from the first one and the scheduler orders the
+	//rest by where each trial leaves the snake. A resumed batch leaves out
+	//the trials that have run and starts where the journal says.
+	TrialScheduler* scheduler = new TrialScheduler(durations);
+	for (size_t k = 0; k < plan.trials.size(); k++) {
+		scheduler->Add(-plan.trials[k].xic, plan.trials[k].zic);
+	}
+	InitialCondition initialCondition;
+	BatchResume resume = journal->Restore(scheduler, &initialCondition);
+	if (resume.resumed) {
+		printf("Resuming at trial %d, planned trial %d\n", resume.trial, initialCondition.index);
+		if (!resume.placed) {
+			printf("Put the snake at its start (Xic %.0f, Zic %.0f) and press enter\n", -initialCondition.x, initialCondition.z);
+			cin.get();
+		}
+	}
+
+	//Tracking to machine map for every move, probed once and kept in a file;
+	//delete the file to probe again after the cameras or the rails move.
+	//Probing drives the gantry, so it waits for the operator like every other move
+	if (!gantryEstimator->calibration.Load(GANTRY_CALIBRATION_FILE)) {
+		printf("No %s. The gantry will move up to %d mm along each axis to probe it.\n", GANTRY_CALIBRATION_FILE, CALIBRATION_PROBE_SPAN);
+		cout << "Clear the gantry's path and type y to probe, anything else to run on the nominal axes: ";
+		string answer;
+		cin >> answer;
+		if ((answer == "y") || (answer == "Y")) {
+			cout << "Probing the gantry calibration" << endl;
+			session->SetProfile(PROFILE_RIGID_BODIES);
+			if (ProbeCalibration(SP, settler, grbl, &gantryEstimator->calibration, CALIBRATION_PROBE_SPAN)) {
+				gantryEstimator->calibration.Save(GANTRY_CALIBRATION_FILE);
+			}
+			else {
+				cout << "Calibration failed, moving on the nominal axes" << endl;
+			}
+		}
+		else {
+			cout << "Not probed, moving on the nominal axes" << endl;
+		}
+	}
+	const GantryCalibration& calibration = gantryEstimator->calibration;
+	logger->Value(LOG_DEBUG, "Calibration residual mm ", 1000 * calibration.rms, false);
+	logger->Value(LOG_DEBUG, " points ", calibration.points);
 
 	srand(time(0));
 
@@ -487,11 +797,18 @@ int main()
 	//float AngleIn[8] = {0, -35, -35, -35, -35, -35, -35, -35 };
 	float delA;
 
+	//each trial's timeline goes out when the next trial starts, or the batch stops
+	string traceFilename;
+	Trace::NameThread("control loop");
+
 	//Begin program loop as long as COM port is open
-	for (int trial = 0; trial < NumTrials; trial++)
+	for (int trial = resume.trial; trial < NumTrials; trial++)
 	{
-		if (trial > 0) {
-			outputFile.close();
+		if (trial > resume.trial) {
+			logger->CloseTrial();
+		}
+		if (!traceFilename.empty()) {
+			Trace::Export(traceFilename.c_str());
 		}
 		//reset the file name for the next iteration of the loop
 		//cout << "filename before reset :" << ",\t" << filename;
@@ -509,9 +826,20 @@ int main()
 		filename.append(to_string(1 + ltm->tm_sec));
 		filename.append("Trial");
 		filename.append(to_string(trial));
-		filename.append(".csv");
+		filename.append(".gtl");
+
+		logger->OpenTrial(filename, trial, plan.projectPath.c_str(), SNAKE_MARKERS);
+		journal->Started(trial, initialCondition.index, filename);
+#if TRACE_TRIALS
+		traceFilename = filename + ".trace.json";
+		Trace::Start();
+		Trace::Instant("trial", to_string(trial).c_str());
+#endif
 
-		outputFile.open(filename);
+		//the gait of the start the scheduler set up
+		gait.amplitude = plan.trials[initialCondition.index].amplitude;
+		logger->Value(LOG_TRIAL, "Planned Trial,\t\t", initialCondition.index);
+		logger->Value(LOG_TRIAL, "Amplitude,\t\t", gait.amplitude);
 
 		cout << endl;
 
@@ -544,8 +872,8 @@ int main()
 
 		//update optitrack, throw away first 5 frames?
 		//cout << "Tracking \n";
-		TT_Update();
-		t = TT_FrameTimeStamp();
+		tracking->Update();
+		t = tracking->FrameTimeStamp();
 		if (t0 != t) {
 			t0 = t;
 			//if (init_count < 5) {
@@ -560,13 +888,10 @@ int main()
 
 				// Disable rigid body tracking for writing optitrack data to file
 			cout << "Tracking Snake \n";
-			for (int i = 0; i < numRigidBodies; i++) {
-				if (TT_RigidBodyEnabled(i)) {
-					TT_SetRigidBodyEnabled(i, false);
-				}
-			}
+			session->SetProfile(PROFILE_RAW_MARKERS);
 
 			//Check the motors are connected
+			Trace::Begin("snake motors");
 			bool snake_break = false;
 			int snake_count = 0;
 			int Error_count = 0;
@@ -604,6 +929,7 @@ int main()
 				}
 			}
 
+			Trace::End();
 			if (snake_break == true) {
 				break;
 			}
@@ -612,14 +938,9 @@ int main()
 			snakeInitialPosition();
 
 			if (st == 0) {
-				string outputDataSnake = "";
-				outputDataSnake.append("moveZ");
-				outputDataSnake.append(to_string(1600));
-				//outputDataSnake.append(to_string(2000));
 				cout << "moving gantry with snake" << endl;
-
-				outputDataSnake.append(pcr, 0, 1);
-				writeResult = SP->WriteData((char*)outputDataSnake.c_str(), outputDataSnake.length());
+				writeResult = SendCommand(SP, GantryCommand::MoveZ(1600));
+				//writeResult = SendCommand(SP, GantryCommand::MoveZ(2000));
 			}
 
 
@@ -639,6 +960,7 @@ int main()
 			double LoopTime = 0;
 
 			string prev_input = "0000";
+			string contactState = "0000";
 			string end_state = "";
 			string wend_state = "";
 			int ContactCounter = 0;
@@ -671,16 +993,24 @@ int main()
 			//only for testing controller
 			//int angle_idx = trial % 8;
 
+			//Markers are queued by the tracking thread from here to the end of the run
+			labeler->Reset();
+			snakeShape->Reset();
+			haveStartShape = false;
+			loopStats->Reset();
+			cameraUpdate->Reset();
+			//the contact loop has the serial port to itself during the run
+			grbl->Stop();
+			tracker->Start();
+			Trace::Begin("run");
+
 			//Threshold
 			while (st < stmax) {
-
-				//update optitrack, throw away first 5 frames
-				//cout << "Tracking \n";
+				Trace::Instant("gait step");
+				loopStats->Begin();
 
 				//commenting out camera stuff to see if snake performance improves
 
-				TT_Update();
-				t = TT_FrameTimeStamp();
 				//if (t0 != t) {
 					//t0 = t;
 					//if (init_count < 5) {
@@ -688,37 +1018,27 @@ int main()
 					//}
 
 
-				numMarkers = TT_FrameMarkerCount();
-				xPos = new float[numMarkers];
-				yPos = new float[numMarkers];
-				zPos = new float[numMarkers];
-
 				//string last_input[6];
 				//string prev_input = last_input;
 
-				int read_result = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
+				writeResult = SendCommand(SP, GantryCommand::RequestContact());
+				loopStats->Mark(loopContactRequest);
 
-				string outputDataContact = "";
-				outputDataContact.append("data");
-
-				outputDataContact.append(pcr, 0, 1);
-				writeResult = SP->WriteData((char*)outputDataContact.c_str(), outputDataContact.length());
-				                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                              
-				Sleep(8);
+				Sleep(LOOP_SLEEP_MS);
 				//Sleep(12);
+				loopStats->Mark(loopSleep);
 
-				read_result = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
+				//keeps the previous state if no reply has arrived yet
+				SP->WaitLatest(MESSAGE_CONTACT, &contactState, 0);
+				loopStats->Mark(loopContactRead);
 
 				//turns torque back on if turned off in previous loop
 				//dxl_comm_result = packetHandler->write1ByteTxRx(portHandler, 1, ADDR_MX_TORQUE_ENABLE, TORQUE_ENABLE, &dxl_error);
 
-				string input(incomingSnakeData);
-
-				//cout << "Read Result: " << read_result << endl;
-				//cout << incomingSnakeData << endl;
+				//cout << contactState << endl;
 				//cout << endl;
 
-				string last_input = input.substr(0,4);
+				string last_input = contactState.substr(0,4);
 				//string prev_input;
 
 				//cout << "Contact State Test: " << last_input << endl;
@@ -744,30 +1064,29 @@ int main()
 
 				//__int64 now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 
-				if (prev_t == t) {
+			//Collect data and write to excel, commenting out for IRIM video
+				//Every frame queued since the last pass is logged, the gait
+				//only steps when at least one new frame has arrived
+				MarkerFrame* frame;
+				bool newFrame = false;
+				while (tracker->Pop(&frame)) {
+					newFrame = true;
+					t = frame->time;
+					numMarkers = frame->count;
+					logger->Frame(frame, last_input.c_str());
+					tracker->Release(frame);
+				}
+				loopStats->Mark(loopFrames);
+
+				if (!newFrame) {
 					//cout << "Skip this loop" << endl;
 					continue;
 				}
 
-			//Collect data and write to excel, commenting out for IRIM video
-				for (int i = 0; i < numMarkers; i++) {
-					xPos[i] = TT_FrameMarkerX(i);
-					yPos[i] = TT_FrameMarkerY(i);
-					zPos[i] = TT_FrameMarkerZ(i);
-					//cout << last_input << endl;
-					//cout << endl;
-					//cout << endl;
-					//Sleep();
-					outputFile << to_string(t) << ",\t\t" << to_string(i) << ",\t\t" << xPos[i] << ",\t\t" << yPos[i] << ",\t\t" << zPos[i] << ",\t\t" << last_input << endl;
-					//outputFile << to_string(t) << ",\t\t" << to_string(i) << ",\t\t" << xPos[i] << ",\t\t" << yPos[i] << ",\t\t" << zPos[i] << ",\t\t" << incomingSnakeData << endl;
-					//cout << to_string(t) << ",\t\t" << to_string(i) << ",\t\t" << last_input << endl;
-					//cout << to_string(t) << ",\t\t" << last_input << endl;
-					//outputFile << to_string(t) << ",\t\t" << last_input << endl;
+				//travel is measured from the first shape of the run
+				if (!haveStartShape) {
+					haveStartShape = snakeShape->Latest(&startShape);
 				}
-				delete[] xPos;
-				delete[] yPos;
-				delete[] zPos;
-				string incomingSnakeData = "";
 
 
 				if ((last_input == "0100") || (last_input == "0010") || (last_input == "0110")) {
@@ -787,14 +1106,14 @@ int main()
 				// Detect Contact Start
 				///////////////////////////////////////////////
 
-				if ((ContactCounter == 3)&&(InitialContact == false) && (WaitState == false)) {
+				if ((ContactCounter == plan.steering.contactSamples)&&(InitialContact == false) && (WaitState == false)) {
 
 
 					InitialContact = true;
 					ActualStart = t;
 					ContactStart = st;
-					cout << "First Contact Made!" << endl;
-					cout << "First Start Time: " << st << endl;
+					logger->Text(LOG_CONSOLE, "First Contact Made!");
+					logger->Value(LOG_CONSOLE, "First Start Time: ", st);
 
 
 					//ContactEnd = ContactStart + 1;
@@ -832,7 +1151,7 @@ int main()
 
 
 
-					if (EndCounter == 3) {
+					if (EndCounter == plan.steering.contactSamples) {
 						ContactEnd = st;
 						ActualEnd = t;
 						
@@ -842,22 +1161,22 @@ int main()
 
 						//end of contact
 						//cout << "Contact Over!" << endl;
-						cout << "First End Time: " << st << endl;
+						logger->Value(LOG_CONSOLE, "First End Time: ", st);
 						
 
-						cout << "First End State: " << end_state << endl;
+						logger->Text(LOG_CONSOLE, "First End State: " + end_state);
 
 						if ((end_state == "0100") || (end_state == "1100")) {
-							cout << "Contact Left! Steering Positive" << endl;
+							logger->Text(LOG_CONSOLE, "Contact Left! Steering Positive");
 							sign = -1;
 
 						}
 						else if ((end_state == "0010") || (end_state == "0011")) {
-							cout << "Contact Right! Steering Negative" << endl;
+							logger->Text(LOG_CONSOLE, "Contact Right! Steering Negative");
 							sign = 1;
 						}
 						else {
-							cout << "Controller Error -- Undefined Contact -- No Steering" << endl;
+							logger->Text(LOG_CONSOLE, "Controller Error -- Undefined Contact -- No Steering");
 							sign = 0;
 						}
 
@@ -899,13 +1218,13 @@ int main()
 					///////////////////////////////////////////
 					// Detecting Second Contact start
 					///////////////////////////////////////////
-					if ((wContactCounter == 3) && (wInitialContact == false)) {
+					if ((wContactCounter == plan.steering.contactSamples) && (wInitialContact == false)) {
 
 						wInitialContact = true;
 						wActualStart = t;
 						wContactStart = st;
-						cout << "Second Contact Made!" << endl;
-						cout << "Second Start Time: " << st << endl;
+						logger->Text(LOG_CONSOLE, "Second Contact Made!");
+						logger->Value(LOG_CONSOLE, "Second Start Time: ", st);
 					}
 
 					////////////////////////////////////////////
@@ -928,7 +1247,7 @@ int main()
 					}
 
 
-					if (wEndCounter == 3) {
+					if (wEndCounter == plan.steering.contactSamples) {
 						wContactEnd = st;
 						wActualEnd = t;
 
@@ -938,22 +1257,22 @@ int main()
 
 						//end of contact
 						//cout << "Contact Over!" << endl;
-						cout << "Second End Time: " << st << endl;
+						logger->Value(LOG_CONSOLE, "Second End Time: ", st);
 
 
-						cout << "Second End State: " << end_state << endl;
+						logger->Text(LOG_CONSOLE, "Second End State: " + end_state);
 
 						if ((wend_state == "0100") || (wend_state == "1100")) {
-							cout << "2nd Contact Left! Steering Positive" << endl;
+							logger->Text(LOG_CONSOLE, "2nd Contact Left! Steering Positive");
 							wsign = -1;
 
 						}
 						else if ((wend_state == "0010") || (wend_state == "0011")) {
-							cout << "Contact Right! Steering Negative" << endl;
+							logger->Text(LOG_CONSOLE, "Contact Right! Steering Negative");
 							wsign = 1;
 						}
 						else {
-							cout << "Controller Error -- Undefined Contact -- No Steering" << endl;
+							logger->Text(LOG_CONSOLE, "Controller Error -- Undefined Contact -- No Steering");
 							wsign = 0;
 						}
 
@@ -966,10 +1285,10 @@ int main()
 							sign = wsign;
 							ContactDuration = wContactDuration;
 							ActualDuration = wActualDuration;
-							cout << "Steering Based on Second Contact" << endl;
+							logger->Text(LOG_CONSOLE, "Steering Based on Second Contact");
 						}
 						else {
-							cout << "First Contact is longer than Second" << endl;
+							logger->Text(LOG_CONSOLE, "First Contact is longer than Second");
 						}
 
 
@@ -980,10 +1299,8 @@ int main()
 
 						// New Stuff
 						//ContactAngle = -25.07*(ActualDuration)+1.85;
-						PosContactAngle = 14.1*(ActualDuration)+2.3;
-						NegContactAngle = -25.2*(ActualDuration)+2.1;
-						PosContactAngle = (1.0 / 0.85)*PosContactAngle;
-						NegContactAngle = (1.0 / 0.85)*NegContactAngle;
+						PosContactAngle = plan.steering.ContactAngle(ActualDuration, -1);
+						NegContactAngle = plan.steering.ContactAngle(ActualDuration, 1);
 
 
 						//only for testing controller
@@ -992,8 +1309,9 @@ int main()
 						//ContactAngle = AngleIn[angle_idx];
 
 
-						cout << "Contact Duration: " << ContactDuration << ",\t\t" << "Actual Duration: " << ActualDuration << endl;
-						cout << "ContactAngle: " << ContactAngle << endl;
+						logger->Value(LOG_CONSOLE, "Contact Duration: ", ContactDuration, false);
+						logger->Value(LOG_CONSOLE, ",\t\tActual Duration: ", ActualDuration);
+						logger->Value(LOG_CONSOLE, "ContactAngle: ", ContactAngle);
 
 						//Experimental correction term
 						ContactAngle = (1.0 / 0.85)*ContactAngle;
@@ -1027,35 +1345,35 @@ int main()
 						}
 						//AMMStart = AMMStart / 2;
 
-						cout << "delA: " << delA << endl;
+						logger->Value(LOG_CONSOLE, "delA: ", delA);
 
 						//AMMStart = (AMMStart / 2) + 0.5;
 
 						if (delA < 0) {
 							//If expanding, steer ASAP
-							cout << "Steer now!" << endl;
+							logger->Text(LOG_CONSOLE, "Steer now!");
 							AMMStart = AMMStart / 2;
 						}
 						else {
 							//If contracting, steer next point of zero curvature
-							cout << "Wait to steer" << endl;
+							logger->Text(LOG_CONSOLE, "Wait to steer");
 							delA = -delA;
 							AMMStart = (AMMStart / 2) + 0.5;
 						}
 
 
 
-						cout << "AMM Start: " << AMMStart << endl;
+						logger->Value(LOG_CONSOLE, "AMM Start: ", AMMStart);
 
 
 					}
 
 					LoopTime = t - WaitInitialTime;
 
-					if (LoopTime > 1.0) {
+					if (LoopTime > plan.steering.contactWindow) {
 						WaitState = false;
 						FinalContact = true;
-						cout << "Only One Contact Detected" << endl;
+						logger->Text(LOG_CONSOLE, "Only One Contact Detected");
 
 
 						/////////////////////////////////////////
@@ -1069,18 +1387,16 @@ int main()
 
 						// New Stuff
 						//ContactAngle = -25.07*(ActualDuration)+1.85;
-						PosContactAngle = 14.1*(ActualDuration)+2.3;
-						NegContactAngle = -25.2*(ActualDuration)+2.1;
-
-						PosContactAngle = (1.0 / 0.85)*PosContactAngle;
-						NegContactAngle = (1.0 / 0.85)*NegContactAngle;
+						PosContactAngle = plan.steering.ContactAngle(ActualDuration, -1);
+						NegContactAngle = plan.steering.ContactAngle(ActualDuration, 1);
 
 
 						//ContactAngle = AngleIn[angle_idx];
 
 
-						cout << "Contact Duration: " << ContactDuration << ",\t\t" << "Actual Duration: " << ActualDuration << endl;
-						cout << "ContactAngle: " << ContactAngle << endl;
+						logger->Value(LOG_CONSOLE, "Contact Duration: ", ContactDuration, false);
+						logger->Value(LOG_CONSOLE, ",\t\tActual Duration: ", ActualDuration);
+						logger->Value(LOG_CONSOLE, "ContactAngle: ", ContactAngle);
 
 						//Experimental correction term
 						//ContactAngle = (1.0 / 0.85)*ContactAngle;
@@ -1113,22 +1429,22 @@ int main()
 						}
 						//AMMStart = AMMStart / 2;
 
-						cout << "delA: " << delA << endl;
+						logger->Value(LOG_CONSOLE, "delA: ", delA);
 
 						//AMMStart = (AMMStart / 2) + 0.5;
 
 						if (delA < 0) {
 							//If expanding, steer ASAP
-							cout << "Steer now!" << endl;
+							logger->Text(LOG_CONSOLE, "Steer now!");
 							AMMStart = AMMStart / 2;
 						}
 						else {
 							//If contracting, steer next point of zero curvature
-							cout << "Wait to steer" << endl;
+							logger->Text(LOG_CONSOLE, "Wait to steer");
 							delA = -delA;
 							AMMStart = (AMMStart / 2) + 0.5;
 						}
-						cout << "AMM Start: " << AMMStart << endl;
+						logger->Value(LOG_CONSOLE, "AMM Start: ", AMMStart);
 					}
 
 				}
@@ -1147,8 +1463,9 @@ int main()
 				//ContactAngle = AngleIn[angle_idx];
 
 
-				cout << "Contact Duration: " << ContactDuration << ",\t\t" << "Actual Duration: " << ActualDuration << endl;
-				cout << "ContactAngle: " << ContactAngle << endl;
+				logger->Value(LOG_CONSOLE, "Contact Duration: ", ContactDuration, false);
+				logger->Value(LOG_CONSOLE, ",\t\tActual Duration: ", ActualDuration);
+				logger->Value(LOG_CONSOLE, "ContactAngle: ", ContactAngle);
 
 				//Experimental correction term
 				ContactAngle = (1.0 / 0.85)*ContactAngle;
@@ -1171,25 +1488,25 @@ int main()
 				}
 				//AMMStart = AMMStart / 2;
 
-				cout << "delA: " << delA << endl;
+				logger->Value(LOG_CONSOLE, "delA: ", delA);
 
 				//AMMStart = (AMMStart / 2) + 0.5;
 
 				if (delA < 0) {
 					//If expanding, steer ASAP
-					cout << "Steer now!" << endl;
+					logger->Text(LOG_CONSOLE, "Steer now!");
 					AMMStart = AMMStart / 2;
 				}
 				else {
 					//If contracting, steer next point of zero curvature
-					cout << "Wait to steer" << endl;
+					logger->Text(LOG_CONSOLE, "Wait to steer");
 					delA = -delA;
 					AMMStart = (AMMStart / 2) + 0.5;
 				}
 
 
 
-				cout << "AMM Start: " << AMMStart << endl;
+				logger->Value(LOG_CONSOLE, "AMM Start: ", AMMStart);
 
 						//cout << "AMM Start" << AMMStart << endl;*/
 
@@ -1241,6 +1558,8 @@ int main()
 				//snakeAmplitudeModulation(st, ContactCondition);
 				//snakeUpdatePosition(st, ContactCondition);
 
+				loopStats->Mark(loopController);
+
 				/////////////////////////////////////////
 				//Implement Controller State
 				/////////////////////////////////////////
@@ -1270,73 +1589,63 @@ int main()
 					snakeUpdatePosition(st, ContactCondition);
 					//cout << "Normal Snake: " << st << endl;
 				}
+				loopStats->Mark(loopSnakeWrite);
 
 
 
 				//debugLog << "Snake Update Position. \n" << endl;
 				//std::thread first (snakeUpdatePosition,st,stmax);
-				//std::thread second (CollectData, st, outputFile);
 
 				//Sleep(9);
 
 				//snakeUpdatePosition(st, ContactCondition);
-				st += 2.5*dst;
-
-				prev_t = t;
+				st += plan.gait.phaseStep;
 
 				//add back in for snake data
 				prev_input = last_input;
+				loopStats->End();
 			}
 
 #pragma endregion
 
 
 
-			string outputDataStop = "";
-			outputDataStop.append("stop");
-
+			tracker->Stop();
+#if GRBL_STATUS_POLLING
+			grbl->Start();
+#endif
+			Trace::End();
+			//console lines from the run come out before anything printed directly
+			logger->Flush();
 			cout << "end of run" << endl;
-			outputDataStop.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputDataStop.c_str(), outputDataStop.length());
+			cout << "Tracking frames: " << tracker->Frames() << ", dropped: " << tracker->Dropped() << endl;
+			logger->Value(LOG_DEBUG, "Tracking frames ", tracker->Frames(), false);
+			logger->Value(LOG_DEBUG, " dropped ", tracker->Dropped(), false);
+			logger->Value(LOG_DEBUG, " peak markers ", framePool->PeakMarkers());
+			loopStats->Summary(logger);
+			if (logger->Dropped(LOG_TRIAL) > 0) {
+				logger->Value(LOG_CONSOLE, "Trial rows dropped by the log writer: ", (double)logger->Dropped(LOG_TRIAL));
+			}
 
-			Sleep(5000);
+			//where the snake ended up, straight from the markers
+			if (haveStartShape && snakeShape->Latest(&endShape)) {
+				logger->Value(LOG_TRIAL, "End COM X,\t\t", endShape.x);
+				logger->Value(LOG_TRIAL, "End COM Z,\t\t", endShape.z);
+				logger->Value(LOG_TRIAL, "End Heading,\t\t", endShape.heading);
+				logger->Value(LOG_TRIAL, "End Curvature,\t\t", endShape.curvature);
+				logger->Value(LOG_TRIAL, "Travel,\t\t", hypot(endShape.x - startShape.x, endShape.z - startShape.z));
+				logger->Value(LOG_TRIAL, "Travel Heading,\t\t", (180.0 / 3.14159) * atan2(endShape.z - startShape.z, endShape.x - startShape.x));
+			}
+			writeResult = SendCommand(SP, GantryCommand::Stop());
 
 			//cout << "End here" << endl;
 			//Sleep(20000);
 
-			//cout << "before reset \n\n";
-
-			//reset optitrack
-			//TT_Update();
-			//Sleep(10000);
-			//TT_Shutdown();
-			//Sleep(3000);
-
-			//Initialize NPTrackingTools
-			TT_Initialize();
-
-			//cout << "gantry app reinitialized! \n\n";
-			//Sleep(3000);
-
-
-			//Open Motive project (Must be in the application directory)
-			//cout << "Project Path: \n";
-			//cin >> project_Path;
-			//cout << project_Path << "\n\n";
-			CheckResult(TT_LoadProject(project_Path));
-
-			Sleep(3000);
-
-			TT_Update();
-
-			for (int i = 0; i < numRigidBodies; i++) {
-				if (~TT_RigidBodyEnabled(i)) {
-					TT_SetRigidBodyEnabled(i, true);
-				}
-			}
-
-			Sleep(10);
+			//Same Motive session, rigid bodies back on for the gantry moves.
+			//Reads below wait for the poses to settle.
+			session->SetProfile(PROFILE_RIGID_BODIES);
 			state = TRACKING_GANTRY;
+			journal->Ran(trial);
 
 			/**********************************************
 			state = Tracking Gantry
@@ -1347,6 +1656,7 @@ int main()
 			cout << "Tracking Gantry. \n" << endl;
 
 			st = 0;
+			Trace::Begin("fixed sleep", "snake home 4 s");
 			snakeInitialPosition();
 			Sleep(1000);
 			snakeInitialPosition();
@@ -1355,6 +1665,7 @@ int main()
 			Sleep(1000);
 			snakeInitialPosition();
 			Sleep(1000);
+			Trace::End();
 
 			//is this needed? i forget what it does
 			/*while (t0 != t) {
@@ -1374,60 +1685,31 @@ int main()
 
 #pragma region "Target Location"
 
-			Sleep(1000);
-			TT_Update();
-			Sleep(1000);
-
 			//cout << "contact 1 \n" << endl;
 
-			for (int i = 0; i < 600; i++) {
-				TT_Update();
-			}
-
-			Sleep(1000);
-			TT_Update();
-			Sleep(1000);
-
 			// too computationally expensive to be in the loop
-			TT_RigidBodyLocation(1, &c1x, &c1y, &c1z, &c1qx, &c1qy, &c1qz, &c1qw, &c1yaw, &c1pitch, &c1roll);
+			settler->Acquire(1, &settled);
+			c1x = settled.x;
+			c1y = settled.y;
+			c1z = settled.z;
 			cout << to_string(t) << ",\t" << "Contact 1" << ",\t" << c1x << ",\t" << c1z << '\n';
 
-			Sleep(1000);
-			TT_Update();
-			Sleep(1000);
-
 			if (c1z < .1) {
 
 				//could not correctly identify a snake marker
 
-				string outputDataS1 = "";
-				outputDataS1.append("moveZ");
-				outputDataS1.append(to_string(-150));
-
 				cout << "move to target \n" << endl;
+				writeResult = SendCommand(SP, GantryCommand::MoveZ(-150));
 
-				outputDataS1.append(pcr, 0, 1);
-				writeResult = SP->WriteData((char*)outputDataS1.c_str(), outputDataS1.length());
-
-				Sleep(10000);
-
-
-				for (int i = 0; i < 600; i++) {
-					TT_Update();
-				}
+				durations->WaitMotion(SP, "marker search move", durations->Move(0, -150), 10);
 
 				// search for snake markers again
-				TT_RigidBodyLocation(1, &c1x, &c1y, &c1z, &c1qx, &c1qy, &c1qz, &c1qw, &c1yaw, &c1pitch, &c1roll);
+				settler->Acquire(1, &settled);
+				c1x = settled.x;
+				c1y = settled.y;
+				c1z = settled.z;
 				cout << to_string(t) << ",\t" << "Contact 1" << ",\t" << c1x << ",\t" << c1z << '\n';
 
-				Sleep(1000);
-
-				for (int i = 0; i < 600; i++) {
-					TT_Update();
-				}
-
-				Sleep(1000);
-
 			}
 
 
@@ -1439,42 +1721,29 @@ int main()
 
 			//cout << "contact 2 \n" << endl;
 
-			TT_RigidBodyLocation(2, &c2x, &c2y, &c2z, &c2qx, &c2qy, &c2qz, &c2qw, &c2yaw, &c2pitch, &c2roll);
+			settler->Acquire(2, &settled);
+			c2x = settled.x;
+			c2y = settled.y;
+			c2z = settled.z;
 			cout << to_string(t) << ",\t" << "Contact 2" << ",\t" << c2x << ",\t" << c2z << '\n';
 
-			Sleep(1000);
-			TT_Update();
-			Sleep(1000);
-
 
 			if (c2z < .1) {
 
 				//could not correctly identify a snake marker
 
-				string outputDataS2 = "";
-				outputDataS2.append("moveZ");
-				outputDataS2.append(to_string(-150));
-
 				cout << "move to target \n" << endl;
+				writeResult = SendCommand(SP, GantryCommand::MoveZ(-150));
 
-				outputDataS2.append(pcr, 0, 1);
-				writeResult = SP->WriteData((char*)outputDataS2.c_str(), outputDataS2.length());
-
-				Sleep(10000);
-
-
-				for (int i = 0; i < 600; i++) {
-					TT_Update();
-				}
+				durations->WaitMotion(SP, "marker search move", durations->Move(0, -150), 10);
 
 				// search for snake markers again
-				TT_RigidBodyLocation(2, &c2x, &c2y, &c2z, &c2qx, &c2qy, &c2qz, &c2qw, &c2yaw, &c2pitch, &c2roll);
+				settler->Acquire(2, &settled);
+				c2x = settled.x;
+				c2y = settled.y;
+				c2z = settled.z;
 				cout << to_string(t) << ",\t" << "Contact 2" << ",\t" << c2x << ",\t" << c2z << '\n';
 
-				Sleep(1000);
-				TT_Update();
-				Sleep(1000);
-
 			}
 
 
@@ -1494,9 +1763,7 @@ int main()
 			//delete[] xPos;
 			//delete[] yPos;
 			//delete[] zPos;
-			if (!TT_RigidBodyEnabled(0)) {
-				TT_SetRigidBodyEnabled(0, true);
-			}
+			session->SetRigidBodyEnabled(0, true);
 
 			cout << "Tracking Gantry.\n";
 
@@ -1505,7 +1772,11 @@ int main()
 #pragma region "First move to Target"
 
 
-			TT_RigidBodyLocation(0, &gx, &gy, &gz, &gqx, &gqy, &gqz, &gqw, &gyaw, &gpitch, &groll);
+			settler->Acquire(0, &settled);
+			gantryEstimator->AddTracking(GrblClock(), settled.x, settled.z);
+			gx = settled.x;
+			gy = settled.y;
+			gz = settled.z;
 			//outputFile << to_string(t) << ",\t" << "Gantry" << ",\t" << gx << ",\t" << gz << '\n';
 
 			cout << "gantry initial position" << ",t" << gx << ",\t" << gz << endl;
@@ -1518,7 +1789,8 @@ int main()
 			ax = gx;
 			az = gz;
 
-			dx = pos[0] - ax;
+			//the point the fine alignment aims for, 3 mm short in X
+			dx = pos[0] - 0.003f - ax;
 			dz = pos[1] - az;
 
 			cout << "calculate difference \n" << endl;
@@ -1528,31 +1800,15 @@ int main()
 
 			// clear serial monitor
 			cout << "Clear serial monitor" << endl;
-			string outputclear22 = "";
-			outputclear22.append(pcr, 0, 1);
-			writeResultclear = SP->WriteData((char*)outputclear22.c_str(), outputclear22.length());
+			writeResultclear = SendCommand(SP, GantryCommand::Clear());
 			cout << "Write Result Clear: " << to_string(writeResultclear) << endl;
 
-			string outputData = "";
-			outputData.append("moveZ");
-			outputData.append(to_string(dz * 1000));
-			outputData.append(",X");
-			//outputData.append(to_string((dx * 1000)));
-			outputData.append(to_string(-1*(dx * 1000)));
-
-			cout << "move to target \n" << endl;
-
-			outputData.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputData.c_str(), outputData.length());
-
-			Sleep(1000);
-
 			//added hardcoded offset on motor angle based on observed behavior
 			double theta;
 			int motor;
 			theta = ((180.0 / 3.14159)*atan((c2x - c1x) / (c2z - c1z)) + 90);
 
-			outputFile << "Final Angle" << ",\t\t" << theta << endl;
+			logger->Value(LOG_TRIAL, "Final Angle,\t\t", theta);
 
 
 			//motor = int((theta - 38.7931) / (.77586207) + 2);
@@ -1561,1146 +1817,233 @@ int main()
 			//motor = int(1.3556*theta - 32);
 			motor = int(1.35556*theta - 35);
 
-			string outputData2 = "";
-			outputData2.append("rots");
-			outputData2.append(to_string(motor));
-
 			//outputFile << to_string(t) << ",\t" << "theta" << ",\t" << theta << "motor" << ",\t" << motor << '\n';
 			cout << to_string(t) << ",\t" << "theta" << ",\t" << theta << ",\t" << "motor" << ",\t" << motor << '\n';
 
-			outputData2.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputData2.c_str(), outputData2.length());
+			//travel and end effector turn as one move, the turn happening on the way
+			cout << "move to target \n" << endl;
+			float moveX, moveZ;
+			calibration.ToMachine(dx, dz, &moveX, &moveZ);
+			Trajectory pickup = planner->Plan(moveX, moveZ, (float)motor);
+			logger->Value(LOG_DEBUG, "Pickup move seconds ", pickup.Duration());
+			Trace::Begin("pickup move");
+			writeResult = planner->Execute(pickup);
 
 			cout << "Wait while moving to snake" << endl;
-			int read_result5 = SP->ReadData((char*)incomingData, MAX_DATA_LENGTH);
-			cout << "Serial monitor before moving to snake: " << incomingData << endl;
+			SP->Flush(MESSAGE_MOTION);
 
-			string Wait3 = "wait";
-			writeResult = SP->WriteData((char*)Wait3.c_str(), Wait3.length());
+			writeResult = SendCommand(SP, GantryCommand::Wait());
 			cout << "To snake Wait write result " << writeResult << endl;
 
-			Sleep(1000);
-
-			string Wait4 = "wait";
-			writeResult = SP->WriteData((char*)Wait4.c_str(), Wait4.length());
-
 
 			double secondsPassed;
 			clock_t startTime = clock(); //Start timer
 
+			string motionMessage;
 			while (SP->IsConnected()) {
-				//char* prevData = (char*)incomingData;
-				//Check if data has been read or not
-				int read_result = SP->ReadData((char*)incomingData, MAX_DATA_LENGTH);
-
-				//prints out data
-				if (read_result > 0) {
-					cout << to_string(read_result) << endl;
-					cout << incomingData << endl;
-
+				//wait a bit for the gantry to report
+				if (SP->Wait(MESSAGE_MOTION, &motionMessage, 1000)) {
+					cout << motionMessage << endl;
+					break;
+				}
 
-					string input(incomingData);
-					string last_input = input.substr(0, 11);
-					cout << last_input << endl;
+				if (grbl->Latest(&grblStatus)) {
+					printf("GRBL %s: MPos (%.3f, %.3f, %.3f)\n",
+						GrblStateName(grblStatus.state), grblStatus.mpos[0], grblStatus.mpos[1], grblStatus.mpos[2]);
+					gantryEstimator->AddGrbl(grblStatus);
+				}
 
-					if (last_input == "done moving") {
-						break;
-					}
-					string incomingData = "";
-					input = "";
-					last_input = "";
+				//through the backend, so simulated and replayed runs never touch Motive
+				tracking->RigidBodyLocation(0, &gantryBody);
+				gx = gantryBody.x;
+				gy = gantryBody.y;
+				gz = gantryBody.z;
 
-					TT_RigidBodyLocation(0, &gx, &gy, &gz, &gqx, &gqy, &gqz, &gqw, &gyaw, &gpitch, &groll);
+				if (tracking->IsRigidBodyTracked(0))
+				{
+					printf("Gantry: Pos (%.3f, %.3f, %.3f) Orient (%.1f, %.1f, %.1f)\n",
+						gx, gy, gz, gantryBody.yaw, gantryBody.pitch, gantryBody.roll);
+					gantryEstimator->AddTracking(GrblClock(), gx, gz);
+				}
+				else {
+					cout << "Rigid Body Not Found!!" << endl;
+					tracking->Update();
+				}
 
-					if (TT_IsRigidBodyTracked(0))
-					{
-						printf("%s: Pos (%.3f, %.3f, %.3f) Orient (%.1f, %.1f, %.1f)\n",
-							TT_RigidBodyName(0), gx, gy, gz, gyaw, gpitch, groll);
-					}
-					else {
-						cout << "Rigid Body Not Found!!" << endl;
-						TT_Update();
-					}
+				if (gantryEstimator->Estimate(GrblClock(), &gantryPose)) {
+					printf("Estimate: Pos (%.4f, %.4f) +/- %.1f mm\n", gantryPose.x, gantryPose.z, 1000 * gantryPose.Sigma());
+				}
 
-					TT_Update();
+				tracking->Update();
 
-					secondsPassed = (clock() - startTime) / CLOCKS_PER_SEC;
-					if (secondsPassed > 100){
-						break;
-					}
+				secondsPassed = (clock() - startTime) / CLOCKS_PER_SEC;
+				if (secondsPassed > 100){
+					break;
 				}
-				//puts(prevData);
-				//cout << to_string(read_result);
-				//wait a bit
-				Sleep(1000);
 			}
 
 			//Sleep(80000);
+			Trace::End();
 
 			cout << "you have arrived. \n\n";
 
-			Sleep(1000);
-			TT_Update();
-			Sleep(1000);
-
-			for (int i = 0; i < 600; i++) {
-				TT_Update();
-			}
-
 #pragma endregion
 
 #pragma region "Fine position adjustment"
 
-			TT_RigidBodyEnabled(0);
-			Sleep(1000);
-			if (!TT_RigidBodyEnabled(0)) {
-				TT_SetRigidBodyEnabled(0, true);
-			}
+			session->SetRigidBodyEnabled(0, true);
 
-			TT_FlushCameraQueues();
+			tracking->FlushCameraQueues();
 
-			for (int i = 0; i < 600; i++) {
-				TT_Update();
+			cout << "Clear serial monitor" << endl;
+			writeResultclear = SendCommand(SP, GantryCommand::Clear());
+
+			//a calibrated first move normally lands within tolerance already
+			settler->Acquire(0, &settled);
+			float landed = hypot(settled.x - (pos[0] - 0.003f), settled.z - pos[1]);
+			logger->Value(LOG_DEBUG, "First move error mm ", 1000 * landed);
+			if (landed < GANTRY_ALIGN_TOLERANCE) {
+				cout << "On target, no fine adjustment needed" << endl;
+				gx = settled.x;
+				gz = settled.z;
 			}
+			else {
+				//closed loop onto the target, keeping the 3 mm X offset the second
+				//move to target used
+				cout << "move to target 2 \n" << endl;
+				if (!servo->Align(pos[0] - 0.003f, pos[1], &servoResult)) {
+					cout << "Gantry Not Found" << endl;
+					break;
+				}
+				gx = servoResult.x;
+				gz = servoResult.z;
+				logger->Value(LOG_DEBUG, "Alignment seconds ", servoResult.seconds, false);
+				logger->Value(LOG_DEBUG, " jogs ", servoResult.jogs, false);
+				logger->Value(LOG_DEBUG, " moves ", servoResult.moves, false);
+				logger->Value(LOG_DEBUG, " error mm ", 1000 * servoResult.error);
+			}
+			cout << to_string(t) << ",\t" << "Final Gantry Position" << ",\t" << gx << ",\t" << gz << '\n';
+			//cout << gx << ",\t" << gz << '\n';
+			//cout << theta << ",\t" << motor << '\n';
 
-			//fine adjustment position
-			TT_RigidBodyLocation(0, &gx, &gy, &gz, &gqx, &gqy, &gqz, &gqw, &gyaw, &gpitch, &groll);
-			cout << to_string(t) << ",\t" << "Updated Gantry Position" << ",\t" << gx << ",\t" << gz << '\n';
-
-			ax = gx;
-			az = gz;
+#pragma endregion
 
-			dx = pos[0] - ax;
-			dz = pos[1] - az;
+			cout << "Clear serial monitor" << endl;
+			writeResultclear = SendCommand(SP, GantryCommand::Clear());
 
-			int count = 0;
-			int endprogram = 0;
-			float prevgx;
 
-			while (abs(dx) > .1) {
-			
-				cout << "Failed to Update Gantry Position" << endl;
+#pragma region "Drop-off"
 
-				string outputDatafix = "";
-				outputDatafix.append("moveX");
-				outputDatafix.append("40");
-				outputDatafix.append(pcr, 0, 1);
-				writeResult = SP->WriteData((char*)outputDatafix.c_str(), outputDatafix.length());
+			//reorient gantry so that the snake runs straight
+			int servoangle = 120;
+			motor = int(1.35556*theta - 35);
+			float theta_servo = (motor + 35) / (1.35556);
+			logger->Value(LOG_TRIAL, "Initial Angle,\t\t", theta_servo);
 
 
-				//TT_Shutdown();
-				//Sleep(5000);
-				//TT_Initialize();
+			//servoangle = 102;
+			//servoangle = 115; // dont change!
+			//servoangle = 116; // dont change!
+			//servoangle = 126; // dont change!
+			//servoangle = 116; // dont change
+			//servoangle = 120;
 
-				//if (!TT_RigidBodyEnabled(0)) {
-					//TT_SetRigidBodyEnabled(0, true);
-				//}
+			//servoangle = 121;
+			//servoangle = 125;
 
-				TT_FlushCameraQueues();
+			//servoangle = 116;
+			//servoangle = 107;
 
-				for (int i = 0; i < 100; i++) {
-					TT_Update();
-					Sleep(10);
-				}
+			//servoangle = 118 + 14; //new servos- should be 132
+			//servoangle = 118 + 21;
+			//servoangle = 140;
 
-				//fine adjustment position
-				TT_RigidBodyLocation(0, &gx1, &gy1, &gz1, &gqx1, &gqy1, &gqz1, &gqw1, &g1yaw, &g1pitch, &g1roll);
-				cout << to_string(t) << ",\t" << "Updated Gantry Position (corrected)" << ",\t" << gx1 << ",\t" << gz1 << ",\t" << count <<'\n';
-			
-				ax = gx1;
-				az = gz1;
+			//the condition the scheduler puts next to where this trial left the snake
+			float endX, endZ;
+			calibration.ToMachine(pos[0], pos[1], &endX, &endZ);
+			scheduler->Observe(initialCondition.x, initialCondition.z, endX, endZ);
+			if (!scheduler->Next(endX, endZ, &initialCondition)) {
+				cout << "Every trial in the plan has been run" << endl;
+				journal->Finished();
+				break;
+			}
+			journal->Ended(trial, endX, endZ, initialCondition.index);
+			float Xic = -initialCondition.x;
+			float Zic = initialCondition.z;
+			logger->Value(LOG_DEBUG, "Initial condition ", initialCondition.index, false);
+			logger->Value(LOG_DEBUG, " carry mm ", hypot(initialCondition.x - endX, initialCondition.z - endZ));
+
+			logger->Text(LOG_TRIAL, to_string(Xic) + ",\t\t" + to_string(Zic));
+
+			//pick the snake up, carry it to the start of the next trial and leave;
+			//the snake re-homes and tracking re-arms while the gantry moves away
+			DropOff dropOff;
+			dropOff.SP = SP;
+			dropOff.magnets = magnetSensor;
+			dropOff.session = session;
+			dropOff.planner = planner;
+			dropOff.durations = durations;
+			dropOff.servoAngle = servoangle;
+			dropOff.homeSnake = snakeInitialPosition;
+			dropOff.locateStart = [&](float* machineX, float* machineZ) {
+				//the servo turn moves the gantry rigid body
+				settler->Acquire(0, &settled);
+				gx = settled.x;
+				gy = settled.y;
+				gz = settled.z;
+				cout << to_string(t) << ",\t" << "Updated Gantry Position" << ",\t" << gx << ",\t" << gz << '\n';
+
+				sx = 0;
+				sz = 0;
+
+				dx = sx - gx;
+				dz = sz - gz;
+
+				cout << "calculate start difference \n" << endl;
+				cout << "intial condition" << ",\t" << initialCondition.index << endl;
+				cout << to_string(t) << ",\t" << "Start difference" << ",\t" << dx << ",\t" << dz << '\n';
+
+				//back over the tracking origin, then the initial condition offset
+				//(machine mm, full box)
+				float originX, originZ;
+				calibration.ToMachine(dx, dz, &originX, &originZ);
+				*machineZ = originZ + Zic;
+				*machineX = originX - Xic;
+
+				cout << "Go to start \n" << endl;
+				return true;
+			};
+
+			ResetGraph reset;
+			AddDropOffStages(&reset, &dropOff);
+			bool dropped = reset.Run();
+			reset.Report(logger);
+			durations->Report(logger);
+			if (!dropped) {
+				cout << "Reset did not complete, stopping" << endl;
+				break;
+			}
+			journal->Placed(trial);
 
-				dx = pos[0] - ax;
-				dz = pos[1] - az;
+#pragma endregion
 
-				if (count == 0) {
-					prevgx = gx;
-				}
+#pragma region "Homing Gantry"
 
+			//waits until gantry is done moving
+			/*while (SP->IsConnected()) {
+				//char* prevData = (char*)incomingData;
+				//Check if data has been read or not
+				int read_result = SP->ReadData((char*)incomingData, MAX_DATA_LENGTH);
 
-				if (abs(ax - prevgx) < .01) {
-					cout << "Gantry Found!" << endl;
-					break;
-				}
+				//prints out data
+				if (read_result > 0) {
+					cout << to_string(read_result) << endl;
+					cout << incomingData << endl;
 
-				prevgx = ax;
-				count++;
 
-				if (count > 20) {
-					endprogram = 1;
-					break;
-				}
-
-			}
-
-
-
-			//cout << gx << ",\t" << gz << '\n';
-			//cout << theta << ",\t" << motor << '\n';
-
-			if (endprogram == 1) {
-				//fine adjustment position
-				TT_RigidBodyLocation(0, &gx2, &gy2, &gz2, &gqx2, &gqy2, &gqz2, &gqw2, &g2yaw, &g2pitch, &g2roll);
-				cout << to_string(t) << ",\t" << "Updated Gantry Position (Last Attempt)" << ",\t" << gx2 << ",\t" << gz2 << ",\t" << count << '\n';
-
-
-				ax = gx2;
-				az = gz2;
-
-				dx = pos[0] - ax;
-				dz = pos[1] - az;
-
-				if (abs(ax - prevgx) > .01) {
-					cout << "Gantry Not Found" << endl;
-					break;
-				}
-			}
-
-
-
-			cout << "calculate new difference \n" << endl;
-
-			cout << "Clear serial monitor" << endl;
-			string outputclear2 = "";
-			outputclear2.append(pcr, 0, 1);
-			writeResultclear = SP->WriteData((char*)outputclear2.c_str(), outputclear2.length());
-
-			//outputFile << to_string(t) << ",\t" << "New Difference" << ",\t" << dx << ",\t" << dz << '\n';
-			cout << to_string(t) << ",\t" << "New Difference" << ",\t" << dx << ",\t" << dz << '\n';
-
-			string outputData3 = "";
-			outputData3.append("moveZ");
-			outputData3.append(to_string(dz * 1000));
-			outputData3.append(",X-");
-			outputData3.append(to_string(dx * 1000 - 3));
-
-			cout << "move to target 2 \n" << endl;
-
-			outputData3.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputData3.c_str(), outputData3.length());
-
-			while (SP->IsConnected()) {
-				//char* prevData = (char*)incomingData;
-				//Check if data has been read or not
-				int read_result = SP->ReadData((char*)incomingWaitData, MAX_DATA_LENGTH);
-
-
-
-				//prints out data
-				if (read_result > 0) {
-					cout << to_string(read_result) << endl;
-					cout << incomingWaitData << endl;
-
-
-					string input(incomingData);
-					string last_input = input.substr(0, 11);
-					cout << last_input << endl;
-
-					if (last_input == "done moving") {
-						break;
-					}
-					string incomingData = "";
-					input = "";
-					last_input = "";
-
-					TT_RigidBodyLocation(0, &gx, &gy, &gz, &gqx, &gqy, &gqz, &gqw, &gyaw, &gpitch, &groll);
-
-					if (TT_IsRigidBodyTracked(0))
-					{
-						printf("%s: Pos (%.3f, %.3f, %.3f) Orient (%.1f, %.1f, %.1f)\n",
-							TT_RigidBodyName(0), gx, gy, gz, gyaw, gpitch, groll);
-					}
-					else {
-						cout << "Rigid Body Not Found!!" << endl;
-						TT_Update();
-					}
-
-					TT_Update();
-
-
-				}
-				//puts(prevData);
-				//cout << to_string(read_result);
-				//wait a bit
-				Sleep(1000);
-			}
-
-			//Sleep(10000);
-			//TT_Update();
-			//Sleep(10000);
-
-			for (int i = 0; i < 120; i++) {
-				TT_Update();
-			}
-
-			TT_RigidBodyLocation(0, &gx, &gy, &gz, &gqx, &gqy, &gqz, &gqw, &gyaw, &gpitch, &groll);
-			cout << to_string(t) << ",\t" << "Final Gantry Position" << ",\t" << gx << ",\t" << gz << '\n';
-			//cout << gx << ",\t" << gz << '\n';
-			//cout << theta << ",\t" << motor << '\n';
-
-#pragma endregion
-
-			cout << "Clear serial monitor" << endl;
-			string outputclear23 = "";
-			outputclear23.append(pcr, 0, 1);
-			writeResultclear = SP->WriteData((char*)outputclear23.c_str(), outputclear23.length());
-
-
-			//turn on magnets
-#pragma region "Turn on Magnets"
-
-			string outputData6 = "";
-			outputData6.append("mgon");
-			outputData6.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputData6.c_str(), outputData6.length());
-			cout << "Turn on Magnets" << endl;
-
-#pragma endregion
-
-			cout << "Clear serial monitor then lower gantry" << endl;
-			string outputclear24 = "";
-			outputclear24.append(pcr, 0, 1);
-			int writeResultclear2 = SP->WriteData((char*)outputclear24.c_str(), outputclear24.length());
-			cout << "Write Result Clear2: " << to_string(writeResultclear2) << endl;
-
-			Sleep(400);
-
-			//lower gantry
-#pragma region "Lower Gantry"
-			string outputData4 = "";
-			outputData4.append("yneg");
-			outputData4.append(pcr, 0, 1);
-			cout << "Lower gantry Command" << outputData4 << endl;
-			writeResult = SP->WriteData((char*)outputData4.c_str(), outputData4.length());
-			cout << "Lowering the Gantry" << endl;
-
-
-			Sleep(10000);
-#pragma endregion
-
-			cout << "Clear serial monitor then turn off frigelli" << endl;
-			string outputclear25 = "";
-			outputclear25.append(pcr, 0, 1);
-			int writeResultclear3 = SP->WriteData((char*)outputclear25.c_str(), outputclear25.length());
-			cout << "Write Result Clear3: " << to_string(writeResultclear3) << endl;
-
-			Sleep(400);
-
-			//turn off frigelli
-#pragma region "Turn off frigelli"
-			string outputData5 = "";
-			outputData5.append("ystp");
-			outputData5.append(pcr, 0, 1);
-			cout << "Turn off frigelli Command" << outputData5 << endl;
-			writeResult = SP->WriteData((char*)outputData5.c_str(), outputData4.length());
-#pragma endregion
-
-			int magcount = 0;
-			int scount = 0;
-			bool success = false;
-			bool magbreak = false;
-
-			// read serial monitor until it is clear
-			for (int i = 0; i < 10; i++) {
-				int read_result2 = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
-			}
-
-			/*while(1){
-			
-				float magthreshold = 1.6;
-
-				//request magnet A data
-				//int read_result = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
-				string outputDatamaga = "";
-				outputDatamaga.append("maga");
-				outputDatamaga.append(pcr, 0, 1);
-				writeResult = SP->WriteData((char*)outputDatamaga.c_str(), outputDatamaga.length());
-				Sleep(100);
-
-				//read magnet A data 
-				int read_result = SP->ReadData((char*)incomingMagDataA, MAX_DATA_LENGTH);
-				cout << "Read Result " << read_result << "	Magnet A Reading: " << incomingMagDataA << endl;
-
-				//string Mag1(incomingMagData);
-				//string Mag1Sub = Mag1.substr(0, 3);
-
-				float maga = atof(incomingMagDataA);
-				//cout << "Magnet A Reading: " << incomingMagData << endl;
-			
-				//request magnet B data
-				//int read_result = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
-				string outputDatamagb = "";
-				outputDatamagb.append("magb");
-				outputDatamagb.append(pcr, 0, 1);
-				writeResult = SP->WriteData((char*)outputDatamagb.c_str(), outputDatamagb.length());
-				Sleep(100);
-
-				//read magnet B data 
-				read_result = SP->ReadData((char*)incomingMagDataB, MAX_DATA_LENGTH);
-				cout << "Read Result: " << read_result << "	 Magnet B Reading: " << incomingMagDataB<< endl;
-				float magb = atof(incomingMagDataB);
-				
-				cout << endl;
-				cout << endl;
-
-				cout << "Magnet A = " << to_string(maga) << ",\t"<< to_string(magthreshold) << endl;
-				cout << "Magnet B = " << to_string(magb) << ",\t"<< to_string(magthreshold) << endl;
-
-				if ((magcount > 3) && (maga < magthreshold) && (magb < magthreshold)) {
-					cout << "Contact Detected" << endl;
-					success = true;
-				}
-				else{ 
-					cout << "No Contact Detected" << endl;
-					success = false;
-					scount = 0;
-				}
-
-				if  (success == true){
-					scount++;
-				}
-
-				if (scount > 0) {
-					cout << "Successfully made contact" << endl;
-					break;
-				}
-
-				magcount++;
-				cout << "Mag count: " << magcount << endl;
-
-
-				if (magcount > 8) {
-					magbreak = true;
-					break;
-				}
-			}*/
-
-			float OutputMagA;
-			float OutputMagB;
-			float magthreshold = 1.65;
-
-			for (int i = 0; i < 20; i++) {
-
-
-				//request magnet A data
-				//int read_result = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
-				string outputDatamaga = "";
-				outputDatamaga.append("maga");
-				outputDatamaga.append(pcr, 0, 1);
-				writeResult = SP->WriteData((char*)outputDatamaga.c_str(), outputDatamaga.length());
-				Sleep(100);
-
-				//read magnet A data 
-				int read_result = SP->ReadData((char*)incomingMagDataA, MAX_DATA_LENGTH);
-				//cout << "Read Result " << read_result << "	Magnet A Reading: " << incomingMagDataA << endl;
-
-				//string Mag1(incomingMagData);
-				//string Mag1Sub = Mag1.substr(0, 3);
-
-				float maga = atof(incomingMagDataA);
-				//cout << "Magnet A Reading: " << incomingMagData << endl;
-
-				if (i == 0) {
-					OutputMagA = maga;
-				}
-				if (i < 4) {
-					OutputMagA = OutputMagA += (maga - OutputMagA) * 0.25;
-				}
-				else {
-					if (abs(maga - OutputMagA) < .3) {
-						OutputMagA += (maga - OutputMagA) * 0.25;
-						//cout << "Update Magnet reading" << endl;
-					}//else it stays the same as before
-					else {
-						OutputMagA = OutputMagA;
-						//cout << "Keep Magnet reading the same" << endl;
-					}
-				}
-
-				//cout << "Magnet A = " << to_string(maga) << ",\t" << to_string(magthreshold) << endl;
-				//cout << "Mag   As = " << to_string(OutputMagA) << ",\t" << to_string(magthreshold) << endl;
-
-				//request magnet B data
-				//int read_result = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
-				string outputDatamagb = "";
-				outputDatamagb.append("magb");
-				outputDatamagb.append(pcr, 0, 1);
-				writeResult = SP->WriteData((char*)outputDatamagb.c_str(), outputDatamagb.length());
-				Sleep(100);
-
-				//read magnet B data 
-				read_result = SP->ReadData((char*)incomingMagDataB, MAX_DATA_LENGTH);
-				//cout << "Read Result: " << read_result << "	 Magnet B Reading: " << incomingMagDataB << endl;
-				float magb = atof(incomingMagDataB);
-
-				if (i == 0) {
-					OutputMagB = magb;
-				}
-				if (i < 4) {
-					OutputMagB = OutputMagB += (magb - OutputMagB) * 0.25;
-				}
-				else {
-					if (abs(magb - OutputMagB) < .3) {
-						OutputMagB += (magb - OutputMagB) * 0.25;
-						//cout << "Update Magnet reading" << endl;
-					}//else it stays the same as before
-					else {
-						OutputMagB = OutputMagB;
-						//cout << "Keep Magnet reading the same" << endl;
-					}
-				}
-
-				//cout << "Mag A" << ",\t" << "Mag As" << ",\t" << "MagB" << ",\t" << "MagBs" << ",\t" << "Magthershold" << endl;
-
-				//cout << "Magnet B = " << to_string(magb) << ",\t" << to_string(magthreshold) << endl;
-				cout << to_string(maga) << ",\t" << to_string(OutputMagA) << ",\t" << to_string(magb) << ",\t" << to_string(OutputMagB) << ",\t" << to_string(magthreshold) << endl;
-				//cout << "Mag   Bs = " << to_string(OutputMagB) << ",\t" << to_string(magthreshold) << endl;
-
-				Sleep(100);
-			}
-
-			if ((OutputMagA < magthreshold) && (OutputMagB < magthreshold)) {
-				cout << "Succesfully Made Contact, continuing" << endl;
-			}
-			else {
-				magbreak = true;
-				cout << "failed to make successful contact, trying again" << endl;
-			}
-			
-
-			//Second Attempt to lower frigelli
-			if (magbreak == true) {
-
-				cout << "Second attempt to lower the frigelli" << endl;
-
-				//lower frigelli
-
-				// clear serial monitor
-				cout << "Clear serial monitor" << endl;
-				string outputclear5 = "";
-				outputclear5.append(pcr, 0, 1);
-				writeResultclear = SP->WriteData((char*)outputclear5.c_str(), outputclear5.length());
-				cout << "Write Result Clear: " << to_string(writeResultclear) << endl;
-
-				cout << "Lowering the Frigelli" << endl;
-				string outputData95 = "";
-				outputData95.append("yneg");
-				outputData95.append(pcr, 0, 1);
-				writeResult = SP->WriteData((char*)outputData95.c_str(), outputData95.length());
-				cout << "Frigelli String" << ",\t" << outputData95 << ",\t" << "Frigelli Write Result" << to_string(writeResult) << endl;
-				Sleep(22000);
-				cout << "Waiting for snake to touch ground" << endl;
-
-
-				magcount = 0;
-				scount = 0;
-				success = false;
-				magbreak = false;
-
-				// read serial monitor until it is clear
-				for (int i = 0; i < 10; i++) {
-					int read_result2 = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
-				}
-
-				OutputMagA = 0;
-				OutputMagB = 0;
-				magthreshold = 1.65;
-
-				for (int i = 0; i < 20; i++) {
-
-
-					//request magnet A data
-					//int read_result = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
-					string outputDatamaga = "";
-					outputDatamaga.append("maga");
-					outputDatamaga.append(pcr, 0, 1);
-					writeResult = SP->WriteData((char*)outputDatamaga.c_str(), outputDatamaga.length());
-					Sleep(100);
-
-					//read magnet A data 
-					int read_result = SP->ReadData((char*)incomingMagDataA, MAX_DATA_LENGTH);
-					//cout << "Read Result " << read_result << "	Magnet A Reading: " << incomingMagDataA << endl;
-
-					//string Mag1(incomingMagData);
-					//string Mag1Sub = Mag1.substr(0, 3);
-
-					float maga = atof(incomingMagDataA);
-					//cout << "Magnet A Reading: " << incomingMagData << endl;
-
-					if (i == 0) {
-						OutputMagA = maga;
-					}
-					if (i < 4) {
-						OutputMagA = OutputMagA += (maga - OutputMagA) * 0.25;
-					}
-					else {
-						if (abs(maga - OutputMagA) < .3) {
-							OutputMagA += (maga - OutputMagA) * 0.25;
-							//cout << "Update Magnet reading" << endl;
-						}//else it stays the same as before
-						else {
-							OutputMagA = OutputMagA;
-							//cout << "Keep Magnet reading the same" << endl;
-						}
-					}
-
-					//cout << "Magnet A = " << to_string(maga) << ",\t" << to_string(magthreshold) << endl;
-					//cout << "Magnet A (smoothed) = " << to_string(OutputMagA) << ",\t" << to_string(magthreshold) << endl;
-
-					//request magnet B data
-					//int read_result = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
-					string outputDatamagb = "";
-					outputDatamagb.append("magb");
-					outputDatamagb.append(pcr, 0, 1);
-					writeResult = SP->WriteData((char*)outputDatamagb.c_str(), outputDatamagb.length());
-					Sleep(100);
-
-					//read magnet B data 
-					read_result = SP->ReadData((char*)incomingMagDataB, MAX_DATA_LENGTH);
-					//cout << "Read Result: " << read_result << "	 Magnet B Reading: " << incomingMagDataB << endl;
-					float magb = atof(incomingMagDataB);
-
-					if (i == 0) {
-						OutputMagB = magb;
-					}
-					if (i < 4) {
-						OutputMagB = OutputMagB += (magb - OutputMagB) * 0.25;
-					}
-					else {
-						if (abs(magb - OutputMagB) < .3) {
-							OutputMagB += (magb - OutputMagB) * 0.25;
-							//cout << "Update Magnet reading" << endl;
-						}//else it stays the same as before
-						else {
-							OutputMagB = OutputMagB;
-							//cout << "Keep Magnet reading the same" << endl;
-						}
-					}
-
-					//cout << "Magnet B = " << to_string(magb) << ",\t" << to_string(magthreshold) << endl;
-					//cout << "Magnet B (smoothed) = " << to_string(OutputMagB) << ",\t" << to_string(magthreshold) << endl;
-					//cout << "Mag A" << ",\t" << "Mag As" << ",\t" << "MagB" << ",\t" << "MagBs" << ",\t" << "Magthershold" << endl;
-					cout << to_string(maga) << ",\t" << to_string(OutputMagA) << ",\t" << to_string(magb) << ",\t" << to_string(OutputMagB) << ",\t" << to_string(magthreshold) << endl;
-
-					Sleep(100);
-				}
-
-				if ((OutputMagA < magthreshold) && (OutputMagB < magthreshold)){
-					cout << "Succesfully Made Contact, continuing" << endl;
-				}else{
-					break;
-				}
-
-
-
-				/*while (1) {
-
-					float magthreshold = 1.6;
-
-					//request magnet A data
-					//int read_result = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
-					string outputDatamaga = "";
-					outputDatamaga.append("maga");
-					outputDatamaga.append(pcr, 0, 1);
-					writeResult = SP->WriteData((char*)outputDatamaga.c_str(), outputDatamaga.length());
-					Sleep(100);
-
-					//read magnet A data 
-					int read_result = SP->ReadData((char*)incomingMagDataA, MAX_DATA_LENGTH);
-					cout << "Read Result " << read_result << "	Magnet A Reading: " << incomingMagDataA << endl;
-
-					//string Mag1(incomingMagData);
-					//string Mag1Sub = Mag1.substr(0, 3);
-
-					float maga = atof(incomingMagDataA);
-					//cout << "Magnet A Reading: " << incomingMagData << endl;
-
-					//request magnet B data
-					//int read_result = SP->ReadData((char*)incomingSnakeData, MAX_DATA_LENGTH);
-					string outputDatamagb = "";
-					outputDatamagb.append("magb");
-					outputDatamagb.append(pcr, 0, 1);
-					writeResult = SP->WriteData((char*)outputDatamagb.c_str(), outputDatamagb.length());
-					Sleep(100);
-
-					//read magnet B data 
-					read_result = SP->ReadData((char*)incomingMagDataB, MAX_DATA_LENGTH);
-					cout << "Read Result: " << read_result << "	 Magnet B Reading: " << incomingMagDataB << endl;
-					float magb = atof(incomingMagDataB);
-
-					cout << endl;
-					cout << endl;
-
-					cout << "Magnet A = " << to_string(maga) << ",\t" << to_string(magthreshold) << endl;
-					cout << "Magnet B = " << to_string(magb) << ",\t" << to_string(magthreshold) << endl;
-
-					if ((magcount > 3) && (maga < magthreshold) && (magb < magthreshold)) {
-						cout << "Contact Detected" << endl;
-						success = true;
-					}
-					else {
-						cout << "No Contact Detected" << endl;
-						success = false;
-						scount = 0;
-					}
-
-					if (success == true) {
-						scount++;
-					}
-
-					if (scount > 0) {
-						cout << "Successfully made contact" << endl;
-						break;
-					}
-
-					magcount++;
-					cout << "Mag count: " << magcount << endl;
-
-
-					if (magcount > 8) {
-						magbreak = true;
-						break;
-					}
-				}*/
-			}
-
-			//if (magbreak == true){
-				//break;
-			//}
-
-			// clear serial monitor
-			cout << "Clear serial monitor" << endl;
-			string outputclear21 = "";
-			outputclear21.append(pcr, 0, 1);
-			writeResultclear = SP->WriteData((char*)outputclear21.c_str(), outputclear21.length());
-			cout << "Write Result Clear: " << to_string(writeResultclear) << endl;
-
-			//raise gantry
-#pragma region "Raise Gantry"
-			string outputData7 = "";
-			outputData7.append("ypos");
-			outputData7.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputData7.c_str(), outputData7.length());
-			Sleep(13000);
-#pragma endregion
-
-			//go to start
-
-#pragma region "Go to Home position"
-
-			/*for (int i = 0; i < 600; i++) {
-				TT_Update();
-			}
-
-			// too computationally expensive to be in the loop
-			TT_RigidBodyLocation(4, &hx, &hy, &hz, &hqx, &hqy, &hqz, &hqw, &hyaw, &hpitch, &hroll);
-			//outputFile << to_string(t) << ",\t" << "start" << ",\t" << sx << ",\t" << sz << '\n';
-
-			Sleep(1000);
-			TT_Update();
-			Sleep(1000);
-
-
-			dx = hx - gx;
-			dz = hz - gz;
-
-			cout << "calculate home difference \n" << endl;
-
-			//outputFile << to_string(t) << ",\t" << "Home difference" << ",\t" << dx << ",\t" << dz << '\n';
-			cout << to_string(t) << ",\t" << "Home difference" << ",\t" << dx << ",\t" << dz << '\n';
-
-			string outputDataHome = "";
-			outputDataHome.append("moveZ");
-			outputDataHome.append(to_string(dz * 1000));
-			outputDataHome.append(",X");
-			outputDataHome.append(to_string(dx * 1000));
-
-			cout << "Go Home \n" << endl;
-
-			outputDataHome.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputDataHome.c_str(), outputDataHome.length());
-
-			//waits until gantry is done moving
-			while (SP->IsConnected()) {
-				//char* prevData = (char*)incomingData;
-				//Check if data has been read or not
-				int read_result = SP->ReadData((char*)incomingData, MAX_DATA_LENGTH);
-
-				//prints out data
-				if (read_result > 0) {
-					cout << to_string(read_result) << endl;
-					cout << incomingData << endl;
-
-
-					string input(incomingData);
-					string last_input = input.substr(0, 11);
-					cout << last_input << endl;
-
-					if (last_input == "done moving") {
-						break;
-					}
-					string incomingData = "";
-					input = "";
-					last_input = "";
-
-				}
-				//puts(prevData);
-				//cout << to_string(read_result);
-				//wait a bit
-				Sleep(1000);
-			}*/
-
-
-#pragma region "Go to Start position"
-
-			for (int i = 0; i < 600; i++) {
-				TT_Update();
-			}
-
-			//reorient gantry so that the snake runs straight
-			string outputServo2 = "";
-			outputServo2.append("rots");
-			int servoangle = 120;
-			motor = int(1.35556*theta - 35);
-			float theta_servo = (motor + 35) / (1.35556);
-			outputFile << "Initial Angle" << ",\t\t" << theta_servo << endl;
-
-
-			//outputServo2.append(to_string(102));
-			//outputServo2.append(to_string(115)); // dont change!
-			//outputServo2.append(to_string(116)); // dont change!
-			//outputServo2.append(to_string(126)); // dont change!
-			//outputServo2.append(to_string(116)); // dont change
-			//outputServo2.append(to_string(120));
-
-			//outputServo2.append(to_string(121));
-			//outputServo2.append(to_string(125));
-			outputServo2.append(to_string(servoangle));
-
-			//outputServo2.append(to_string(116));
-			//outputServo2.append(to_string(107));
-
-			//outputServo2.append(to_string(118+14)); //new servos- should be 132
-			//outputServo2.append(to_string(118 + 21));
-			//outputServo2.append(to_string(140));
-
-
-			outputServo2.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputServo2.c_str(), outputServo2.length());
-
-			// too computationally expensive to be in the loop
-			//TT_RigidBodyLocation(3, &sx, &sy, &sz, &sqx, &sqy, &sqz, &sqw, &syaw, &spitch, &sroll);
-			cout << "Home Position" << ",\t" << sx << ",\t" << sz << endl;
-			//outputFile << to_string(t) << ",\t" << "start" << ",\t" << sx << ",\t" << sz << '\n';
-
-			Sleep(1000);
-			TT_Update();
-			Sleep(1000);
-
-			TT_RigidBodyLocation(0, &gx, &gy, &gz, &gqx, &gqy, &gqz, &gqw, &gyaw, &gpitch, &groll);
-			cout << to_string(t) << ",\t" << "Updated Gantry Position" << ",\t" << gx << ",\t" << gz << '\n';
-
-			sx = 0;
-			sz = 0;
-
-			dx = sx - gx;
-			dz = sz - gz;
-
-			//int randx = rand() % 15;
-			//int randx = rand() % 29;
-			//int randz = rand() % 41;
-			//int randz = rand() % 41;
-
-			//int randz = -3; //-3 is back of box
-			int randz = 0;
-			int randx = 5; // 2 is center line- now 4?
-			
-			//int randx = 0;
-
-			//int randz = 21;
-			//int randx = 50;
-
-			//int randx = 13;
-
-			//int randz = 24;
-			//int randx = 19;
-
-			//int randx;
-			//if (trial < 100) {
-				//int randx = 28 + 30;
-			//}
-			//else{
-				//randx = -20;
-			//}
-
-			//int randz = 27; 
-			//int randx = 5;
-
-			//randx = 9;
-			//int randz = 20 + 5;
-
-			cout << "calculate start difference \n" << endl;
-			cout << "intial condition" << ",\t" << randx << ",\t" << randz << endl;
-
-			//outputFile << to_string(t) << ",\t" << "Home difference" << ",\t" << dx << ",\t" << dz << '\n';
-			cout << to_string(t) << ",\t" << "Start difference" << ",\t" << dx << ",\t" << dz << '\n';
-
-			string outputData11 = "";
-			outputData11.append("moveZ");
-
-			//modified to finish closed loop data
-			//outputData11.append(to_string(dz * 1000 - 370 + randz * 10 + 40));
-			outputData11.append(to_string(dz * 1000 - 370 + randz * 10 +trial * 20 + 40 - 675+10)); //use this one
-			//outputData11.append(to_string(dz * 1000 - 370 + randz * 10 + 40 - 675)); //use this one
-
-			//outputData11.append(to_string(dz * 1000 - 370 + randz*10 + trial*10));
-			//outputData11.append(to_string(dz * 1000 - 370 + 160 + randz * 10));
-			outputData11.append(",X");
-			outputData11.append(to_string(-1*(dx * 1000 - 140 + 60 + 120 + randx*10 + 10 - 30 - 170))); // use this one for full box
-			//outputData11.append(to_string(dx * 1000 - 140 + 60 + 220 + randx * 10));
-
-			float Zic = -370 + randz * 10 + trial * 20 + 40 - 675 + 10;
-			float Xic = -140 + 60 + 120 + randx * 10 + 10 - 30 - 170;
-
-			outputFile << to_string(Xic) << ",\t\t" << to_string(Zic) << endl;
-
-
-			cout << "Go to start \n" << endl;
-			cout << "Offset" << to_string(trial * 20) << '\n';
-
-			outputData11.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputData11.c_str(), outputData11.length());
-			cout << "Successful output String" << ",\t" << outputData11 << endl;
-			cout << "write result " << to_string(writeResult) << endl;
-
-			Sleep(1000);
-
-			cout << "Wait while moving home" << endl;
-			int read_result = SP->ReadData((char*)incomingData, MAX_DATA_LENGTH);
-			cout << "Serial monitor before moving home: "  << incomingData << endl;
-
-			string Wait = "wait";
-			writeResult = SP->WriteData((char*)Wait.c_str(), Wait.length());
-			cout << "Wait write result " << writeResult << endl;
-
-			Sleep(2000);
-
-			// clear serial monitor
-			cout << "Clear serial monitor" << endl;
-			string outputclear51 = "";
-			outputclear51.append(pcr, 0, 1);
-			writeResultclear = SP->WriteData((char*)outputclear51.c_str(), outputclear51.length());
-			cout << "Write Result Clear: " << to_string(writeResultclear) << endl;
-
-			//turn off frigelli
-#pragma region "Turn off Frigelli"
-			string outputData8 = "";
-			outputData8.append("ystp");
-			outputData8.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputData8.c_str(), outputData8.length());
-#pragma endregion
-
-
-			//waits until gantry is done moving
-			while (SP->IsConnected()) {
-				//char* prevData = (char*)incomingData;
-				//Check if data has been read or not
-				int read_result = SP->ReadData((char*)incomingData, MAX_DATA_LENGTH);
-
-				//prints out data
-				if (read_result > 0) {
-					cout << "Characters read " << to_string(read_result) << endl;
-					cout << incomingData << endl;
-
-
-					string input(incomingData);
-					string last_input = input.substr(0, 11);
-					cout << last_input << endl;
-
-					if (last_input == "done moving") {
-						break;
-					}
-					string incomingData = "";
-					input = "";
-					last_input = "";
-
-				}
-				//puts(prevData);
-				//cout << to_string(read_result);
-				//wait a bit
-				Sleep(1000);
-			}
-
-			/*Sleep(1000);
-			cout << "Inputing Offset value" << endl;
-
-
-			string outputData21 = "";
-			outputData21.append("moveZ");
-			outputData21.append(to_string(120 + i * 40));
-			outputData21.append(",X");
-			outputData21.append(to_string(0));
-
-			cout << "Go to start \n" << endl;
-			cout << "Offset" << to_string(i * 20) << '\n';
-
-			outputData21.append(pcr, 0, 1);
-			writeResult3 = SP->WriteData((char*)outputData21.c_str(), outputData21.length());
-			cout << "Problem output String" << ",\t" << outputData21 << endl;
-			cout << "write result " << to_string(writeResult3) << endl;*/
-
-
-
-			/*string outputDataadj = "";
-			outputDataadj.append("moveZ");
-			outputDataadj.append(to_string(120 + i * 40));
-			outputDataadj.append(",X");
-			outputDataadj.append(to_string(-80));
-
-			//cout << "Adjust by offset \n" << endl;
-			cout << "Offset" << to_string(i * 40) << '\n';
-
-			outputDataadj.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputDataadj.c_str(), outputDataadj.length());
-			cout << "Problem output string" << ",\t" << outputDataadj << endl;
-			cout <<	"write result "<< to_string(writeResult) << endl;*/
-
-			/*string outputDatanew = "";
-			outputDatanew.append("moveZ");
-			outputDatanew.append(to_string(120 + i*40));
-			outputDatanew.append(",X");
-			outputDatanew.append(to_string(0));
-
-			outputDatanew.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputDatanew.c_str(), outputDatanew.length());
-			cout << outputDatanew << ",\t" << writeResult << endl;
-
-			cout << "Wait while adjusting position" << endl;
-			int read_result2 = SP->ReadData((char*)incomingData, MAX_DATA_LENGTH);
-			cout << "Serial monitor before initial condition: " << incomingData << endl;*/
-
-			/*cout << "Wait while moving home" << endl;
-			int read_result3 = SP->ReadData((char*)incomingData, MAX_DATA_LENGTH);
-			cout << "Read Result" << ",\t" << to_string(read_result3) << endl;
-			cout << "Serial monitor before IC: " << ",\t" << incomingData << endl;
-
-			string Wait2 = "wait";
-			writeResult = SP->WriteData((char*)Wait2.c_str(), Wait2.length());
-			cout << "Wait write result " << writeResult << endl;
-
-			while (SP->IsConnected()) {
-				//char* prevData = (char*)incomingData;
-				//Check if data has been read or not
-				int read_result = SP->ReadData((char*)incomingData, MAX_DATA_LENGTH);
-				cout << "waiting read result " << read_result << endl;
-
-				//prints out data
-				if (read_result > 0) {
-					cout << "Characters Read " << to_string(read_result) << endl;
-					cout << incomingData << endl;
-
-
-					string input(incomingData);
-					string last_input = input.substr(0, 11);
-					cout << last_input << endl;
-
-					if (last_input == "done moving") {
-						break;
-					}
-					string incomingData = "";
-					input = "";
-					last_input = "";
-
-				}
-				//puts(prevData);
-				//cout << to_string(read_result);
-				//wait a bit
-				Sleep(1000);
-			}
-
-			//Sleep(60000);
-
-			Sleep(1000);*/
-
-#pragma endregion
-
-			//lower frigelli
-#pragma region "Lower Frigelli"
-			// clear serial monitor
-			cout << "Clear serial monitor" << endl;
-			string outputclear = "";
-			outputclear.append(pcr, 0, 1);
-			writeResultclear = SP->WriteData((char*)outputclear.c_str(), outputclear.length());
-			cout << "Write Result Clear: " << to_string(writeResultclear) << endl;
-
-			cout << "Lowering the Frigelli" << endl;
-			string outputData9 = "";
-			outputData9.append("yneg");
-			outputData9.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputData9.c_str(), outputData9.length());
-			cout << "Frigelli String" << ",\t" << outputData9 << ",\t" << "Frigelli Write Result" << to_string(writeResult) << endl;
-			Sleep(22000);
-			cout << "Waiting for snake to touch ground" << endl;
-#pragma endregion 
-
-			//turn off magnets
-#pragma region "Turn off magnets"
-			string outputData10 = "";
-			outputData10.append("mgof");
-			outputData10.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputData10.c_str(), outputData10.length());
-#pragma endregion
-
-			//raise gantry
-#pragma region "Raise Gantry"
-			string outputData12 = "";
-			outputData12.append("ypos");
-			outputData12.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputData12.c_str(), outputData12.length());
-
-			Sleep(3000);
-
-			string outputDataHome2 = "";
-			outputDataHome2.append("moveX");
-			outputDataHome2.append(to_string(900));
-
-			cout << "moving gantry away" << endl;
-
-			outputDataHome2.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputDataHome2.c_str(), outputDataHome2.length());
-
-
-			Sleep(6000);
-#pragma endregion
-
-
-			//turn off frigelli
-#pragma region "Turn of frigelli"
-			string outputData13 = "";
-			outputData13.append("ystp");
-			outputData13.append(pcr, 0, 1);
-			writeResult = SP->WriteData((char*)outputData13.c_str(), outputData13.length());
-
-			Sleep(18000);
-#pragma endregion
-
-#pragma region "Homing Gantry"
-
-			//waits until gantry is done moving
-			/*while (SP->IsConnected()) {
-				//char* prevData = (char*)incomingData;
-				//Check if data has been read or not
-				int read_result = SP->ReadData((char*)incomingData, MAX_DATA_LENGTH);
-
-				//prints out data
-				if (read_result > 0) {
-					cout << to_string(read_result) << endl;
-					cout << incomingData << endl;
-
-
-					string input(incomingData);
-					string last_input = input.substr(0, 11);
-					cout << last_input << endl;
+					string input(incomingData);
+					string last_input = input.substr(0, 11);
+					cout << last_input << endl;
 
 					if (last_input == "done moving") {
 						break;
@@ -2732,7 +2075,33 @@ int main()
 #pragma endregion
 	}
 
+	logger->CloseTrial();
+	logger->Stop();
+	if (!traceFilename.empty()) {
+		Trace::Export(traceFilename.c_str());
+		Trace::Stop();
+	}
+
 	delete[] pos;
+	delete settler;
+	delete journal;
+	delete scheduler;
+	delete durations;
+	delete planner;
+	delete servo;
+	delete gantryEstimator;
+	delete tracker;
+	delete cameraUpdate;
+	delete loopStats;
+	delete labeler;
+	delete snakeShape;
+	delete session;
+	delete tracking;
+	delete framePool;
+	delete magnetSensor;
+	delete grbl;
+	delete SP;
+	delete logger;
 
 	//Exit Program if serial communications are lost
 	cout << "COM Port disconnected. Press and key and enter to exit.";
@@ -2750,7 +2119,7 @@ void snakeInitialPosition() {
 
 	bool dxl_addparam_result_write = false;                // addParam result
 
-	double B0 = 0.4;
+	double B0 = gait.amplitude;
 	int N = 12;
 
 	int init_pos[12];
@@ -2793,7 +2162,7 @@ int snakeUpdatePosition(double t, int ContactCondition) {
 
 	bool dxl_addparam_result_write = false;                // addParam result
 
-	double offset = 0;
+	double offset = gait.offset;
 	//double offset = 0.2;
 
 	uint16_t dxl_present_position = 0;             // Present position
@@ -2801,7 +2170,7 @@ int snakeUpdatePosition(double t, int ContactCondition) {
 
 	uint8_t param_goal_position[2];
 
-	double B0 = 0.4;
+	double B0 = gait.amplitude;
 	int N = 12;
 
 	int init_pos[12];
@@ -2917,7 +2286,7 @@ int snakeAMM2(double t, float delA, float AMMStart) {
 
 	bool dxl_addparam_result_write = false;                // addParam result
 
-	double offset = 0;
+	double offset = gait.offset;
 	//double offset = -1.3;
 
 	uint16_t dxl_present_position = 0;             // Present position
@@ -2926,7 +2295,7 @@ int snakeAMM2(double t, float delA, float AMMStart) {
 	uint8_t param_goal_position[2];
 
 	//double delA = 0.1;
-	double B0 = 0.4;
+	double B0 = gait.amplitude;
 	int N = 12;
 
 	int init_pos[12];
@@ -3144,29 +2513,4 @@ int snakeAmplitudeModulation(double t, int ContactCondition) {
 
 	}
 }
-
-void CollectData(double t, ofstream outputFile)
-{
-	float* xPos;
-	float* yPos;
-	float* zPos;
-	int numMarkers;
-
-	numMarkers = TT_FrameMarkerCount();
-	xPos = new float[numMarkers];
-	yPos = new float[numMarkers];
-	zPos = new float[numMarkers];
-
-	//commenting out for IRIM video
-	for (int i = 0; i < numMarkers; i++) {
-		xPos[i] = TT_FrameMarkerX(i);
-		yPos[i] = TT_FrameMarkerY(i);
-		zPos[i] = TT_FrameMarkerZ(i);
-		outputFile << to_string(t) << ",\t\t" << to_string(i) << ",\t\t" << xPos[i] << ",\t\t" << yPos[i] << ",\t\t" << zPos[i] << endl;
-	}
-
-	delete[] xPos;
-	delete[] yPos;
-	delete[] zPos;
-}
 */
\ No newline at end of file
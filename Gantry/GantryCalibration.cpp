@@ -0,0 +1,215 @@
+/* ************************************************************
+GantryCalibration.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "GantryCalibration.h"
+#include "GantryCommand.h"
+
+using namespace std;
+
+#define CALIBRATION_MOVE_TIMEOUT        30000
+
+/*********************************************************************
+
+GantryCalibration
+
+*********************************************************************/
+
+GantryCalibration::GantryCalibration()
+	: rms(0), points(0)
+{
+	linear[0][0] = -0.001;
+	linear[0][1] = 0;
+	linear[1][0] = 0;
+	linear[1][1] = 0.001;
+	origin[0] = origin[1] = 0;
+}
+
+bool GantryCalibration::Fit(const vector<CalibrationPoint>& fit)
+{
+	int n = (int)fit.size();
+	if (n < 3) {
+		return false;
+	}
+
+	//centered, so each tracking axis is a 2x2 least squares problem
+	double mX = 0, mZ = 0, mx = 0, mz = 0;
+	for (int i = 0; i < n; i++) {
+		mX += fit[i].machineX;
+		mZ += fit[i].machineZ;
+		mx += fit[i].x;
+		mz += fit[i].z;
+	}
+	mX /= n;
+	mZ /= n;
+	mx /= n;
+	mz /= n;
+
+	double sXX = 0, sXZ = 0, sZZ = 0, sxX = 0, sxZ = 0, szX = 0, szZ = 0;
+	for (int i = 0; i < n; i++) {
+		double X = fit[i].machineX - mX, Z = fit[i].machineZ - mZ;
+		double x = fit[i].x - mx, z = fit[i].z - mz;
+		sXX += X * X;
+		sXZ += X * Z;
+		sZZ += Z * Z;
+		sxX += x * X;
+		sxZ += x * Z;
+		szX += z * X;
+		szZ += z * Z;
+	}
+
+	//points on one line leave one direction of the map unknown
+	double det = sXX * sZZ - sXZ * sXZ;
+	if (det <= 1e-6 * (sXX * sZZ)) {
+		return false;
+	}
+
+	linear[0][0] = (sxX * sZZ - sxZ * sXZ) / det;
+	linear[0][1] = (sxZ * sXX - sxX * sXZ) / det;
+	linear[1][0] = (szX * sZZ - szZ * sXZ) / det;
+	linear[1][1] = (szZ * sXX - szX * sXZ) / det;
+	origin[0] = mx - linear[0][0] * mX - linear[0][1] * mZ;
+	origin[1] = mz - linear[1][0] * mX - linear[1][1] * mZ;
+
+	double residual = 0;
+	for (int i = 0; i < n; i++) {
+		double ex = origin[0] + linear[0][0] * fit[i].machineX + linear[0][1] * fit[i].machineZ - fit[i].x;
+		double ez = origin[1] + linear[1][0] * fit[i].machineX + linear[1][1] * fit[i].machineZ - fit[i].z;
+		residual += ex * ex + ez * ez;
+	}
+	rms = sqrt(residual / n);
+	points = n;
+	return true;
+}
+
+void GantryCalibration::ToMachine(float dx, float dz, float* machineX, float* machineZ) const
+{
+	double det = linear[0][0] * linear[1][1] - linear[0][1] * linear[1][0];
+	*machineX = (float)((linear[1][1] * dx - linear[0][1] * dz) / det);
+	*machineZ = (float)((linear[0][0] * dz - linear[1][0] * dx) / det);
+}
+
+void GantryCalibration::ToTracking(float machineX, float machineZ, float* dx, float* dz) const
+{
+	*dx = (float)(linear[0][0] * machineX + linear[0][1] * machineZ);
+	*dz = (float)(linear[1][0] * machineX + linear[1][1] * machineZ);
+}
+
+bool GantryCalibration::Save(const char* path) const
+{
+	ofstream file(path);
+	if (!file) {
+		printf("Calibration: cannot write %s\n", path);
+		return false;
+	}
+	file.precision(12);
+	file << "# tracking (m) = linear * machine (mm) + origin\n";
+	file << "linear " << linear[0][0] << " " << linear[0][1] << " " << linear[1][0] << " " << linear[1][1] << "\n";
+	file << "origin " << origin[0] << " " << origin[1] << "\n";
+	file << "rms " << rms << "\n";
+	file << "points " << points << "\n";
+	return (bool)file;
+}
+
+bool GantryCalibration::Load(const char* path)
+{
+	ifstream file(path);
+	if (!file) {
+		return false;
+	}
+
+	GantryCalibration loaded;
+	bool haveLinear = false, haveOrigin = false;
+	string key;
+	while (file >> key) {
+		if (key[0] == '#') {
+			getline(file, key);
+		}
+		else if (key == "linear") {
+			haveLinear = (bool)(file >> loaded.linear[0][0] >> loaded.linear[0][1] >> loaded.linear[1][0] >> loaded.linear[1][1]);
+		}
+		else if (key == "origin") {
+			haveOrigin = (bool)(file >> loaded.origin[0] >> loaded.origin[1]);
+		}
+		else if (key == "rms") {
+			file >> loaded.rms;
+		}
+		else if (key == "points") {
+			file >> loaded.points;
+		}
+	}
+
+	double det = loaded.linear[0][0] * loaded.linear[1][1] - loaded.linear[0][1] * loaded.linear[1][0];
+	if (!haveLinear || !haveOrigin || (fabs(det) < 1e-12)) {
+		printf("Calibration: %s is not a calibration file\n", path);
+		return false;
+	}
+	*this = loaded;
+	return true;
+}
+
+/*********************************************************************
+
+Probing
+
+*********************************************************************/
+
+bool ProbeCalibration(SerialDemux* SP, PoseSettler* settler, GrblStatusPoller* grbl,
+	GantryCalibration* calibration, float span)
+{
+	//a star around the start, ending where it began
+	static const float pattern[][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 }, { 0, 0 } };
+	const int stops = sizeof(pattern) / sizeof(pattern[0]);
+
+	vector<CalibrationPoint> fit;
+	float machineX = 0, machineZ = 0;
+	string motionMessage;
+	RigidBodyPose pose;
+	GrblStatus status;
+
+	for (int i = 0; i < stops; i++) {
+		float moveX = span * pattern[i][0] - machineX;
+		float moveZ = span * pattern[i][1] - machineZ;
+		if ((moveX != 0) || (moveZ != 0)) {
+			SendCommand(SP, GantryCommand::MoveZX(moveZ, moveX));
+			SP->Flush(MESSAGE_MOTION);
+			SendCommand(SP, GantryCommand::Wait());
+			if (!SP->Wait(MESSAGE_MOTION, &motionMessage, CALIBRATION_MOVE_TIMEOUT)) {
+				printf("Calibration: gantry did not finish moving\n");
+				return false;
+			}
+			machineX += moveX;
+			machineZ += moveZ;
+		}
+
+		if (!settler->Acquire(0, &pose)) {
+			printf("Calibration: gantry rigid body not found\n");
+			return false;
+		}
+
+		CalibrationPoint point;
+		point.machineX = machineX;
+		point.machineZ = machineZ;
+		if ((grbl != NULL) && grbl->Latest(&status)) {
+			point.machineX = status.mpos[0];
+			point.machineZ = status.mpos[2];
+		}
+		point.x = pose.x;
+		point.z = pose.z;
+		fit.push_back(point);
+	}
+
+	if (!calibration->Fit(fit)) {
+		printf("Calibration: probe points do not span the floor\n");
+		return false;
+	}
+	printf("Calibration: %d points, residual %.2f mm\n", calibration->points, 1000 * calibration->rms);
+	return true;
+}
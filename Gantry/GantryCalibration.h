@@ -0,0 +1,64 @@
+/* ************************************************************
+GantryCalibration.h
+**************************************************************
+
+Map between OptiTrack coordinates on the floor (x, z in m) and gantry
+machine coordinates (X, Z in mm), so a move computed from tracked
+positions lands where it was meant to.
+
+The moves used to be MoveZX(dz * 1000, -dx * 1000): machine X exactly
+along -x, Z along +z, 1 mm per mm. Any rotation between the camera frame
+and the gantry rails, or a steps/mm that is slightly off, showed up as
+an error proportional to the distance travelled that the fine alignment
+then had to take out.
+
+The calibration is affine
+
+	(x, z) = linear * (X, Z) + origin
+
+fitted by least squares to rigid body 0 read at a few gantry positions.
+Both frames are planes on the same floor, so a homography would add
+nothing. ProbeCalibration drives the gantry through a small star around
+where it is and fits; the result is saved to a text file and loaded on
+later runs.
+*/
+
+#pragma once
+
+#include <vector>
+#include "GrblStatus.h"
+#include "PoseSettler.h"
+#include "SerialDemux.h"
+
+struct CalibrationPoint {
+	float machineX, machineZ;	// mm
+	float x, z;					// m, tracking
+};
+
+class GantryCalibration {
+public:
+	//Nominal: machine X along tracking -x, Z along +z, no scale error
+	GantryCalibration();
+
+	//Least squares over at least three points not on one line
+	bool Fit(const std::vector<CalibrationPoint>& points);
+
+	//Relative machine move (mm) that covers (dx, dz) m in the tracking frame
+	void ToMachine(float dx, float dz, float* machineX, float* machineZ) const;
+	//Tracking frame displacement (m) of a relative machine move
+	void ToTracking(float machineX, float machineZ, float* dx, float* dz) const;
+
+	bool Save(const char* path) const;
+	bool Load(const char* path);
+
+	double linear[2][2];	// m per machine mm
+	double origin[2];		// m, tracking position of machine zero
+	double rms;				// m, residual of the fit
+	int points;				// used in the fit, 0 for the nominal map
+};
+
+//Moves the gantry span mm along each axis and back around where it is,
+//reads rigid body 0 at every stop and fits calibration. Machine positions
+//come from GRBL when grbl is given, from the moves sent otherwise.
+bool ProbeCalibration(SerialDemux* SP, PoseSettler* settler, GrblStatusPoller* grbl,
+	GantryCalibration* calibration, float span);
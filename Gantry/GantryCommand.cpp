@@ -0,0 +1,190 @@
+/* ************************************************************
+GantryCommand.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <charconv>
+#include <cstdio>
+#include "GantryCommand.h"
+#include "Trace.h"
+
+using namespace std;
+
+void GantryCommand::Append(const char* text)
+{
+	while ((*text != '\0') && (length < GANTRY_COMMAND_LENGTH - 2)) {
+		buffer[length++] = *text++;
+	}
+	buffer[length] = '\0';
+}
+
+void GantryCommand::Append(float value)
+{
+	//shortest fixed notation that round trips, never an exponent
+	to_chars_result result = to_chars(buffer + length, buffer + GANTRY_COMMAND_LENGTH - 2, value, chars_format::fixed);
+	if (result.ec == errc()) {
+		length = (unsigned int)(result.ptr - buffer);
+	}
+	buffer[length] = '\0';
+}
+
+void GantryCommand::Append(int value)
+{
+	to_chars_result result = to_chars(buffer + length, buffer + GANTRY_COMMAND_LENGTH - 2, value);
+	if (result.ec == errc()) {
+		length = (unsigned int)(result.ptr - buffer);
+	}
+	buffer[length] = '\0';
+}
+
+void GantryCommand::End()
+{
+	buffer[length++] = '\r';
+	buffer[length] = '\0';
+}
+
+GantryCommand GantryCommand::MoveX(float x)
+{
+	GantryCommand command;
+	command.Append("moveX");
+	command.Append(x);
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::MoveZ(float z)
+{
+	GantryCommand command;
+	command.Append("moveZ");
+	command.Append(z);
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::MoveZX(float z, float x)
+{
+	GantryCommand command;
+	command.Append("moveZ");
+	command.Append(z);
+	command.Append(",X");
+	command.Append(x);
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::Jog(float z, float x, float feed)
+{
+	GantryCommand command;
+	command.Append("jogZ");
+	command.Append(z);
+	command.Append(",X");
+	command.Append(x);
+	command.Append(",F");
+	command.Append(feed);
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::JogCancel()
+{
+	GantryCommand command;
+	command.Append("jstp");
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::Rotate(int motor)
+{
+	GantryCommand command;
+	command.Append("rots");
+	command.Append(motor);
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::MagnetsOn()
+{
+	GantryCommand command;
+	command.Append("mgon");
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::MagnetsOff()
+{
+	GantryCommand command;
+	command.Append("mgof");
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::LowerY()
+{
+	GantryCommand command;
+	command.Append("yneg");
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::RaiseY()
+{
+	GantryCommand command;
+	command.Append("ypos");
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::StopY()
+{
+	GantryCommand command;
+	command.Append("ystp");
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::Stop()
+{
+	GantryCommand command;
+	command.Append("stop");
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::RequestContact()
+{
+	GantryCommand command;
+	command.Append("data");
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::Clear()
+{
+	GantryCommand command;
+	command.End();
+	return command;
+}
+
+GantryCommand GantryCommand::Wait()
+{
+	GantryCommand command;
+	command.Append("wait");
+	return command;
+}
+
+bool SendCommand(SerialLink* SP, const GantryCommand& command)
+{
+	Trace::Instant("command", command.Data());
+	bool writeResult = SP->WriteData(command.Data(), command.Length());
+	if (!writeResult) {
+		//print without the trailing carriage return
+		int n = (int)command.Length();
+		if ((n > 0) && (command.Data()[n - 1] == '\r')) {
+			n--;
+		}
+		fprintf(stderr, "Failed to write gantry command \"%.*s\"\n", n, command.Data());
+	}
+	return writeResult;
+}
@@ -0,0 +1,72 @@
+/* ************************************************************
+GantryCommand.h
+**************************************************************
+
+Commands understood by GantryControl.ino.
+
+Each command is formatted into a small fixed buffer inside the object
+(numbers with std::to_chars), so building and sending one never touches
+the heap. SendCommand is the single place where write results are
+checked.
+
+	moveX<x>			relative X move (mm)
+	moveZ<z>			relative Z move (mm)
+	moveZ<z>,X<x>		combined relative move (mm)
+	jogZ<z>,X<x>,F<f>	relative jog increment at feed f (mm/min); the
+						Arduino passes it to GRBL as $J=G91 Z<z> X<x> F<f>,
+						so increments queue up and run back to back
+	jstp				cancel jogging (GRBL real-time 0x85), stops at once
+	rots<motor>			end effector servo position
+	mgon / mgof			magnets on / off
+	yneg / ypos / ystp	lower / raise / stop the Firgelli
+	stop				end of run
+	data				request the contact state
+	wait				ask for "done moving" once the gantry is idle
+*/
+
+#pragma once
+
+#include "SerialLink.h"
+
+#define GANTRY_COMMAND_LENGTH           48
+
+class GantryCommand {
+public:
+
+	static GantryCommand MoveX(float x);
+	static GantryCommand MoveZ(float z);
+	static GantryCommand MoveZX(float z, float x);
+	static GantryCommand Jog(float z, float x, float feed);
+	static GantryCommand JogCancel();
+	static GantryCommand Rotate(int motor);
+	static GantryCommand MagnetsOn();
+	static GantryCommand MagnetsOff();
+	static GantryCommand LowerY();
+	static GantryCommand RaiseY();
+	static GantryCommand StopY();
+	static GantryCommand Stop();
+	static GantryCommand RequestContact();
+
+	//A lone carriage return, clears the Arduino's input line
+	static GantryCommand Clear();
+
+	//"wait" is sent without a carriage return
+	static GantryCommand Wait();
+
+	const char* Data() const { return buffer; }
+	unsigned int Length() const { return length; }
+
+private:
+	GantryCommand() : length(0) { buffer[0] = '\0'; }
+
+	void Append(const char* text);
+	void Append(float value);
+	void Append(int value);
+	void End();
+
+	char buffer[GANTRY_COMMAND_LENGTH];
+	unsigned int length;
+};
+
+//Writes the command, reports a failed write, returns the write result
+bool SendCommand(SerialLink* SP, const GantryCommand& command);
@@ -0,0 +1,268 @@
+/* ************************************************************
+GantryEstimator.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+#include "GantryEstimator.h"
+
+using namespace std;
+
+float GantryEstimate::Sigma() const
+{
+	float a = covariance[0][0], b = covariance[0][1], c = covariance[1][1];
+	float largest = (a + c) / 2 + sqrt((a - c) * (a - c) / 4 + b * b);
+	return sqrt(max(largest, 0.0f));
+}
+
+GantryEstimator::GantryEstimator()
+	: feedRate(GantrySettings().travelSpeed), trackingSigma(0.0005f), grblSigma(0.0002f), commandSigma(0.05f),
+	acceleration(0.01f), offsetDrift(0.0001f), gate(16)
+{
+	Reset();
+}
+
+void GantryEstimator::Reset()
+{
+	state.time = GrblClock();
+	for (int i = 0; i < GANTRY_STATES; i++) {
+		state.s[i] = 0;
+		for (int j = 0; j < GANTRY_STATES; j++) {
+			state.P[i][j] = 0;
+		}
+	}
+	//nothing known yet: positions anywhere within metres, slow drift
+	state.P[0][0] = state.P[1][1] = 100;
+	state.P[2][2] = state.P[3][3] = 0.01;
+	state.P[4][4] = state.P[5][5] = 100;
+
+	initialized = false;
+	moves.clear();
+	lastGrbl = -1;
+	accepted = 0;
+	rejected = 0;
+}
+
+//Share of a move done by time t
+static double progress(double start, double duration, double t)
+{
+	if (duration <= 0) {
+		return (t >= start) ? 1 : 0;
+	}
+	return min(max((t - start) / duration, 0.0), 1.0);
+}
+
+void GantryEstimator::Predict(State* predicted, double time) const
+{
+	double dt = time - predicted->time;
+	if (dt <= 0) {
+		return;
+	}
+	double* s = predicted->s;
+	double (*P)[GANTRY_STATES] = predicted->P;
+
+	//commanded motion is a known input; its timing is not, so a move adds
+	//variance in proportion to the distance covered, commandSigma of its
+	//length by the end
+	double ux = 0, uz = 0, commandVariance[2] = { 0, 0 };
+	for (size_t m = 0; m < moves.size(); m++) {
+		const Move& move = moves[m];
+		double done = progress(move.start, move.duration, time) - progress(move.start, move.duration, predicted->time);
+		ux += move.dx * done;
+		uz += move.dz * done;
+		commandVariance[0] += commandSigma * commandSigma * fabs(move.dx) * fabs(move.dx) * done;
+		commandVariance[1] += commandSigma * commandSigma * fabs(move.dz) * fabs(move.dz) * done;
+	}
+
+	s[0] += s[2] * dt + ux;
+	s[1] += s[3] * dt + uz;
+
+	//P = F P F' with F the constant velocity model on x, z
+	for (int axis = 0; axis < 2; axis++) {
+		int p = axis, v = axis + 2;
+		for (int j = 0; j < GANTRY_STATES; j++) {
+			P[p][j] += dt * P[v][j];
+		}
+		for (int i = 0; i < GANTRY_STATES; i++) {
+			P[i][p] += dt * P[i][v];
+		}
+	}
+
+	//Q
+	double q = acceleration * acceleration;
+	for (int axis = 0; axis < 2; axis++) {
+		int p = axis, v = axis + 2, o = axis + 4;
+		P[p][p] += q * dt * dt * dt / 3 + commandVariance[axis];
+		P[p][v] += q * dt * dt / 2;
+		P[v][p] += q * dt * dt / 2;
+		P[v][v] += q * dt;
+		P[o][o] += offsetDrift * offsetDrift * dt;
+	}
+
+	predicted->time = time;
+}
+
+void GantryEstimator::Advance(double time)
+{
+	if (time <= state.time) {
+		return;
+	}
+	Predict(&state, time);
+
+	size_t keep = 0;
+	for (size_t m = 0; m < moves.size(); m++) {
+		if (moves[m].start + moves[m].duration > time) {
+			moves[keep++] = moves[m];
+		}
+	}
+	moves.resize(keep);
+}
+
+bool GantryEstimator::Update(const double H[2][GANTRY_STATES], const double y[2], double variance, bool gated)
+{
+	double* s = state.s;
+	double (*P)[GANTRY_STATES] = state.P;
+
+	//innovation and its covariance S = H P H' + R
+	double r[2], PHt[GANTRY_STATES][2], S[2][2];
+	for (int a = 0; a < 2; a++) {
+		r[a] = y[a];
+		for (int j = 0; j < GANTRY_STATES; j++) {
+			r[a] -= H[a][j] * s[j];
+		}
+	}
+	for (int i = 0; i < GANTRY_STATES; i++) {
+		for (int a = 0; a < 2; a++) {
+			PHt[i][a] = 0;
+			for (int j = 0; j < GANTRY_STATES; j++) {
+				PHt[i][a] += P[i][j] * H[a][j];
+			}
+		}
+	}
+	for (int a = 0; a < 2; a++) {
+		for (int b = 0; b < 2; b++) {
+			S[a][b] = (a == b) ? variance : 0;
+			for (int i = 0; i < GANTRY_STATES; i++) {
+				S[a][b] += H[a][i] * PHt[i][b];
+			}
+		}
+	}
+	double det = S[0][0] * S[1][1] - S[0][1] * S[1][0];
+	if (det <= 0) {
+		return false;
+	}
+	double Si[2][2] = { { S[1][1] / det, -S[0][1] / det }, { -S[1][0] / det, S[0][0] / det } };
+
+	double distance = r[0] * (Si[0][0] * r[0] + Si[0][1] * r[1]) + r[1] * (Si[1][0] * r[0] + Si[1][1] * r[1]);
+	if (gated && initialized && (distance > gate)) {
+		rejected++;
+		return false;
+	}
+
+	//K = P H' S^-1, s += K r, P -= K H P
+	double K[GANTRY_STATES][2];
+	for (int i = 0; i < GANTRY_STATES; i++) {
+		for (int a = 0; a < 2; a++) {
+			K[i][a] = PHt[i][0] * Si[0][a] + PHt[i][1] * Si[1][a];
+		}
+		s[i] += K[i][0] * r[0] + K[i][1] * r[1];
+	}
+	for (int i = 0; i < GANTRY_STATES; i++) {
+		for (int j = 0; j < GANTRY_STATES; j++) {
+			P[i][j] -= K[i][0] * PHt[j][0] + K[i][1] * PHt[j][1];
+		}
+	}
+	for (int i = 0; i < GANTRY_STATES; i++) {
+		for (int j = 0; j < i; j++) {
+			double mean = (P[i][j] + P[j][i]) / 2;
+			P[i][j] = P[j][i] = mean;
+		}
+	}
+
+	initialized = true;
+	accepted++;
+	return true;
+}
+
+void GantryEstimator::AddTracking(double time, float x, float z, float sigma)
+{
+	static const double H[2][GANTRY_STATES] = { { 1, 0, 0, 0, 0, 0 }, { 0, 1, 0, 0, 0, 0 } };
+	Advance(time);
+	double y[2] = { x, z };
+	double s = (sigma > 0) ? sigma : trackingSigma;
+	Update(H, y, s * s, true);
+}
+
+void GantryEstimator::AddGrbl(const GrblStatus& status)
+{
+	static const double H[2][GANTRY_STATES] = { { 1, 0, 0, 0, -1, 0 }, { 0, 1, 0, 0, 0, -1 } };
+	if (status.time == lastGrbl) {
+		return;
+	}
+	lastGrbl = status.time;
+	Advance(status.time);
+	float x, z;
+	calibration.ToTracking(status.mpos[0], status.mpos[2], &x, &z);
+	double y[2] = { x, z };
+	Update(H, y, grblSigma * grblSigma, true);
+}
+
+void GantryEstimator::AddCommand(double time, float machineX, float machineZ, float feed)
+{
+	Advance(time);
+
+	//GRBL queues moves, so one sent during another starts when it ends
+	Move move;
+	move.start = time;
+	for (size_t m = 0; m < moves.size(); m++) {
+		move.start = max(move.start, moves[m].start + moves[m].duration);
+	}
+	move.duration = sqrt(machineX * machineX + machineZ * machineZ) / ((feed > 0) ? feed : feedRate);
+	calibration.ToTracking(machineX, machineZ, &move.dx, &move.dz);
+	moves.push_back(move);
+}
+
+void GantryEstimator::Pending(double time, float* dx, float* dz) const
+{
+	double px = 0, pz = 0;
+	for (size_t m = 0; m < moves.size(); m++) {
+		double left = 1 - progress(moves[m].start, moves[m].duration, time);
+		px += moves[m].dx * left;
+		pz += moves[m].dz * left;
+	}
+	*dx = (float)px;
+	*dz = (float)pz;
+}
+
+bool GantryEstimator::Estimate(double time, GantryEstimate* estimate) const
+{
+	if (!initialized) {
+		return false;
+	}
+
+	State predicted = state;
+	Predict(&predicted, time);
+
+	estimate->time = predicted.time;
+	estimate->x = (float)predicted.s[0];
+	estimate->z = (float)predicted.s[1];
+	double vx = predicted.s[2], vz = predicted.s[3];
+	for (size_t m = 0; m < moves.size(); m++) {
+		const Move& move = moves[m];
+		if ((predicted.time >= move.start) && (predicted.time < move.start + move.duration) && (move.duration > 0)) {
+			vx += move.dx / move.duration;
+			vz += move.dz / move.duration;
+		}
+	}
+	estimate->vx = (float)vx;
+	estimate->vz = (float)vz;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			estimate->covariance[i][j] = (float)predicted.P[i][j];
+		}
+	}
+	return true;
+}
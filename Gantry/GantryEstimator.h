@@ -0,0 +1,109 @@
+/* ************************************************************
+GantryEstimator.h
+**************************************************************
+
+Gantry position estimate that is good at any instant, instead of a
+single TT_RigidBodyLocation snapshot taken after a long sleep.
+
+A Kalman filter in the tracking frame (x and z on the floor, m) with the
+state
+
+	x, z		gantry head position
+	vx, vz		velocity not explained by the commanded moves
+	ox, oz		where machine zero is in the tracking frame
+
+fuses three sources:
+
+	AddTracking		rigid body 0 from OptiTrack: measures x, z
+	AddGrbl			a GRBL status report: measures x - ox, z - oz
+	AddCommand		a relative move sent to the gantry: moves x, z along a
+					straight line at feedRate, with some uncertainty on
+					where the move is at any moment
+
+so the estimate follows a commanded move as it happens, GRBL reports pin
+down the timing, and tracking samples pin down where the machine really
+is. Tracking samples too far from the prediction for the covariance
+(stale frames, a swapped rigid body) are rejected.
+
+Machine moves and positions map to the tracking frame through
+calibration, nominally machine X along -x and Z along +z; the machine
+offset state takes up where machine zero really is.
+
+Times are GrblClock() seconds. Samples are expected in time order; one
+older than the filter is applied as if it arrived now. Not thread safe:
+one thread feeds and reads it.
+*/
+
+#pragma once
+
+#include <vector>
+#include "ExperimentPlan.h"
+#include "GantryCalibration.h"
+#include "GrblStatus.h"
+
+#define GANTRY_STATES                   6
+
+struct GantryEstimate {
+	double time;
+	float x, z;				// m, tracking frame
+	float vx, vz;			// m/s, including commanded motion
+	float covariance[4][4];	// of x, z, vx, vz
+
+	//m, standard deviation of the position along its worse direction
+	float Sigma() const;
+};
+
+class GantryEstimator {
+public:
+	GantryEstimator();
+
+	void Reset();
+
+	void AddTracking(double time, float x, float z, float sigma = -1);
+	void AddGrbl(const GrblStatus& status);
+	//feed in mm/s, feedRate if not given
+	void AddCommand(double time, float machineX, float machineZ, float feed = -1);
+
+	//Estimate predicted forward to time, false before the first position sample
+	bool Estimate(double time, GantryEstimate* estimate) const;
+
+	//Commanded motion (m, tracking frame) not yet done at time
+	void Pending(double time, float* dx, float* dz) const;
+
+	//Samples used / rejected as outliers
+	int Accepted() const { return accepted; }
+	int Rejected() const { return rejected; }
+
+	GantryCalibration calibration;	// machine mm to tracking m
+	float feedRate;			// gantry travel speed, mm/s
+	float trackingSigma;	// m, tracking sample noise
+	float grblSigma;		// m, GRBL report noise (resolution and latency)
+	float commandSigma;		// fraction of a commanded move's progress that is uncertain
+	float acceleration;		// m/s^2, spectral density of unmodeled motion
+	float offsetDrift;		// m/sqrt(s), random walk of the machine offset
+	float gate;				// Mahalanobis distance squared above which a sample is rejected
+
+private:
+	struct Move {
+		double start;
+		double duration;
+		float dx, dz;		// tracking frame, m
+	};
+
+	struct State {
+		double time;
+		double s[GANTRY_STATES];
+		double P[GANTRY_STATES][GANTRY_STATES];
+	};
+
+	void Predict(State* state, double time) const;
+	bool Update(const double H[2][GANTRY_STATES], const double y[2], double variance, bool gated);
+	void Advance(double time);
+
+	State state;
+	bool initialized;
+	std::vector<Move> moves;
+	double lastGrbl;
+	int accepted;
+	int rejected;
+};
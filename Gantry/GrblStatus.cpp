@@ -0,0 +1,149 @@
+/* ************************************************************
+GrblStatus.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include "GrblStatus.h"
+#include "Trace.h"
+
+using namespace std;
+
+static const char* stateNames[] = { "Unknown", "Idle", "Run", "Hold", "Jog", "Alarm", "Door", "Check", "Home", "Sleep" };
+
+const char* GrblStateName(GrblState state)
+{
+	return stateNames[state];
+}
+
+double GrblClock()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool parseTriple(const char* p, float* v)
+{
+	for (int i = 0; i < 3; i++) {
+		char* end;
+		v[i] = strtof(p, &end);
+		if (end == p) {
+			return false;
+		}
+		p = (*end == ',') ? end + 1 : end;
+	}
+	return true;
+}
+
+bool ParseGrblStatus(const char* line, GrblStatus* status, float* wco)
+{
+	const char* p = strchr(line, '<');
+	if ((p == NULL) || (strchr(p, '>') == NULL)) {
+		return false;
+	}
+	p++;
+
+	status->state = GRBL_UNKNOWN;
+	for (int s = GRBL_IDLE; s <= GRBL_SLEEP; s++) {
+		size_t n = strlen(stateNames[s]);
+		if ((strncmp(p, stateNames[s], n) == 0) && ((p[n] == '|') || (p[n] == ':') || (p[n] == '>'))) {
+			status->state = (GrblState)s;
+			break;
+		}
+	}
+
+	bool hasMpos = false, hasWpos = false;
+	for (const char* field = strchr(p, '|'); field != NULL; field = strchr(field + 1, '|')) {
+		if (strncmp(field + 1, "MPos:", 5) == 0) {
+			hasMpos = parseTriple(field + 6, status->mpos);
+		}
+		else if (strncmp(field + 1, "WPos:", 5) == 0) {
+			hasWpos = parseTriple(field + 6, status->wpos);
+		}
+		else if (strncmp(field + 1, "WCO:", 4) == 0) {
+			parseTriple(field + 5, wco);
+		}
+	}
+	if (!hasMpos && !hasWpos) {
+		return false;
+	}
+
+	//WPos = MPos - WCO
+	for (int i = 0; i < 3; i++) {
+		if (hasMpos) {
+			status->wpos[i] = status->mpos[i] - wco[i];
+		}
+		else {
+			status->mpos[i] = status->wpos[i] + wco[i];
+		}
+	}
+	status->time = GrblClock();
+	return true;
+}
+
+/*********************************************************************
+
+GrblStatusPoller
+
+*********************************************************************/
+
+GrblStatusPoller::GrblStatusPoller(SerialDemux* SP, double rate)
+	: rate(rate), SP(SP), running(false), missed(0)
+{
+	wco[0] = wco[1] = wco[2] = 0;
+}
+
+GrblStatusPoller::~GrblStatusPoller()
+{
+	Stop();
+}
+
+void GrblStatusPoller::Start()
+{
+	if (!running) {
+		running = true;
+		poller = thread(&GrblStatusPoller::Poll, this);
+	}
+}
+
+void GrblStatusPoller::Stop()
+{
+	if (running) {
+		running = false;
+		poller.join();
+	}
+}
+
+bool GrblStatusPoller::IsIdle(double maxAge) const
+{
+	GrblStatus status;
+	return latest.Load(&status) && (status.state == GRBL_IDLE) && (GrblClock() - status.time < maxAge);
+}
+
+void GrblStatusPoller::Poll()
+{
+	string line;
+	GrblStatus status;
+	chrono::steady_clock::time_point next = chrono::steady_clock::now();
+	Trace::NameThread("grbl poller");
+
+	while (running && SP->IsConnected()) {
+		int period = (int)(1000 / rate);
+		next += chrono::milliseconds(period);
+
+		//'?' is a real-time command, no carriage return
+		SP->Flush(MESSAGE_STATUS);
+		SP->WriteData("?", 1);
+		if (SP->Wait(MESSAGE_STATUS, &line, period) && ParseGrblStatus(line.c_str(), &status, wco)) {
+			latest.Store(status);
+		}
+		else {
+			missed++;
+		}
+
+		this_thread::sleep_until(next);
+	}
+}
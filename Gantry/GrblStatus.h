@@ -0,0 +1,98 @@
+/* ************************************************************
+GrblStatus.h
+**************************************************************
+
+Gantry position feedback from GRBL status reports.
+
+GrblStatusPoller sends GRBL's real-time status request ('?') at a fixed
+rate on a background thread and parses the reply, e.g.
+
+	<Idle|MPos:12.000,0.000,-40.500|FS:0,0|WCO:0.000,0.000,0.000>
+
+The latest machine / work position and machine state are published
+through a LatestValue, so the control code can read them at any time
+without locking or touching the serial port.
+
+The poller shares the Arduino's port with every other command, so it
+depends on GantryControl.ino (not in this tree) doing the following:
+
+	- a '?' byte is passed straight to GRBL as it arrives, as GRBL treats
+	  real-time commands, and never added to the sketch's line buffer;
+	  otherwise it ends up prefixed onto the next data, moveZ or magnet
+	  command
+	- the <...> report GRBL answers with is relayed as one line, ending
+	  in a newline, so SerialDemux files it under MESSAGE_STATUS
+
+Until the sketch on the rig is known to do that, leave GRBL_STATUS_POLLING
+off in GantryApp.cpp; everything that reads the poller falls back to the
+moves sent and tracking when no report has arrived. With polling on, the
+app stops the poller for the snake run, so the contact loop has the port
+to itself.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include "LatestValue.h"
+#include "SerialDemux.h"
+
+enum GrblState {
+	GRBL_UNKNOWN,
+	GRBL_IDLE,
+	GRBL_RUN,
+	GRBL_HOLD,
+	GRBL_JOG,
+	GRBL_ALARM,
+	GRBL_DOOR,
+	GRBL_CHECK,
+	GRBL_HOME,
+	GRBL_SLEEP
+};
+
+struct GrblStatus {
+	GrblState state;
+	float mpos[3];		// machine position X, Y, Z (mm)
+	float wpos[3];		// work position X, Y, Z (mm)
+	double time;		// seconds (steady clock) when the report was received
+};
+
+//Parses one status report line, false if it is not one. GRBL sends either
+//MPos or WPos plus the work offset (WCO) every few reports, so wco carries
+//the last offset seen from one call to the next.
+bool ParseGrblStatus(const char* line, GrblStatus* status, float* wco);
+
+const char* GrblStateName(GrblState state);
+
+//Seconds on the clock used to stamp GrblStatus::time
+double GrblClock();
+
+class GrblStatusPoller {
+public:
+	GrblStatusPoller(SerialDemux* SP, double rate = 20);
+	~GrblStatusPoller();
+
+	void Start();
+	void Stop();
+
+	//Latest report, false if none has arrived yet
+	bool Latest(GrblStatus* status) const { return latest.Load(status); }
+
+	//True if the latest report is Idle and no older than maxAge seconds
+	bool IsIdle(double maxAge = 0.5) const;
+
+	//Requests that went unanswered
+	int Missed() const { return missed; }
+
+	double rate;		// status requests per second
+
+private:
+	void Poll();
+
+	SerialDemux* SP;
+	LatestValue<GrblStatus> latest;
+	std::atomic<bool> running;
+	std::atomic<int> missed;
+	float wco[3];
+	std::thread poller;
+};
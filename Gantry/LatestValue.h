@@ -0,0 +1,73 @@
+/* ************************************************************
+LatestValue.h
+**************************************************************
+
+Lock-free "latest value" slot for one writer thread and any number of
+readers (a sequence lock).
+
+The writer never waits. A reader copies the value and retries if the
+writer was part way through an update, so readers never see a torn
+value. T must be trivially copyable.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+template <typename T>
+class LatestValue {
+	static_assert(std::is_trivially_copyable<T>::value, "LatestValue needs a trivially copyable type");
+
+public:
+	LatestValue() : sequence(0) {
+		for (int i = 0; i < WORDS; i++) {
+			words[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	//Writer thread only
+	void Store(const T& value) {
+		uint32_t buffer[WORDS] = {};
+		memcpy(buffer, &value, sizeof(T));
+
+		uint32_t s = sequence.load(std::memory_order_relaxed);
+		sequence.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (int i = 0; i < WORDS; i++) {
+			words[i].store(buffer[i], std::memory_order_relaxed);
+		}
+		sequence.store(s + 2, std::memory_order_release);
+	}
+
+	//False until the first Store
+	bool Load(T* value) const {
+		uint32_t buffer[WORDS];
+		uint32_t before, after;
+		do {
+			before = sequence.load(std::memory_order_acquire);
+			for (int i = 0; i < WORDS; i++) {
+				buffer[i] = words[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = sequence.load(std::memory_order_relaxed);
+		} while ((before & 1) || (before != after));
+
+		if (before == 0) {
+			return false;
+		}
+		memcpy(value, buffer, sizeof(T));
+		return true;
+	}
+
+	//Number of values stored so far
+	uint32_t Count() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+	enum { WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t) };
+
+	std::atomic<uint32_t> sequence;
+	std::atomic<uint32_t> words[WORDS];
+};
@@ -0,0 +1,222 @@
+/* ************************************************************
+LoopStats.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "AsyncLog.h"
+#include "LoopStats.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+//Index of the highest set bit, v above 0
+static int highestBit(uint64_t v)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, v);
+	return (int)index;
+#else
+	return 63 - __builtin_clzll(v);
+#endif
+}
+
+/*********************************************************************
+
+LatencyHistogram
+
+*********************************************************************/
+
+LatencyHistogram::LatencyHistogram()
+{
+	Reset();
+}
+
+void LatencyHistogram::Reset()
+{
+	for (int i = 0; i < LATENCY_BUCKETS; i++) {
+		counts[i].store(0, memory_order_relaxed);
+	}
+	total.store(0, memory_order_relaxed);
+	sum.store(0, memory_order_relaxed);
+	max.store(0, memory_order_relaxed);
+}
+
+int LatencyHistogram::Bucket(int64_t ns)
+{
+	//exact below 16 ns, then 16 buckets per power of two
+	if (ns < LATENCY_SUB_BUCKETS) {
+		return (ns < 0) ? 0 : (int)ns;
+	}
+	int shift = highestBit((uint64_t)ns) - LATENCY_SUB_BITS;
+	int bucket = (shift + 1) * LATENCY_SUB_BUCKETS + (int)((ns >> shift) - LATENCY_SUB_BUCKETS);
+	return min(bucket, LATENCY_BUCKETS - 1);
+}
+
+int64_t LatencyHistogram::BucketTop(int bucket)
+{
+	if (bucket < LATENCY_SUB_BUCKETS) {
+		return bucket;
+	}
+	int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+	int64_t bottom = (int64_t)(bucket % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS) << shift;
+	return bottom + ((int64_t)1 << shift) - 1;
+}
+
+void LatencyHistogram::Record(int64_t ns)
+{
+	//one writer, so plain loads and stores; readers see every count whole
+	atomic<uint32_t>& count = counts[Bucket(ns)];
+	count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+	total.store(total.load(memory_order_relaxed) + 1, memory_order_relaxed);
+	sum.store(sum.load(memory_order_relaxed) + ns, memory_order_relaxed);
+	if (ns > max.load(memory_order_relaxed)) {
+		max.store(ns, memory_order_relaxed);
+	}
+}
+
+uint64_t LatencyHistogram::Count() const
+{
+	return total.load(memory_order_relaxed);
+}
+
+double LatencyHistogram::Mean() const
+{
+	uint64_t n = Count();
+	return (n > 0) ? (double)sum.load(memory_order_relaxed) / n : 0;
+}
+
+int64_t LatencyHistogram::Percentile(double p) const
+{
+	uint64_t n = Count();
+	if (n == 0) {
+		return 0;
+	}
+	uint64_t wanted = std::max((uint64_t)1, (uint64_t)ceil(p * n));
+	uint64_t seen = 0;
+	for (int i = 0; i < LATENCY_BUCKETS; i++) {
+		seen += counts[i].load(memory_order_relaxed);
+		if (seen >= wanted) {
+			return min(BucketTop(i), Max());
+		}
+	}
+	return Max();
+}
+
+string LatencyHistogram::Summary() const
+{
+	char text[128];
+	snprintf(text, sizeof(text), "n %llu p50 %.1f p90 %.1f p99 %.1f max %.1f", (unsigned long long)Count(),
+		Percentile(0.5) / 1000.0, Percentile(0.9) / 1000.0, Percentile(0.99) / 1000.0, Max() / 1000.0);
+	return text;
+}
+
+/*********************************************************************
+
+LoopStats
+
+*********************************************************************/
+
+LoopStats::LoopStats(double period)
+	: period(period), misses(0), skipped(0), inPass(false)
+{
+}
+
+LoopStats::~LoopStats()
+{
+	for (size_t i = 0; i < phases.size(); i++) {
+		delete phases[i];
+	}
+}
+
+int LoopStats::Phase(const char* name)
+{
+	NamedHistogram* phase = new NamedHistogram();
+	phase->name = name;
+	phases.push_back(phase);
+	pending.push_back(-1);
+	return (int)phases.size() - 1;
+}
+
+void LoopStats::Include(const char* name, const LatencyHistogram* histogram)
+{
+	included.push_back(make_pair(string(name), histogram));
+}
+
+void LoopStats::Begin()
+{
+	if (inPass) {
+		skipped++;
+	}
+	for (size_t i = 0; i < pending.size(); i++) {
+		pending[i] = -1;
+	}
+	passStart = Clock::now();
+	last = passStart;
+	inPass = true;
+}
+
+void LoopStats::Mark(int phase)
+{
+	Clock::time_point now = Clock::now();
+	pending[phase] = chrono::duration_cast<chrono::nanoseconds>(now - last).count();
+	last = now;
+}
+
+void LoopStats::End()
+{
+	if (!inPass) {
+		return;
+	}
+	int64_t ns = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - passStart).count();
+	pass.Record(ns);
+	if (ns > period * 1e9) {
+		misses++;
+	}
+	for (size_t i = 0; i < pending.size(); i++) {
+		if (pending[i] >= 0) {
+			phases[i]->times.Record(pending[i]);
+		}
+	}
+	inPass = false;
+}
+
+void LoopStats::Reset()
+{
+	for (size_t i = 0; i < phases.size(); i++) {
+		phases[i]->times.Reset();
+	}
+	pass.Reset();
+	misses = 0;
+	skipped = 0;
+	inPass = false;
+}
+
+void LoopStats::Summary(AsyncLog* logger) const
+{
+	logger->Value(LOG_TRIAL, "Loop Period ms,\t\t", 1000 * period);
+	logger->Value(LOG_TRIAL, "Loop Passes,\t\t", (double)Passes());
+	logger->Value(LOG_TRIAL, "Loop Deadline Misses,\t\t", (double)misses);
+	logger->Value(LOG_TRIAL, "Loop Skipped Passes,\t\t", (double)skipped);
+	logger->Text(LOG_TRIAL, "Loop pass us,\t\t" + pass.Summary());
+	for (size_t i = 0; i < phases.size(); i++) {
+		logger->Text(LOG_TRIAL, "Loop " + phases[i]->name + " us,\t\t" + phases[i]->times.Summary());
+	}
+	for (size_t i = 0; i < included.size(); i++) {
+		logger->Text(LOG_TRIAL, included[i].first + " us,\t\t" + included[i].second->Summary());
+	}
+
+	logger->Value(LOG_DEBUG, "Loop passes ", (double)Passes(), false);
+	logger->Value(LOG_DEBUG, " deadline misses ", (double)misses, false);
+	logger->Value(LOG_DEBUG, " skipped ", (double)skipped, false);
+	logger->Value(LOG_DEBUG, " p99 ms ", pass.Percentile(0.99) / 1e6, false);
+	logger->Value(LOG_DEBUG, " max ms ", pass.Max() / 1e6);
+}
@@ -0,0 +1,129 @@
+/* ************************************************************
+LoopStats.h
+**************************************************************
+
+Per-pass timing of the run's control loop, summarised into the trial
+log so a timing regression shows up in every dataset.
+
+The loop marks the end of each phase as it goes:
+
+	stats->Begin();                 top of the pass
+	...contact request...
+	stats->Mark(LOOP_CONTACT);      time since the last mark goes to the phase
+	...
+	stats->End();                   the pass stepped the gait
+
+Only passes that reach End are recorded: their length goes into the
+pass histogram, their phase times into the phase histograms, and they
+count as a deadline miss if they took longer than the period. A pass
+that gives up early (no new camera frame yet) is dropped at the next
+Begin and only counted as skipped. The gait moves a fixed phase step per
+pass, so a long pass slows the snake down as well as delaying the
+contact check.
+
+Times go into LatencyHistograms: HDR-style log-linear buckets, 16 per
+power of two, so a percentile is good to within 1/16 of its value from
+1 ns to over a minute in 2.6 KB. Each histogram has one thread writing
+it and any thread may read it, with no lock; a histogram can be written
+on one thread (e.g. the camera update on the tracking thread) and
+summarised on the control thread.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define LATENCY_SUB_BITS                4
+#define LATENCY_SUB_BUCKETS             (1 << LATENCY_SUB_BITS)
+#define LATENCY_OCTAVES                 40
+#define LATENCY_BUCKETS                 ((LATENCY_OCTAVES + 1) * LATENCY_SUB_BUCKETS)
+
+class AsyncLog;
+
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+
+	//One writer thread
+	void Record(int64_t ns);
+
+	//Only while nothing is recording
+	void Reset();
+
+	uint64_t Count() const;
+	//ns that fraction p of the samples were at or under, to within 1/16
+	int64_t Percentile(double p) const;
+	int64_t Max() const { return max.load(std::memory_order_relaxed); }
+	double Mean() const;
+
+	//"n 4521 p50 9102.3 p90 9650.1 p99 11810.0 max 15204.8" in us
+	std::string Summary() const;
+
+	static int Bucket(int64_t ns);
+	//Largest ns that falls in bucket
+	static int64_t BucketTop(int bucket);
+
+private:
+	std::atomic<uint32_t> counts[LATENCY_BUCKETS];
+	std::atomic<uint64_t> total;
+	std::atomic<int64_t> sum;
+	std::atomic<int64_t> max;
+};
+
+class LoopStats {
+public:
+	//period in s, the longest a pass should take
+	LoopStats(double period);
+	~LoopStats();
+
+	//Adds a phase before the run, returns its index
+	int Phase(const char* name);
+	//Adds a histogram kept elsewhere to the summary, e.g. one written on
+	//another thread
+	void Include(const char* name, const LatencyHistogram* histogram);
+
+	//Start of a pass, dropping the one before if it did not End
+	void Begin();
+	//End of phase, timed from the last Begin or Mark; kept until End
+	void Mark(int phase);
+	//End of a pass that stepped the gait, recording it and its phases
+	void End();
+
+	//Clears every histogram and count, before a run
+	void Reset();
+
+	uint64_t Passes() const { return pass.Count(); }
+	uint64_t Misses() const { return misses; }
+	uint64_t Skipped() const { return skipped; }
+	const LatencyHistogram& PassTimes() const { return pass; }
+	const LatencyHistogram& PhaseTimes(int phase) const { return phases[phase]->times; }
+
+	//Writes the period, passes, misses, skipped passes and a line per
+	//histogram to the trial log, and the totals to debugLog.txt
+	void Summary(AsyncLog* logger) const;
+
+	double period;			// s
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct NamedHistogram {
+		std::string name;
+		LatencyHistogram times;
+	};
+
+	std::vector<NamedHistogram*> phases;
+	std::vector<int64_t> pending;	// ns per phase this pass, -1 if not marked
+	std::vector<std::pair<std::string, const LatencyHistogram*> > included;
+	LatencyHistogram pass;
+	uint64_t misses;
+	uint64_t skipped;
+	Clock::time_point passStart;
+	Clock::time_point last;
+	bool inPass;
+};
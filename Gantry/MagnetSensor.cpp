@@ -0,0 +1,73 @@
+/* ************************************************************
+MagnetSensor.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "MagnetSensor.h"
+#include "Trace.h"
+
+using namespace std;
+
+MagnetSensor::MagnetSensor(SerialDemux* SP, float threshold)
+	: threshold(threshold), maxSamples(20), replyTimeout(50), settleTolerance(0.01f), SP(SP)
+{
+}
+
+bool MagnetSensor::Sample(float* values)
+{
+	char request[] = { 'm', 'a', 'g', 'a', '\r', 'm', 'a', 'g', 'b', '\r' };
+	string reply;
+
+	//a late reply from a previous exchange would shift A and B
+	SP->Flush(MESSAGE_MAGNET);
+	if (!SP->WriteData(request, sizeof(request))) {
+		return false;
+	}
+
+	//replies arrive in request order: A then B
+	for (int channel = 0; channel < 2; channel++) {
+		if (!SP->Wait(MESSAGE_MAGNET, &reply, replyTimeout)) {
+			return false;
+		}
+		values[channel] = strtof(reply.c_str(), NULL);
+	}
+	return true;
+}
+
+bool MagnetSensor::CheckContact(MagnetReading* reading)
+{
+	TraceScope scope("magnet check");
+	float values[2] = { 0, 0 };
+	int samples = 0;
+
+	filter.Reset();
+	while (samples < maxSamples) {
+		samples++;
+		if (!Sample(values)) {
+			cout << "Magnet read failed" << endl;
+			continue;
+		}
+		filter.Update(values);
+
+		cout << to_string(values[0]) << ",\t" << to_string(filter.Value(0)) << ",\t" << to_string(values[1]) << ",\t" << to_string(filter.Value(1)) << ",\t" << to_string(threshold) << endl;
+
+		if (filter.Settled(settleTolerance)) {
+			break;
+		}
+	}
+
+	reading->magA = values[0];
+	reading->magB = values[1];
+	reading->filteredA = filter.Value(0);
+	reading->filteredB = filter.Value(1);
+	reading->samples = samples;
+	reading->settled = filter.Settled(settleTolerance);
+	reading->contact = (filter.Count() > 0) && (reading->filteredA < threshold) && (reading->filteredB < threshold);
+
+	return reading->contact;
+}
@@ -0,0 +1,49 @@
+/* ************************************************************
+MagnetSensor.h
+**************************************************************
+
+Magnet contact check for the gantry end effector.
+
+Both magnet channels are requested in one serial exchange ("maga" and
+"magb" written back to back) and the two replies are taken from the
+demultiplexer's magnet mailbox as soon as they arrive. The
+readings are smoothed by a StreamFilter and contact is decided as soon
+as the filtered values settle, or after maxSamples exchanges at most.
+*/
+
+#pragma once
+
+#include "SerialDemux.h"
+#include "StreamFilter.h"
+
+struct MagnetReading {
+	float magA;			// last raw reading, channel A
+	float magB;			// last raw reading, channel B
+	float filteredA;
+	float filteredB;
+	int samples;		// number of exchanges used
+	bool settled;		// false if maxSamples was reached first
+	bool contact;
+};
+
+class MagnetSensor {
+public:
+
+	MagnetSensor(SerialDemux* SP, float threshold = 1.65f);
+
+	//Sample both channels until the filter settles, returns true on contact
+	bool CheckContact(MagnetReading* reading);
+
+	float threshold;
+	int maxSamples;			// upper bound on exchanges per check
+	int replyTimeout;		// ms to wait for each reply
+	float settleTolerance;	// allowed std deviation of the filtered value
+
+private:
+
+	//One exchange, fills values[0] (A) and values[1] (B)
+	bool Sample(float* values);
+
+	SerialDemux* SP;
+	StreamFilter<2> filter;
+};
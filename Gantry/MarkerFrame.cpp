@@ -0,0 +1,106 @@
+/* ************************************************************
+MarkerFrame.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <new>
+#include "GrblStatus.h"
+#include "MarkerFrame.h"
+
+using namespace std;
+
+/*********************************************************************
+
+MarkerFrame
+
+*********************************************************************/
+
+MarkerFrame::MarkerFrame()
+	: time(0), received(0), sequence(0), count(0), capacity(0), x(NULL), y(NULL), z(NULL), id(NULL), block(NULL)
+{
+}
+
+MarkerFrame::~MarkerFrame()
+{
+	if (block != NULL) {
+		::operator delete(block, align_val_t(MARKER_FRAME_ALIGN));
+	}
+}
+
+void MarkerFrame::Reserve(int markers)
+{
+	if (markers <= capacity) {
+		return;
+	}
+
+	//round each column up to whole cache lines
+	static_assert(sizeof(int) == sizeof(float), "MarkerFrame columns share one size");
+	int perLine = MARKER_FRAME_ALIGN / sizeof(float);
+	int column = (markers + perLine - 1) / perLine * perLine;
+
+	if (block != NULL) {
+		::operator delete(block, align_val_t(MARKER_FRAME_ALIGN));
+	}
+	block = ::operator new(4 * column * sizeof(float), align_val_t(MARKER_FRAME_ALIGN));
+	x = (float*)block;
+	y = x + column;
+	z = y + column;
+	id = (int*)(z + column);
+	capacity = column;
+	count = 0;
+}
+
+/*********************************************************************
+
+MarkerFramePool
+
+*********************************************************************/
+
+MarkerFramePool::MarkerFramePool(int frames, int markers)
+	: size(frames), frames(new MarkerFrame[frames]), inUse(new atomic<bool>[frames]), peak(0)
+{
+	for (int i = 0; i < size; i++) {
+		this->frames[i].Reserve(markers);
+		inUse[i] = false;
+	}
+}
+
+MarkerFrame* MarkerFramePool::Acquire()
+{
+	for (int i = 0; i < size; i++) {
+		bool expected = false;
+		if (!inUse[i].load(memory_order_relaxed) && inUse[i].compare_exchange_strong(expected, true, memory_order_acquire)) {
+			return &frames[i];
+		}
+	}
+	return NULL;
+}
+
+void MarkerFramePool::Release(MarkerFrame* frame)
+{
+	inUse[frame - frames.get()].store(false, memory_order_release);
+}
+
+void MarkerFramePool::NotePeak(int markers)
+{
+	int current = peak.load(memory_order_relaxed);
+	while ((markers > current) && !peak.compare_exchange_weak(current, markers)) {
+	}
+}
+
+void FillMarkerFrame(TrackingBackend* backend, MarkerFramePool* pool, MarkerFrame* frame)
+{
+	int numMarkers = backend->FrameMarkerCount();
+	pool->NotePeak(numMarkers);
+	frame->Reserve(numMarkers);
+
+	frame->time = backend->FrameTimeStamp();
+	frame->received = GrblClock();
+	frame->count = numMarkers;
+	backend->FrameMarkers(frame->x, frame->y, frame->z, numMarkers);
+	for (int i = 0; i < numMarkers; i++) {
+		frame->id[i] = i;
+	}
+}
@@ -0,0 +1,71 @@
+/* ************************************************************
+MarkerFrame.h
+**************************************************************
+
+Marker positions for one OptiTrack frame, stored as structure of arrays
+(x[], y[], z[], id[]) in cache-line aligned buffers. id[] holds the
+marker's persistent ID once MarkerTracker has labeled the frame, and the
+marker's index in the frame until then.
+
+Frames come from a MarkerFramePool that is allocated once. A frame only
+grows when a camera frame has more markers than it has ever held, so
+after the first few frames the control loop never allocates. Acquire and
+Release are lock-free, so one thread can fill frames while another
+hands them back.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include "TrackingBackend.h"
+
+#define MARKER_FRAME_ALIGN              64
+
+struct MarkerFrame {
+	MarkerFrame();
+	~MarkerFrame();
+
+	//Makes room for at least markers entries, keeps nothing
+	void Reserve(int markers);
+
+	double time;		// camera time stamp (TT_FrameTimeStamp)
+	double received;	// GrblClock() when the frame was copied
+	unsigned sequence;	// frames produced before this one
+	int count;			// markers in this frame
+	int capacity;
+	float* x;
+	float* y;
+	float* z;
+	int* id;
+
+private:
+	MarkerFrame(const MarkerFrame&);
+	MarkerFrame& operator=(const MarkerFrame&);
+
+	void* block;
+};
+
+class MarkerFramePool {
+public:
+	MarkerFramePool(int frames, int markers);
+
+	//NULL if every frame is in use
+	MarkerFrame* Acquire();
+	void Release(MarkerFrame* frame);
+
+	//Most markers seen in a single frame
+	int PeakMarkers() const { return peak; }
+	void NotePeak(int markers);
+
+	int Size() const { return size; }
+
+private:
+	int size;
+	std::unique_ptr<MarkerFrame[]> frames;
+	std::unique_ptr<std::atomic<bool>[]> inUse;
+	std::atomic<int> peak;
+};
+
+//Copies the backend's current frame (after Update) into frame
+void FillMarkerFrame(TrackingBackend* backend, MarkerFramePool* pool, MarkerFrame* frame);
@@ -0,0 +1,304 @@
+/* ************************************************************
+MarkerTracker.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+#include "MarkerTracker.h"
+
+using namespace std;
+
+#define MARKER_TRACKER_NO_EDGE          1e9
+
+MarkerTracker::MarkerTracker()
+	: gate(0.02f), maxMissed(24), nextId(0), greedy(0), prev_t(-1), frame(NULL)
+{
+}
+
+void MarkerTracker::Reset()
+{
+	tracks.clear();
+	nextId = 0;
+	greedy = 0;
+	prev_t = -1;
+}
+
+int64_t MarkerTracker::Cell(float x, float y, float z) const
+{
+	int64_t ix = (int64_t)floor(x / gate) & 0x1FFFFF;
+	int64_t iy = (int64_t)floor(y / gate) & 0x1FFFFF;
+	int64_t iz = (int64_t)floor(z / gate) & 0x1FFFFF;
+	return (ix << 42) | (iy << 21) | iz;
+}
+
+int MarkerTracker::Find(int node)
+{
+	while (parent[node] != node) {
+		parent[node] = parent[parent[node]];
+		node = parent[node];
+	}
+	return node;
+}
+
+void MarkerTracker::Label(MarkerFrame* labeled)
+{
+	frame = labeled;
+	int numTracks = (int)tracks.size();
+	int numDetections = frame->count;
+	double t = frame->time;
+	float gate2 = gate * gate;
+
+	for (int k = 0; k < numTracks; k++) {
+		Track& track = tracks[k];
+		float dt = (float)(t - track.time);
+		track.px = track.x + track.vx * dt;
+		track.py = track.y + track.vy * dt;
+		track.pz = track.z + track.vz * dt;
+	}
+
+	//detections sorted by grid cell
+	cells.resize(numDetections);
+	for (int j = 0; j < numDetections; j++) {
+		cells[j] = make_pair(Cell(frame->x[j], frame->y[j], frame->z[j]), j);
+	}
+	sort(cells.begin(), cells.end());
+
+	//candidate pairs within the gate, grouped by track
+	edges.clear();
+	for (int k = 0; k < numTracks; k++) {
+		const Track& track = tracks[k];
+		float cx = floor(track.px / gate), cy = floor(track.py / gate), cz = floor(track.pz / gate);
+		for (int dx = -1; dx <= 1; dx++) {
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dz = -1; dz <= 1; dz++) {
+					int64_t key = Cell((cx + dx + 0.5f) * gate, (cy + dy + 0.5f) * gate, (cz + dz + 0.5f) * gate);
+					vector<pair<int64_t, int> >::iterator it = lower_bound(cells.begin(), cells.end(), make_pair(key, -1));
+					for (; (it != cells.end()) && (it->first == key); ++it) {
+						int j = it->second;
+						float ex = frame->x[j] - track.px;
+						float ey = frame->y[j] - track.py;
+						float ez = frame->z[j] - track.pz;
+						float d2 = ex * ex + ey * ey + ez * ez;
+						if (d2 < gate2) {
+							Edge edge = { k, j, d2 };
+							edges.push_back(edge);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//connected components: tracks are nodes 0..numTracks-1, detections follow
+	parent.resize(numTracks + numDetections);
+	for (int i = 0; i < numTracks + numDetections; i++) {
+		parent[i] = i;
+	}
+	for (size_t e = 0; e < edges.size(); e++) {
+		int a = Find(edges[e].track);
+		int b = Find(numTracks + edges[e].detection);
+		if (a != b) {
+			parent[a] = b;
+		}
+	}
+
+	//group the nodes that have edges by the root of their component;
+	//nodes without edges are their own root and get no component
+	trackMatch.assign(numTracks, -1);
+	detectionMatch.assign(numDetections, -1);
+	componentOf.assign(numTracks + numDetections, -1);
+	int components = 0;
+	for (size_t e = 0; e < edges.size(); e++) {
+		int root = Find(edges[e].track);
+		if (componentOf[root] == -1) {
+			componentOf[root] = components++;
+			if ((size_t)components > componentTracks.size()) {
+				componentTracks.resize(components);
+				componentDetections.resize(components);
+			}
+			componentTracks[components - 1].clear();
+			componentDetections[components - 1].clear();
+		}
+	}
+	edgeStart.assign(numTracks + 1, 0);
+	for (size_t e = 0; e < edges.size(); e++) {
+		edgeStart[edges[e].track + 1]++;
+	}
+	for (int k = 0; k < numTracks; k++) {
+		edgeStart[k + 1] += edgeStart[k];
+		int c = componentOf[Find(k)];
+		if (c != -1) {
+			componentTracks[c].push_back(k);
+		}
+	}
+	localDetection.resize(numDetections);
+	for (int j = 0; j < numDetections; j++) {
+		int c = componentOf[Find(numTracks + j)];
+		if (c != -1) {
+			localDetection[j] = (int)componentDetections[c].size();
+			componentDetections[c].push_back(j);
+		}
+	}
+
+	for (int c = 0; c < components; c++) {
+		const vector<int>& ct = componentTracks[c];
+		const vector<int>& cd = componentDetections[c];
+		if ((ct.size() == 1) && (cd.size() == 1)) {
+			trackMatch[ct[0]] = cd[0];
+			detectionMatch[cd[0]] = ct[0];
+		}
+		else if ((int)(ct.size() + cd.size()) <= MARKER_TRACKER_MAX_COMPONENT) {
+			Solve(ct, cd);
+		}
+		else {
+			Greedy(ct, cd);
+			greedy++;
+		}
+	}
+
+	//update matched tracks, coast the rest
+	for (int k = 0; k < numTracks; k++) {
+		Track& track = tracks[k];
+		int j = trackMatch[k];
+		if (j < 0) {
+			track.missed++;
+			continue;
+		}
+		float dt = (float)(t - track.time);
+		float nx = frame->x[j], ny = frame->y[j], nz = frame->z[j];
+		if (dt > 0) {
+			float blend = (track.hits == 1) ? 1.0f : 0.5f;
+			track.vx += ((nx - track.x) / dt - track.vx) * blend;
+			track.vy += ((ny - track.y) / dt - track.vy) * blend;
+			track.vz += ((nz - track.z) / dt - track.vz) * blend;
+		}
+		track.x = nx;
+		track.y = ny;
+		track.z = nz;
+		track.time = t;
+		track.missed = 0;
+		track.hits++;
+		frame->id[j] = track.id;
+	}
+
+	//new markers
+	for (int j = 0; j < numDetections; j++) {
+		if (detectionMatch[j] >= 0) {
+			continue;
+		}
+		Track track = { nextId++, frame->x[j], frame->y[j], frame->z[j], 0, 0, 0, frame->x[j], frame->y[j], frame->z[j], t, 0, 1 };
+		tracks.push_back(track);
+		frame->id[j] = track.id;
+	}
+
+	//tracks lost for too long
+	int keep = 0;
+	for (size_t k = 0; k < tracks.size(); k++) {
+		if (tracks[k].missed <= maxMissed) {
+			tracks[keep++] = tracks[k];
+		}
+	}
+	tracks.resize(keep);
+
+	prev_t = t;
+	frame = NULL;
+}
+
+void MarkerTracker::Solve(const vector<int>& ct, const vector<int>& cd)
+{
+	//rows: tracks then "detection unmatched", columns: detections then "track unmatched"
+	int R = (int)ct.size();
+	int C = (int)cd.size();
+	int N = R + C;
+	double leave = gate * gate;
+
+	cost.assign((N + 1) * (N + 1), MARKER_TRACKER_NO_EDGE);
+	for (int r = 0; r < R; r++) {
+		cost[(r + 1) * (N + 1) + (C + r + 1)] = leave;
+	}
+	for (int c = 0; c < C; c++) {
+		cost[(R + c + 1) * (N + 1) + (c + 1)] = leave;
+		for (int r = 0; r < R; r++) {
+			cost[(R + c + 1) * (N + 1) + (C + r + 1)] = 0;
+		}
+	}
+	for (int r = 0; r < R; r++) {
+		for (int e = edgeStart[ct[r]]; e < edgeStart[ct[r] + 1]; e++) {
+			int c = localDetection[edges[e].detection];
+			cost[(r + 1) * (N + 1) + (c + 1)] = edges[e].cost;
+		}
+	}
+
+	//Hungarian algorithm (shortest augmenting paths with potentials), 1-indexed
+	u.assign(N + 1, 0);
+	v.assign(N + 1, 0);
+	p.assign(N + 1, 0);
+	way.assign(N + 1, 0);
+	for (int i = 1; i <= N; i++) {
+		p[0] = i;
+		int j0 = 0;
+		minv.assign(N + 1, INFINITY);
+		used.assign(N + 1, 0);
+		do {
+			used[j0] = 1;
+			int i0 = p[j0], j1 = 0;
+			double delta = INFINITY;
+			for (int j = 1; j <= N; j++) {
+				if (!used[j]) {
+					double cur = cost[i0 * (N + 1) + j] - u[i0] - v[j];
+					if (cur < minv[j]) {
+						minv[j] = cur;
+						way[j] = j0;
+					}
+					if (minv[j] < delta) {
+						delta = minv[j];
+						j1 = j;
+					}
+				}
+			}
+			for (int j = 0; j <= N; j++) {
+				if (used[j]) {
+					u[p[j]] += delta;
+					v[j] -= delta;
+				}
+				else {
+					minv[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (p[j0] != 0);
+		do {
+			int j1 = way[j0];
+			p[j0] = p[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
+
+	for (int c = 1; c <= C; c++) {
+		int r = p[c];
+		if ((r >= 1) && (r <= R) && (cost[r * (N + 1) + c] < MARKER_TRACKER_NO_EDGE)) {
+			trackMatch[ct[r - 1]] = cd[c - 1];
+			detectionMatch[cd[c - 1]] = ct[r - 1];
+		}
+	}
+}
+
+void MarkerTracker::Greedy(const vector<int>& ct, const vector<int>& cd)
+{
+	//closest pairs first
+	(void)cd;
+	vector<Edge> component;
+	for (size_t r = 0; r < ct.size(); r++) {
+		component.insert(component.end(), edges.begin() + edgeStart[ct[r]], edges.begin() + edgeStart[ct[r] + 1]);
+	}
+	sort(component.begin(), component.end(), [](const Edge& a, const Edge& b) { return a.cost < b.cost; });
+	for (size_t e = 0; e < component.size(); e++) {
+		if ((trackMatch[component[e].track] < 0) && (detectionMatch[component[e].detection] < 0)) {
+			trackMatch[component[e].track] = component[e].detection;
+			detectionMatch[component[e].detection] = component[e].track;
+		}
+	}
+}
@@ -0,0 +1,95 @@
+/* ************************************************************
+MarkerTracker.h
+**************************************************************
+
+Online marker labeling: gives each snake marker an ID that stays the
+same from frame to frame, so the trial log no longer needs the marker
+correspondence solved offline.
+
+Every track keeps its last position and velocity. For each frame:
+
+1.	Tracks are predicted forward to the frame time (constant velocity).
+2.	Detections are bucketed into a grid with cells one gate wide, so each
+	track only looks at the 27 cells around its prediction. Pairs closer
+	than the gate become candidate edges.
+3.	Edges split tracks and detections into connected components. Each
+	component is solved on its own with the Hungarian algorithm, with
+	"leave unmatched" costing one gate squared, so the sum of squared
+	distances is minimal. The usual component is one track and one
+	detection; very large ones fall back to greedy nearest first.
+4.	Unmatched detections start new tracks. Unmatched tracks coast on their
+	prediction and are dropped after maxMissed frames, so a marker hidden
+	for a few frames comes back with its old ID.
+
+Label writes the IDs into frame->id[].
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "MarkerFrame.h"
+
+#define MARKER_TRACKER_MAX_COMPONENT    48
+
+class MarkerTracker {
+public:
+	MarkerTracker();
+
+	void Reset();
+	void Label(MarkerFrame* frame);
+
+	int Tracks() const { return (int)tracks.size(); }
+	//IDs handed out so far
+	int IdsUsed() const { return nextId; }
+	//Components labelled greedy nearest first so far, too large to solve
+	int GreedyComponents() const { return greedy; }
+
+	float gate;			// m, furthest a detection may be from a prediction
+	int maxMissed;		// frames a track coasts without a detection
+
+private:
+	struct Track {
+		int id;
+		float x, y, z;
+		float vx, vy, vz;
+		float px, py, pz;	// prediction for the current frame
+		double time;		// of the last detection
+		int missed;
+		int hits;
+	};
+
+	struct Edge {
+		int track;
+		int detection;
+		float cost;
+	};
+
+	int64_t Cell(float x, float y, float z) const;
+	int Find(int node);
+	void Solve(const std::vector<int>& componentTracks, const std::vector<int>& componentDetections);
+	void Greedy(const std::vector<int>& componentTracks, const std::vector<int>& componentDetections);
+
+	std::vector<Track> tracks;
+	int nextId;
+	int greedy;
+	double prev_t;
+
+	//scratch, kept between frames so labeling does not allocate
+	const MarkerFrame* frame;
+	std::vector<std::pair<int64_t, int> > cells;
+	std::vector<Edge> edges;
+	std::vector<int> edgeStart;			// first edge of each track, edges are grouped by track
+	std::vector<int> parent;
+	std::vector<int> trackMatch;		// detection matched to each track, -1 none
+	std::vector<int> detectionMatch;	// track matched to each detection, -1 none
+	std::vector<std::vector<int> > componentTracks;
+	std::vector<std::vector<int> > componentDetections;
+	std::vector<int> componentOf;		// component of each root node, -1 none
+	std::vector<int> localDetection;	// index of a detection within its component
+	std::vector<double> cost;
+	std::vector<double> u, v;
+	std::vector<int> p, way;
+	std::vector<double> minv;
+	std::vector<char> used;
+};
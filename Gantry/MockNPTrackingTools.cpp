@@ -0,0 +1,203 @@
+/* ************************************************************
+MockNPTrackingTools.cpp
+**************************************************************
+
+Stand-in for the NPTrackingTools library, implementing the TT_* calls
+the app makes so the tracking, logging and gantry alignment code can be
+run and profiled on a machine without Motive or cameras (including a
+Linux box).
+
+Build with MOCK_TRACKING_TOOLS defined to 1 and link this file instead
+of NPTrackingTools.lib; without the define the file is empty. The data
+comes from a replayed trial log or the simulated snake, passed through
+ImpairedTracking, and is chosen with environment variables:
+
+	GANTRY_MOCK_SOURCE		.gtl or .csv trial to replay; simulated snake if unset
+	GANTRY_MOCK_FAST		1 steps one recorded frame per TT_Update
+							instead of following the recorded time stamps
+	GANTRY_MOCK_RATE		simulated camera frame rate, Hz (120)
+	GANTRY_MOCK_MARKERS		simulated markers (14)
+	GANTRY_MOCK_NOISE		extra noise per coordinate, m (0)
+	GANTRY_MOCK_OCCLUSION	chance per frame a marker or rigid body is hidden (0)
+	GANTRY_MOCK_OCCLUSION_FRAMES	mean frames it stays hidden (5)
+	GANTRY_MOCK_DROP		chance per frame the frame is lost (0)
+	GANTRY_MOCK_SEED		random seed (1)
+
+Rigid bodies are the simulated ones (0 gantry, 1 and 2 contacts); a
+replayed trial has none.
+*/
+
+#include "stdafx.h"
+
+#if MOCK_TRACKING_TOOLS
+
+#include <cstdio>
+#include <cstdlib>
+#include "NPTrackingTools.h"
+#include "SimulatedDevices.h"
+#include "TrackingBackend.h"
+
+#define MOCK_RESULT_FAILED              1
+
+static TrackingBackend* mockSource = NULL;
+static ImpairedTracking* mock = NULL;
+static int mockRigidBodies = 0;
+
+static double envNumber(const char* name, double fallback)
+{
+	const char* value = getenv(name);
+	return ((value != NULL) && (*value != 0)) ? atof(value) : fallback;
+}
+
+NPRESULT TT_Initialize()
+{
+	if (mock != NULL) {
+		return NPRESULT_SUCCESS;
+	}
+
+	const char* replay = getenv("GANTRY_MOCK_SOURCE");
+	if ((replay != NULL) && (*replay != 0)) {
+		ReplayMode mode = (envNumber("GANTRY_MOCK_FAST", 0) != 0) ? REPLAY_FAST : REPLAY_REALTIME;
+		mockSource = new ReplayTrackingBackend(replay, mode);
+		mockRigidBodies = 0;
+	}
+	else {
+		SimulatedTracking* simulated = new SimulatedTracking();
+		simulated->frameRate = envNumber("GANTRY_MOCK_RATE", simulated->frameRate);
+		simulated->markers = (int)envNumber("GANTRY_MOCK_MARKERS", simulated->markers);
+		mockSource = simulated;
+		mockRigidBodies = SimulatedTracking::rigidBodies;
+	}
+
+	mock = new ImpairedTracking(mockSource, (unsigned)envNumber("GANTRY_MOCK_SEED", 1));
+	mock->noise = (float)envNumber("GANTRY_MOCK_NOISE", 0);
+	mock->occlusion = (float)envNumber("GANTRY_MOCK_OCCLUSION", 0);
+	mock->occlusionFrames = (float)envNumber("GANTRY_MOCK_OCCLUSION_FRAMES", 5);
+	mock->dropRate = (float)envNumber("GANTRY_MOCK_DROP", 0);
+
+	if (!mock->Initialize()) {
+		printf("Mock tracking: no data to play\n");
+		TT_Shutdown();
+		return MOCK_RESULT_FAILED;
+	}
+	return NPRESULT_SUCCESS;
+}
+
+NPRESULT TT_Shutdown()
+{
+	if (mock != NULL) {
+		mock->Shutdown();
+		delete mock;
+		delete mockSource;
+		mock = NULL;
+		mockSource = NULL;
+	}
+	return NPRESULT_SUCCESS;
+}
+
+NPRESULT TT_LoadProject(const char* filename)
+{
+	//rigid bodies come from the mock, not the project
+	return (mock != NULL) ? NPRESULT_SUCCESS : MOCK_RESULT_FAILED;
+}
+
+const char* TT_GetResultString(NPRESULT result)
+{
+	return (result == NPRESULT_SUCCESS) ? "Mock tracking: success" : "Mock tracking: not initialized or no data";
+}
+
+NPRESULT TT_Update()
+{
+	return ((mock != NULL) && mock->Update()) ? NPRESULT_SUCCESS : MOCK_RESULT_FAILED;
+}
+
+void TT_FlushCameraQueues()
+{
+	if (mock != NULL) {
+		mock->FlushCameraQueues();
+	}
+}
+
+double TT_FrameTimeStamp()
+{
+	return (mock != NULL) ? mock->FrameTimeStamp() : 0;
+}
+
+int TT_FrameMarkerCount()
+{
+	return (mock != NULL) ? mock->FrameMarkerCount() : 0;
+}
+
+static bool validMarker(int index)
+{
+	return (mock != NULL) && (index >= 0) && (index < mock->FrameMarkerCount());
+}
+
+float TT_FrameMarkerX(int index)
+{
+	return validMarker(index) ? mock->MarkerX(index) : 0;
+}
+
+float TT_FrameMarkerY(int index)
+{
+	return validMarker(index) ? mock->MarkerY(index) : 0;
+}
+
+float TT_FrameMarkerZ(int index)
+{
+	return validMarker(index) ? mock->MarkerZ(index) : 0;
+}
+
+int TT_RigidBodyCount()
+{
+	return mockRigidBodies;
+}
+
+static bool validRigidBody(int index)
+{
+	return (mock != NULL) && (index >= 0) && (index < mockRigidBodies);
+}
+
+bool TT_IsRigidBodyTracked(int index)
+{
+	return validRigidBody(index) && mock->IsRigidBodyTracked(index);
+}
+
+void TT_RigidBodyLocation(int index, float* x, float* y, float* z, float* qx, float* qy, float* qz, float* qw, float* yaw, float* pitch, float* roll)
+{
+	RigidBodyPose pose = RigidBodyPose();
+	pose.qw = 1;
+	if (validRigidBody(index)) {
+		mock->RigidBodyLocation(index, &pose);
+	}
+	*x = pose.x;
+	*y = pose.y;
+	*z = pose.z;
+	*qx = pose.qx;
+	*qy = pose.qy;
+	*qz = pose.qz;
+	*qw = pose.qw;
+	*yaw = pose.yaw;
+	*pitch = pose.pitch;
+	*roll = pose.roll;
+}
+
+const char* TT_RigidBodyName(int index)
+{
+	static const char* names[] = { "Gantry", "Contact1", "Contact2", "RigidBody3", "RigidBody4" };
+	return ((index >= 0) && (index < 5)) ? names[index] : "";
+}
+
+bool TT_RigidBodyEnabled(int index)
+{
+	return validRigidBody(index) && mock->RigidBodyEnabled(index);
+}
+
+void TT_SetRigidBodyEnabled(int index, bool enabled)
+{
+	if (validRigidBody(index)) {
+		mock->SetRigidBodyEnabled(index, enabled);
+	}
+}
+
+#endif
@@ -0,0 +1,158 @@
+/* ************************************************************
+MotionPlanner.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "GantryCommand.h"
+#include "MotionPlanner.h"
+#include "SerialDemux.h"
+
+using namespace std;
+
+/*********************************************************************
+
+Trajectory
+
+*********************************************************************/
+
+Trajectory::Trajectory()
+	: duration(0), ramp(0), peak(0)
+{
+	from.x = from.z = from.rotation = 0;
+	to = from;
+}
+
+void Trajectory::Sample(double t, MotionPoint* point) const
+{
+	//fraction of the path done, trapezoidal in time
+	double s = 1;
+	if (t <= 0) {
+		s = 0;
+	}
+	else if (t < duration) {
+		if (t < ramp) {
+			s = 0.5 * peak / ramp * t * t;
+		}
+		else if (t > duration - ramp) {
+			s = 1 - 0.5 * peak / ramp * (duration - t) * (duration - t);
+		}
+		else {
+			s = peak * (t - ramp / 2);
+		}
+	}
+	point->x = (float)(from.x + (to.x - from.x) * s);
+	point->z = (float)(from.z + (to.z - from.z) * s);
+	point->rotation = (float)(from.rotation + (to.rotation - from.rotation) * s);
+}
+
+/*********************************************************************
+
+MotionPlanner
+
+*********************************************************************/
+
+MotionPlanner::MotionPlanner(SerialLink* SP, GrblStatusPoller* grbl, GantryEstimator* estimator, const GantrySettings& gantry)
+	: gantry(gantry), rotationSpeed(60), rotationAcceleration(120),
+	period(0.05), rotation(120), SP(SP), grbl(grbl), estimator(estimator)
+{
+}
+
+Trajectory MotionPlanner::Plan(float x, float z, float target) const
+{
+	Trajectory trajectory;
+	trajectory.from.rotation = rotation;
+	trajectory.to.x = x;
+	trajectory.to.z = z;
+	trajectory.to.rotation = target;
+
+	//limits on the shared path fraction from whichever axis is tighter
+	double travel = sqrt(x * x + z * z);
+	double turn = fabs(target - rotation);
+	double speed = 1e9, acceleration = 1e9;
+	if (travel > 0) {
+		speed = min(speed, gantry.travelSpeed / travel);
+		acceleration = min(acceleration, gantry.travelAcceleration / travel);
+	}
+	if (turn > 0) {
+		speed = min(speed, rotationSpeed / turn);
+		acceleration = min(acceleration, rotationAcceleration / turn);
+	}
+	if ((travel <= 0) && (turn <= 0)) {
+		return trajectory;
+	}
+
+	//triangle if the move is too short to reach the cruise speed
+	if (speed * speed / acceleration >= 1) {
+		trajectory.ramp = sqrt(1 / acceleration);
+		trajectory.peak = acceleration * trajectory.ramp;
+		trajectory.duration = 2 * trajectory.ramp;
+	}
+	else {
+		trajectory.ramp = speed / acceleration;
+		trajectory.peak = speed;
+		trajectory.duration = 1 / speed + trajectory.ramp;
+	}
+	return trajectory;
+}
+
+double MotionPlanner::MoveTime(float x, float z, float target) const
+{
+	return Plan(x, z, target).Duration();
+}
+
+bool MotionPlanner::Execute(const Trajectory& trajectory)
+{
+	int servo = (int)lround(rotation);
+	bool written = true;
+	MotionPoint planned;
+	GrblStatus status;
+
+	//the travel is one move, run by GRBL at the limits it was planned with
+	float dx = trajectory.to.x - trajectory.from.x;
+	float dz = trajectory.to.z - trajectory.from.z;
+	if ((dx != 0) || (dz != 0)) {
+		written &= SendCommand(SP, GantryCommand::MoveZX(dz, dx));
+		if (estimator != NULL) {
+			estimator->AddCommand(GrblClock(), dx, dz, gantry.travelSpeed);
+		}
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chrono::steady_clock::time_point wake = start;
+
+	while (true) {
+		double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		//the servo follows the plan as it happens, one step at a time
+		trajectory.Sample(elapsed, &planned);
+		if ((int)lround(planned.rotation) != servo) {
+			servo = (int)lround(planned.rotation);
+			written &= SendCommand(SP, GantryCommand::Rotate(servo));
+		}
+
+		if ((grbl != NULL) && (estimator != NULL) && grbl->Latest(&status)) {
+			estimator->AddGrbl(status);
+		}
+
+		if (elapsed >= trajectory.Duration()) {
+			break;
+		}
+
+		wake += chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(period));
+		this_thread::sleep_until(wake);
+	}
+
+	if ((int)lround(trajectory.to.rotation) != servo) {
+		written &= SendCommand(SP, GantryCommand::Rotate((int)lround(trajectory.to.rotation)));
+	}
+	rotation = trajectory.to.rotation;
+	return written;
+}
@@ -0,0 +1,85 @@
+/* ************************************************************
+MotionPlanner.h
+**************************************************************
+
+One coordinated move of the gantry head and the end effector servo,
+instead of a moveZ..,X.. followed by a separate rots<motor> and fixed
+sleeps.
+
+Plan builds a straight line from where the head is to a relative X/Z
+offset (machine mm) and an absolute servo position, time parameterized
+with a trapezoid: the travel and the rotation share one path fraction
+that accelerates, cruises and decelerates within the limits of both, so
+they start and finish together and the servo turns during the travel.
+Duration() is the move time estimate, known before anything is sent.
+The travel limits are GRBL's, from the plan (ExperimentPlan.h).
+
+Execute sends the travel as the one moveZ..,X.. the sketch has always
+run, which GRBL plans at those same limits, then steps the servo along
+the planned rotation with a rots each period the planned position has
+moved on a whole step. When the rotation is the slower of the two the
+head arrives first and the servo finishes the plan. The move is added
+to the GantryEstimator so the estimate follows it.
+
+The servo position last sent is kept in rotation; set it when a rots is
+sent outside the planner.
+*/
+
+#pragma once
+
+#include "ExperimentPlan.h"
+#include "GantryEstimator.h"
+#include "GrblStatus.h"
+#include "SerialLink.h"
+
+struct MotionPoint {
+	float x, z;			// machine mm, relative to the start of the move
+	float rotation;		// servo position
+};
+
+class Trajectory {
+public:
+	Trajectory();
+
+	//s from the first increment to the end of the move
+	double Duration() const { return duration; }
+
+	//Planned point t seconds into the move, held at the ends
+	void Sample(double t, MotionPoint* point) const;
+
+	MotionPoint from, to;
+
+private:
+	friend class MotionPlanner;
+
+	double duration;
+	double ramp;		// s spent accelerating, and again decelerating
+	double peak;		// path fraction per second while cruising
+};
+
+class MotionPlanner {
+public:
+	//grbl and estimator may be NULL
+	MotionPlanner(SerialLink* SP, GrblStatusPoller* grbl, GantryEstimator* estimator, const GantrySettings& gantry);
+
+	//Move by (x, z) mm while turning the servo to rotation
+	Trajectory Plan(float x, float z, float rotation) const;
+
+	//Same as Plan(x, z, rotation).Duration()
+	double MoveTime(float x, float z, float rotation) const;
+
+	//Sends the move, then the servo steps as the plan reaches them; returns
+	//once the last rots is sent, the head may still be moving
+	bool Execute(const Trajectory& trajectory);
+
+	GantrySettings gantry;		// travel speed and acceleration along the X/Z path
+	float rotationSpeed;		// servo positions per second
+	float rotationAcceleration;	// servo positions per second^2
+	double period;				// s between servo updates
+	float rotation;				// servo position last sent
+
+private:
+	SerialLink* SP;
+	GrblStatusPoller* grbl;
+	GantryEstimator* estimator;
+};
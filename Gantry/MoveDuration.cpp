@@ -0,0 +1,135 @@
+/* ************************************************************
+MoveDuration.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include "AsyncLog.h"
+#include "GantryCommand.h"
+#include "MoveDuration.h"
+#include "Trace.h"
+
+using namespace std;
+
+/*********************************************************************
+
+MoveDuration
+
+*********************************************************************/
+
+MoveDuration::MoveDuration(const GantrySettings& gantry)
+	: gantry(gantry), firgelliStroke(200), firgelliSpeed(22), firgelliMeasured(false),
+	margin(0.1), latency(0.1), motionTimeout(100)
+{
+}
+
+double MoveDuration::Move(float machineX, float machineZ) const
+{
+	double d = hypot(machineX, machineZ);
+	if (d <= 0) {
+		return 0;
+	}
+	double speed = gantry.travelSpeed;
+	double acceleration = gantry.travelAcceleration;
+	if (acceleration <= 0) {
+		return d / speed;
+	}
+
+	//trapezoid, or a triangle if the move is too short to reach the speed
+	double ramp = speed / acceleration;
+	if (d >= speed * ramp) {
+		return d / speed + ramp;
+	}
+	return 2 * sqrt(d / acceleration);
+}
+
+double MoveDuration::Firgelli(float from, float to) const
+{
+	return fabs(to - from) * firgelliStroke / firgelliSpeed;
+}
+
+double MoveDuration::FirgelliWait(float from, float to, double sleep) const
+{
+	if (!firgelliMeasured) {
+		return sleep;
+	}
+	return min(Deadline(Firgelli(from, to)), sleep);
+}
+
+bool MoveDuration::WaitMotion(SerialDemux* SP, const string& name, double predicted, double sleep)
+{
+	TraceScope scope("wait motion", name.c_str());
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	string motionMessage;
+	SP->Flush(MESSAGE_MOTION);
+	SendCommand(SP, GantryCommand::Wait());
+	bool done = SP->Wait(MESSAGE_MOTION, &motionMessage, (int)(1000 * motionTimeout));
+	double taken = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	Record(name, sleep, predicted, taken);
+	Late(name, predicted, taken);
+	if (!done) {
+		printf("%s: gantry still moving after %.0f s\n", name.c_str(), motionTimeout);
+	}
+	return done;
+}
+
+void MoveDuration::Late(const string& name, double predicted, double taken) const
+{
+	if (taken > Deadline(predicted)) {
+		printf("%s late: %.2f s, deadline %.2f s\n", name.c_str(), taken, Deadline(predicted));
+	}
+}
+
+void MoveDuration::Record(const string& name, double sleep, double predicted, double taken)
+{
+	Wait wait = { name, sleep, predicted, taken };
+	lock_guard<mutex> guard(lock);
+	waits.push_back(wait);
+}
+
+double MoveDuration::Saved()
+{
+	lock_guard<mutex> guard(lock);
+	double saved = 0;
+	for (size_t i = 0; i < waits.size(); i++) {
+		if (waits[i].sleep > 0) {
+			saved += waits[i].sleep - waits[i].taken;
+		}
+	}
+	return saved;
+}
+
+void MoveDuration::Report(AsyncLog* logger)
+{
+	double saved = Saved();
+
+	lock_guard<mutex> guard(lock);
+	double taken = 0, slept = 0;
+	printf("  %-20s %8s %9s %8s %8s\n", "wait", "sleep", "predicted", "taken", "saved");
+	for (size_t i = 0; i < waits.size(); i++) {
+		const Wait& wait = waits[i];
+		if (wait.sleep > 0) {
+			printf("  %-20s %8.2f %9.2f %8.2f %8.2f\n", wait.name.c_str(), wait.sleep, wait.predicted,
+				wait.taken, wait.sleep - wait.taken);
+			taken += wait.taken;
+			slept += wait.sleep;
+		}
+		else {
+			printf("  %-20s %8s %9.2f %8.2f %8s\n", wait.name.c_str(), "-", wait.predicted, wait.taken, "-");
+		}
+	}
+	printf("waits %.2f s against %.2f s of fixed sleeps, %.2f s saved\n", taken, slept, saved);
+
+	if (logger != NULL) {
+		logger->Value(LOG_DEBUG, "Wait seconds ", taken, false);
+		logger->Value(LOG_DEBUG, " fixed sleep seconds ", slept, false);
+		logger->Value(LOG_DEBUG, " saved ", saved);
+		logger->Value(LOG_TRIAL, "Wait Seconds Saved,\t\t", saved);
+	}
+	waits.clear();
+}
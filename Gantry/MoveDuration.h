@@ -0,0 +1,86 @@
+/* ************************************************************
+MoveDuration.h
+**************************************************************
+
+Predicted time for each gantry command, so the wait after it is a
+deadline sized to that command instead of a sleep sized for the worst
+one (10 s after yneg, 13 s after ypos, 22 s for the second lowering...).
+
+Moves are trapezoids at the speed and acceleration GRBL runs at (the
+plan's gantry settings), or triangles when too short to reach the
+speed, the same profile the motion planner uses. The Firgelli has no position feedback, so a stroke
+takes its length over the actuator speed under load. Every prediction
+gets a margin and the serial latency on top to become a deadline.
+
+Where the gantry says when it is done ("done moving" after "wait") the
+wait ends there and the deadline only marks the command as late. Where
+it does not (the Firgelli) the prediction is only as good as the stroke
+and speed it is given, and those have not been measured on the rig: the
+defaults would cut the 13 s lift and the 22 s drop to about 10 s. So
+until firgelliMeasured is set the wait stays the old sleep and the
+prediction is only reported; once it is, the wait ends at the deadline,
+never later than the old sleep.
+
+Every wait is recorded against the sleep it replaced; Report prints
+them with the time saved and clears the record for the next trial.
+*/
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ExperimentPlan.h"
+#include "SerialDemux.h"
+
+class AsyncLog;
+
+class MoveDuration {
+public:
+	MoveDuration(const GantrySettings& gantry);
+
+	//s for a relative move of machine mm
+	double Move(float machineX, float machineZ) const;
+	//s for the Firgelli between extensions, 0 fully up to 1 fully down
+	double Firgelli(float from, float to) const;
+
+	//Latest the command should take, with margin and latency
+	double Deadline(double predicted) const { return predicted * (1 + margin) + latency; }
+	//Timed wait for a command without a completion signal: the deadline,
+	//but no more than the sleep it replaces, or the sleep itself until the
+	//Firgelli is measured
+	double FirgelliWait(float from, float to, double sleep) const;
+
+	//Prints a warning if a command with a completion signal overran its deadline
+	void Late(const std::string& name, double predicted, double taken) const;
+
+	//Asks for "done moving" after the move just sent and waits for it,
+	//recording the wait as name; false if the gantry is still moving
+	//motionTimeout s later
+	bool WaitMotion(SerialDemux* SP, const std::string& name, double predicted, double sleep);
+
+	//A wait that used to be sleep s, predicted and taken in s; sleep 0 for
+	//one that had no fixed sleep. Safe from any thread.
+	void Record(const std::string& name, double sleep, double predicted, double taken);
+	//s saved over the recorded waits
+	double Saved();
+	//Prints the recorded waits, logs the totals and starts a new record
+	void Report(AsyncLog* logger = NULL);
+
+	GantrySettings gantry;	// GRBL travel speed and acceleration for move commands
+	float firgelliStroke;	// mm, full travel
+	float firgelliSpeed;	// mm/s under the snake's weight
+	bool firgelliMeasured;	// stroke and speed measured on the rig, so the waits may follow them
+	double margin;			// fraction added to every prediction
+	double latency;			// s, command over serial until motion starts
+	double motionTimeout;	// s a move may run before WaitMotion gives up
+
+private:
+	struct Wait {
+		std::string name;
+		double sleep, predicted, taken;
+	};
+
+	std::mutex lock;
+	std::vector<Wait> waits;
+};
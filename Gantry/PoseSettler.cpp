@@ -0,0 +1,139 @@
+/* ************************************************************
+PoseSettler.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#define _USE_MATH_DEFINES
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include "PoseSettler.h"
+#include "Trace.h"
+
+using namespace std;
+using namespace std::chrono;
+
+PoseSettler::PoseSettler(TrackingBackend* backend)
+	: positionTolerance(0.0005f), angleTolerance(0.2f), timeout(5), pollInterval(1), backend(backend)
+{
+}
+
+bool PoseSettler::Acquire(int index, RigidBodyPose* pose, SettleResult* result)
+{
+	TraceScope scope("settle");
+	PoseWindow window(1.0f, INFINITY, 0);
+	SettleResult local;
+	if (result == 0) {
+		result = &local;
+	}
+	result->settled = false;
+	result->frames = 0;
+	result->untracked = 0;
+	result->positionSpread = INFINITY;
+	result->angleSpread = INFINITY;
+	result->positionShift = INFINITY;
+
+	//mean of the window, accumulated from the raw samples
+	double sum[7] = { 0 };
+	float samples[POSE_SETTLE_WINDOW][7];
+
+	RigidBodyPose current = RigidBodyPose();
+	steady_clock::time_point start = steady_clock::now();
+	double prev_t = -1;
+
+	while (true) {
+		result->seconds = duration<double>(steady_clock::now() - start).count();
+		if (result->seconds > timeout) {
+			break;
+		}
+
+		if (!backend->Update() || (backend->FrameTimeStamp() == prev_t)) {
+			this_thread::sleep_for(milliseconds(pollInterval));
+			continue;
+		}
+		prev_t = backend->FrameTimeStamp();
+		result->frames++;
+
+		if (!backend->IsRigidBodyTracked(index)) {
+			result->untracked++;
+			window.Reset();
+			for (int c = 0; c < 7; c++) {
+				sum[c] = 0;
+			}
+			continue;
+		}
+
+		backend->RigidBodyLocation(index, &current);
+		float sign = (current.qw < 0) ? -1.0f : 1.0f;
+		float sample[7] = { current.x, current.y, current.z, sign * current.qx, sign * current.qy, sign * current.qz, sign * current.qw };
+
+		int slot = window.Count() % POSE_SETTLE_WINDOW;
+		for (int c = 0; c < 7; c++) {
+			if (window.Count() >= POSE_SETTLE_WINDOW) {
+				sum[c] -= samples[slot][c];
+			}
+			samples[slot][c] = sample[c];
+			sum[c] += sample[c];
+		}
+		window.Update(sample);
+
+		if (window.Count() < POSE_SETTLE_WINDOW) {
+			continue;
+		}
+
+		result->positionSpread = max(window.Spread(0), max(window.Spread(1), window.Spread(2)));
+		float q = max(max(window.Spread(3), window.Spread(4)), max(window.Spread(5), window.Spread(6)));
+		result->angleSpread = (float)(2 * q * 180 / M_PI);
+
+		//a slow creep stays inside the spread, but moves the newer half of
+		//the window away from the older
+		result->positionShift = 0;
+		for (int c = 0; c < 3; c++) {
+			double older = 0, newer = 0;
+			for (int k = 0; k < POSE_SETTLE_WINDOW; k++) {
+				float value = samples[(slot + 1 + k) % POSE_SETTLE_WINDOW][c];
+				if (k < POSE_SETTLE_WINDOW / 2) {
+					older += value;
+				}
+				else {
+					newer += value;
+				}
+			}
+			result->positionShift = max(result->positionShift, (float)fabs(newer - older) / (POSE_SETTLE_WINDOW / 2));
+		}
+
+		if ((result->positionSpread <= positionTolerance) && (result->positionShift <= positionTolerance / 2) &&
+			(result->angleSpread <= angleTolerance)) {
+			result->settled = true;
+			break;
+		}
+	}
+
+	if (!result->settled) {
+		*pose = current;
+		printf("Rigid body %d did not settle in %.1f s: %d frames, %d untracked, spread %.2f mm %.2f deg, shift %.2f mm\n",
+			index, result->seconds, result->frames, result->untracked, result->positionSpread * 1000, result->angleSpread,
+			result->positionShift * 1000);
+		return false;
+	}
+
+	//mean pose of the window, angles from the last sample
+	*pose = current;
+	pose->x = (float)(sum[0] / POSE_SETTLE_WINDOW);
+	pose->y = (float)(sum[1] / POSE_SETTLE_WINDOW);
+	pose->z = (float)(sum[2] / POSE_SETTLE_WINDOW);
+	double qx = sum[3], qy = sum[4], qz = sum[5], qw = sum[6];
+	double norm = sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+	if (norm > 0) {
+		pose->qx = (float)(qx / norm);
+		pose->qy = (float)(qy / norm);
+		pose->qz = (float)(qz / norm);
+		pose->qw = (float)(qw / norm);
+	}
+	return true;
+}
@@ -0,0 +1,61 @@
+/* ************************************************************
+PoseSettler.h
+**************************************************************
+
+Waits for a rigid body to hold still instead of spinning TT_Update a
+fixed 600 times between one second sleeps.
+
+Acquire streams the body's pose one camera frame at a time and returns
+as soon as the last POSE_SETTLE_WINDOW frames were all tracked and the
+standard deviation of the position and of the orientation over them is
+below tolerance. The means of the window's older and newer halves must
+also agree to half the position tolerance, so a body still creeping
+after a move, too slowly for the spread to show it, is not taken before
+it stops. It returns the mean pose of that window. A frame where
+the body is not tracked restarts the window. If the pose does not settle
+within timeout seconds, Acquire prints why and returns false with the
+last pose it saw.
+
+The window is 0.2 s at 120 Hz. A sway slower than that can look still
+for a window at the end of its swing, and the pose is then taken off
+its rest position by up to the sway left.
+
+Orientation is compared as the quaternion (sign fixed so qw >= 0), which
+has no wrap-around. For small rotations a spread of s in the quaternion
+is about 2s radians.
+*/
+
+#pragma once
+
+#include "StreamFilter.h"
+#include "TrackingBackend.h"
+
+#define POSE_SETTLE_WINDOW              24
+
+struct SettleResult {
+	bool settled;
+	int frames;				// camera frames looked at
+	int untracked;			// of those, frames without the body
+	double seconds;
+	float positionSpread;	// std deviation over the window, m
+	float angleSpread;		// std deviation over the window, degrees
+	float positionShift;	// between the means of the window's halves, m
+};
+
+class PoseSettler {
+public:
+	PoseSettler(TrackingBackend* backend);
+
+	bool Acquire(int index, RigidBodyPose* pose, SettleResult* result = 0);
+
+	float positionTolerance;	// m
+	float angleTolerance;		// degrees
+	double timeout;				// s
+	int pollInterval;			// ms between Updates when there is no new frame
+
+private:
+	//x, y, z, qx, qy, qz, qw, no smoothing or outlier rejection
+	typedef StreamFilter<7, POSE_SETTLE_WINDOW> PoseWindow;
+
+	TrackingBackend* backend;
+};
@@ -0,0 +1,411 @@
+/* ************************************************************
+ResetGraph.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include "AsyncLog.h"
+#include "GantryCommand.h"
+#include "ResetGraph.h"
+#include "Trace.h"
+
+using namespace std;
+
+/*********************************************************************
+
+ResetGraph
+
+*********************************************************************/
+
+ResetGraph::ResetGraph()
+	: pollInterval(20), elapsed(0)
+{
+}
+
+int ResetGraph::Add(const string& name, StageAction start, StageCondition done, double timeout, initializer_list<int> after)
+{
+	Stage stage;
+	stage.name = name;
+	stage.start = start;
+	stage.done = done;
+	stage.timeout = timeout;
+	stage.after.assign(after.begin(), after.end());
+	stage.state = STAGE_PENDING;
+	stage.begin = stage.end = 0;
+	stage.gate = -1;
+	stages.push_back(stage);
+	return (int)stages.size() - 1;
+}
+
+StageCondition ResetGraph::After(double seconds)
+{
+	return [seconds](double elapsed) { return elapsed >= seconds; };
+}
+
+StageCondition ResetGraph::Motion(SerialDemux* SP)
+{
+	return [SP](double elapsed) {
+		string motionMessage;
+		return SP->Wait(MESSAGE_MOTION, &motionMessage, 0);
+	};
+}
+
+bool ResetGraph::RunStage(const Stage& stage)
+{
+	//runs on the stage's own thread; Run records the outcome
+	Trace::NameThread(stage.name.c_str());
+	TraceScope scope(stage.name.c_str());
+	chrono::steady_clock::time_point started = chrono::steady_clock::now();
+	bool ok = !stage.start || stage.start();
+	while (ok && stage.done) {
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+		if (stage.done(seconds)) {
+			break;
+		}
+		if ((stage.timeout > 0) && (seconds > stage.timeout)) {
+			printf("Reset stage %s timed out after %.1f s\n", stage.name.c_str(), seconds);
+			ok = false;
+			break;
+		}
+		this_thread::sleep_for(chrono::milliseconds(pollInterval));
+	}
+	return ok;
+}
+
+bool ResetGraph::Run()
+{
+	TraceScope scope("reset");
+	for (size_t i = 0; i < stages.size(); i++) {
+		stages[i].state = STAGE_PENDING;
+		stages[i].begin = stages[i].end = 0;
+		stages[i].gate = -1;
+	}
+
+	mutex lock;
+	condition_variable finished;
+	vector<thread> threads;
+	int running = 0;
+	chrono::steady_clock::time_point origin = chrono::steady_clock::now();
+	auto now = [origin]() { return chrono::duration<double>(chrono::steady_clock::now() - origin).count(); };
+
+	unique_lock<mutex> guard(lock);
+	while (true) {
+		bool changed = false;
+		for (size_t i = 0; i < stages.size(); i++) {
+			Stage& stage = stages[i];
+			if (stage.state != STAGE_PENDING) {
+				continue;
+			}
+
+			bool ready = true, blocked = false;
+			int gate = -1;
+			for (size_t d = 0; d < stage.after.size(); d++) {
+				const Stage& before = stages[stage.after[d]];
+				if ((before.state == STAGE_FAILED) || (before.state == STAGE_SKIPPED)) {
+					blocked = true;
+				}
+				else if (before.state != STAGE_DONE) {
+					ready = false;
+				}
+				else if ((gate < 0) || (before.end > stages[gate].end)) {
+					gate = stage.after[d];
+				}
+			}
+
+			if (blocked) {
+				stage.state = STAGE_SKIPPED;
+				changed = true;
+			}
+			else if (ready) {
+				stage.state = STAGE_RUNNING;
+				stage.begin = now();
+				stage.gate = gate;
+				running++;
+				changed = true;
+				threads.emplace_back([this, &stage, &lock, &finished, &running, now]() {
+					bool ok = RunStage(stage);
+					lock_guard<mutex> done(lock);
+					stage.state = ok ? STAGE_DONE : STAGE_FAILED;
+					stage.end = now();
+					running--;
+					finished.notify_one();
+				});
+			}
+		}
+
+		if (!changed) {
+			if (running == 0) {
+				break;
+			}
+			finished.wait(guard);
+		}
+	}
+	guard.unlock();
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+
+	elapsed = 0;
+	bool complete = true;
+	for (size_t i = 0; i < stages.size(); i++) {
+		elapsed = max(elapsed, stages[i].end);
+		complete = complete && (stages[i].state == STAGE_DONE);
+	}
+	return complete;
+}
+
+vector<int> ResetGraph::CriticalPath() const
+{
+	int last = -1;
+	for (size_t i = 0; i < stages.size(); i++) {
+		bool ran = (stages[i].state == STAGE_DONE) || (stages[i].state == STAGE_FAILED);
+		if (ran && ((last < 0) || (stages[i].end > stages[last].end))) {
+			last = (int)i;
+		}
+	}
+
+	vector<int> path;
+	for (int i = last; i >= 0; i = stages[i].gate) {
+		path.push_back(i);
+	}
+	reverse(path.begin(), path.end());
+	return path;
+}
+
+double ResetGraph::SerialTime() const
+{
+	double total = 0;
+	for (size_t i = 0; i < stages.size(); i++) {
+		total += stages[i].end - stages[i].begin;
+	}
+	return total;
+}
+
+void ResetGraph::Report(AsyncLog* logger) const
+{
+	static const char* stateNames[] = { "pending", "running", "done", "FAILED", "skipped" };
+
+	vector<int> path = CriticalPath();
+	printf("  %-20s %8s %8s\n", "reset stage", "start", "seconds");
+	for (size_t i = 0; i < stages.size(); i++) {
+		const Stage& stage = stages[i];
+		bool critical = find(path.begin(), path.end(), (int)i) != path.end();
+		printf("%c %-20s %8.2f %8.2f  %s\n", critical ? '*' : ' ', stage.name.c_str(), stage.begin,
+			stage.end - stage.begin, stateNames[stage.state]);
+	}
+	printf("reset %.2f s, %.2f s if run one stage after another\n", elapsed, SerialTime());
+
+	if (logger != NULL) {
+		logger->Value(LOG_DEBUG, "Reset seconds ", elapsed, false);
+		logger->Value(LOG_DEBUG, " serial seconds ", SerialTime());
+		string critical = "Reset critical path:";
+		for (size_t i = 0; i < path.size(); i++) {
+			critical += (i == 0) ? " " : " > ";
+			critical += stages[path[i]].name;
+		}
+		logger->Text(LOG_DEBUG, critical);
+	}
+}
+
+/*********************************************************************
+
+Drop-off
+
+*********************************************************************/
+
+DropOff::DropOff()
+	: SP(NULL), magnets(NULL), session(NULL), planner(NULL), durations(NULL), servoAngle(120),
+	lowerTime(10.4), retryTime(22), liftTime(13), dropTime(22), clearTime(3), raiseTime(6),
+	awayTime(24), clearance(60), awayDistance(900), moveTimeout(100), startX(0), startZ(0)
+{
+}
+
+//Ask for "done moving" once the move just sent has finished
+static void requestMotion(SerialDemux* SP)
+{
+	SP->Flush(MESSAGE_MOTION);
+	SendCommand(SP, GantryCommand::Wait());
+}
+
+//Firgelli stage from one extension to another (0 up, 1 down): the
+//duration model's wait when there is one, sleep otherwise
+static StageCondition stroke(DropOff* dropOff, const string& name, float from, float to, double sleep)
+{
+	MoveDuration* durations = dropOff->durations;
+	if (durations == NULL) {
+		return ResetGraph::After(sleep);
+	}
+	double predicted = durations->Firgelli(from, to);
+	double seconds = durations->FirgelliWait(from, to, sleep);
+	return [=](double elapsed) {
+		if (elapsed < seconds) {
+			return false;
+		}
+		durations->Record(name, sleep, predicted, elapsed);
+		return true;
+	};
+}
+
+//Gantry move stage, done at "done moving" and recorded against sleep
+static StageCondition motion(DropOff* dropOff, const string& name, double sleep, function<double()> predict)
+{
+	StageCondition moved = ResetGraph::Motion(dropOff->SP);
+	MoveDuration* durations = dropOff->durations;
+	if (durations == NULL) {
+		return moved;
+	}
+	return [=](double elapsed) {
+		if (!moved(elapsed)) {
+			return false;
+		}
+		double predicted = predict();
+		durations->Record(name, sleep, predicted, elapsed);
+		durations->Late(name, predicted, elapsed);
+		return true;
+	};
+}
+
+void AddDropOffStages(ResetGraph* graph, DropOff* dropOff)
+{
+	SerialDemux* SP = dropOff->SP;
+	MoveDuration* durations = dropOff->durations;
+	float cleared = 1;
+	if (durations != NULL) {
+		cleared = max(0.0f, 1 - dropOff->clearance / durations->firgelliStroke);
+	}
+
+	//pick the snake up over the target
+	int magnetsOn = graph->Add("magnets on", [SP]() {
+		SendCommand(SP, GantryCommand::Clear());
+		SendCommand(SP, GantryCommand::MagnetsOn());
+		return true;
+	}, StageCondition(), 0);
+
+	int lower = graph->Add("lower", [SP]() {
+		SendCommand(SP, GantryCommand::Clear());
+		SendCommand(SP, GantryCommand::LowerY());
+		return true;
+	}, stroke(dropOff, "lower", 0, 1, dropOff->lowerTime), 0);
+
+	int stopLower = graph->Add("stop lower", [SP]() {
+		SendCommand(SP, GantryCommand::Clear());
+		SendCommand(SP, GantryCommand::StopY());
+		return true;
+	}, StageCondition(), 0, { lower });
+
+	int contact = graph->Add("contact", [SP, dropOff]() {
+		MagnetReading reading;
+		if (dropOff->magnets->CheckContact(&reading)) {
+			printf("Succesfully Made Contact, continuing (%d samples)\n", reading.samples);
+			return true;
+		}
+
+		//one more full stroke down, then give up on the trial
+		printf("failed to make successful contact, trying again\n");
+		SendCommand(SP, GantryCommand::Clear());
+		SendCommand(SP, GantryCommand::LowerY());
+		double retry = dropOff->retryTime;
+		if (dropOff->durations != NULL) {
+			retry = dropOff->durations->FirgelliWait(0, 1, dropOff->retryTime);
+		}
+		chrono::steady_clock::time_point lowered = chrono::steady_clock::now();
+		this_thread::sleep_for(chrono::duration<double>(retry));
+		if (dropOff->durations != NULL) {
+			dropOff->durations->Record("lower again", dropOff->retryTime, dropOff->durations->Firgelli(0, 1),
+				chrono::duration<double>(chrono::steady_clock::now() - lowered).count());
+		}
+		if (dropOff->magnets->CheckContact(&reading)) {
+			printf("Succesfully Made Contact, continuing (%d samples)\n", reading.samples);
+			return true;
+		}
+		return false;
+	}, StageCondition(), 0, { magnetsOn, stopLower });
+
+	int lift = graph->Add("lift", [SP]() {
+		SendCommand(SP, GantryCommand::Clear());
+		SendCommand(SP, GantryCommand::RaiseY());
+		return true;
+	}, stroke(dropOff, "lift", 1, 0, dropOff->liftTime), 0, { contact });
+
+	//carry it to the start of the next trial
+	int turn = graph->Add("turn", [SP, dropOff]() {
+		SendCommand(SP, GantryCommand::Rotate(dropOff->servoAngle));
+		if (dropOff->planner != NULL) {
+			dropOff->planner->rotation = (float)dropOff->servoAngle;
+		}
+		return true;
+	}, StageCondition(), 0, { lift });
+
+	//the turn moves the gantry rigid body, so the start is measured after it
+	int locate = graph->Add("locate start", [dropOff]() {
+		return dropOff->locateStart(&dropOff->startX, &dropOff->startZ);
+	}, StageCondition(), 0, { turn });
+
+	int toStart = graph->Add("go to start", [SP, dropOff]() {
+		SendCommand(SP, GantryCommand::MoveZX(dropOff->startZ, dropOff->startX));
+		requestMotion(SP);
+		return true;
+	}, motion(dropOff, "go to start", 0, [dropOff]() {
+		return dropOff->durations->Move(dropOff->startX, dropOff->startZ);
+	}), dropOff->moveTimeout, { locate });
+
+	int stopLift = graph->Add("stop lift", [SP]() {
+		SendCommand(SP, GantryCommand::StopY());
+		return true;
+	}, StageCondition(), 0, { toStart });
+
+	//set it down and leave
+	int drop = graph->Add("drop", [SP]() {
+		SendCommand(SP, GantryCommand::Clear());
+		SendCommand(SP, GantryCommand::LowerY());
+		return true;
+	}, stroke(dropOff, "drop", 0, 1, dropOff->dropTime), 0, { stopLift });
+
+	int magnetsOff = graph->Add("magnets off", [SP]() {
+		SendCommand(SP, GantryCommand::MagnetsOff());
+		return true;
+	}, StageCondition(), 0, { drop });
+
+	int clear = graph->Add("clear", [SP]() {
+		SendCommand(SP, GantryCommand::RaiseY());
+		return true;
+	}, stroke(dropOff, "clear", 1, cleared, dropOff->clearTime), 0, { magnetsOff });
+
+	graph->Add("move away", [SP, dropOff]() {
+		SendCommand(SP, GantryCommand::MoveX(dropOff->awayDistance));
+		requestMotion(SP);
+		return true;
+	}, motion(dropOff, "move away", dropOff->awayTime, [dropOff]() {
+		return dropOff->durations->Move(dropOff->awayDistance, 0);
+	}), dropOff->moveTimeout, { clear });
+
+	int raise = graph->Add("raise", StageAction(), stroke(dropOff, "raise", cleared, 0, dropOff->raiseTime), 0, { clear });
+
+	graph->Add("stop raise", [SP]() {
+		SendCommand(SP, GantryCommand::StopY());
+		return true;
+	}, StageCondition(), 0, { raise });
+
+	//ready for the next run while the gantry is still on its way out
+	if (dropOff->session != NULL) {
+		graph->Add("rearm tracking", [dropOff]() {
+			dropOff->session->SetProfile(PROFILE_RAW_MARKERS);
+			return true;
+		}, StageCondition(), 0, { magnetsOff });
+	}
+
+	if (dropOff->homeSnake) {
+		graph->Add("home snake", [dropOff]() {
+			dropOff->homeSnake();
+			return true;
+		}, StageCondition(), 0, { clear });
+	}
+}
@@ -0,0 +1,145 @@
+/* ************************************************************
+ResetGraph.h
+**************************************************************
+
+The reset between trials as a graph of stages instead of one serial run
+of commands padded with sleeps.
+
+Each stage has a start action, a completion condition polled once it
+has started (elapsed seconds since the start are passed in, so a timed
+stage is just After(seconds)), an optional timeout and the stages it
+waits for. Run starts every stage whose dependencies are complete, each
+on its own thread, so independent stages overlap: the snake's motors
+re-home and tracking switches back to raw markers while the gantry lifts
+and travels away. A stage that fails or times out skips everything that
+depends on it and Run returns false once the rest has finished.
+
+After a run every stage has its start and end time, and the stage that
+gated it (the dependency that finished last). Following those back from
+the stage that ended last gives the critical path, which Report marks.
+
+AddDropOffStages builds the part of the reset from picking the snake up
+over the target to leaving it at the start position of the next trial.
+Given a MoveDuration, its Firgelli stages wait as long as it says (the
+predicted stroke once the Firgelli is measured, the fixed time until
+then) and every wait is recorded against the sleep it replaced.
+*/
+
+#pragma once
+
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include "MagnetSensor.h"
+#include "MotionPlanner.h"
+#include "MoveDuration.h"
+#include "SerialDemux.h"
+#include "TrackingSession.h"
+
+class AsyncLog;
+
+//Returns false if the stage failed
+typedef std::function<bool()> StageAction;
+//Returns true once the stage is complete, given seconds since it started
+typedef std::function<bool(double elapsed)> StageCondition;
+
+enum StageState {
+	STAGE_PENDING,
+	STAGE_RUNNING,
+	STAGE_DONE,
+	STAGE_FAILED,
+	STAGE_SKIPPED
+};
+
+class ResetGraph {
+public:
+	ResetGraph();
+
+	//Stage that starts once every stage in after is done, returns its index.
+	//start or done may be empty; timeout 0 waits for done without limit.
+	int Add(const std::string& name, StageAction start, StageCondition done, double timeout,
+		std::initializer_list<int> after = {});
+
+	//Runs every stage, true if all of them completed
+	bool Run();
+
+	//Stage indices from the first to the one that ended last
+	std::vector<int> CriticalPath() const;
+
+	//s from the start of Run to the end of the last stage
+	double Elapsed() const { return elapsed; }
+	//s the stages would take one after the other
+	double SerialTime() const;
+
+	//Prints the stage timing, critical path marked, and logs the totals
+	void Report(AsyncLog* logger = NULL) const;
+
+	//Completion after a fixed time
+	static StageCondition After(double seconds);
+	//Completion when the gantry answers "wait" with "done moving"
+	static StageCondition Motion(SerialDemux* SP);
+
+	int pollInterval;		// ms between checks of a stage's condition
+
+private:
+	struct Stage {
+		std::string name;
+		StageAction start;
+		StageCondition done;
+		double timeout;
+		std::vector<int> after;
+		StageState state;
+		double begin, end;	// s from the start of Run
+		int gate;			// dependency that finished last, -1 for none
+	};
+
+	bool RunStage(const Stage& stage);
+
+	std::vector<Stage> stages;
+	double elapsed;
+};
+
+/*********************************************************************
+
+Drop-off
+
+*********************************************************************/
+
+struct DropOff {
+	DropOff();
+
+	SerialDemux* SP;
+	MagnetSensor* magnets;
+	TrackingSession* session;
+	MotionPlanner* planner;
+	//predicted waits, NULL for the fixed times below
+	MoveDuration* durations;
+
+	//servo position the snake is carried at so it runs straight
+	int servoAngle;
+	//settled read after the turn, gives the move to the start (machine mm)
+	std::function<bool(float* machineX, float* machineZ)> locateStart;
+	//moves the snake's motors back to their initial position
+	std::function<void()> homeSnake;
+
+	//fixed times, and the longest a predicted wait may take
+	double lowerTime;		// s, Firgelli down onto the snake
+	double retryTime;		// s, second attempt if the magnets found nothing
+	double liftTime;		// s, Firgelli up with the snake before moving
+	double dropTime;		// s, Firgelli down to set the snake on the floor
+	double clearTime;		// s, Firgelli up before the gantry moves away
+	double raiseTime;		// s, Firgelli keeps going up while moving away
+	double awayTime;		// s the move away was given before the next trial
+	float clearance;		// mm the Firgelli rises before the gantry moves away
+	float awayDistance;		// machine X mm the gantry moves off the snake
+	double moveTimeout;		// s for any gantry move
+
+	//filled in by the locate start stage
+	float startX, startZ;
+};
+
+//Magnets on, lower, check contact, lift, turn, go to the start, lower,
+//magnets off, lift and move away; tracking re-armed and the snake
+//re-homed on the way out. dropOff must outlive the run.
+void AddDropOffStages(ResetGraph* graph, DropOff* dropOff);
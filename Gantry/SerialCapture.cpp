@@ -0,0 +1,273 @@
+/* ************************************************************
+SerialCapture.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <cstring>
+#include <iostream>
+#include "SerialCapture.h"
+#include "Trace.h"
+
+using namespace std;
+using namespace std::chrono;
+
+#define CAPTURE_VERSION                 1
+#define CAPTURE_FLUSH_MS                250
+
+//A GRBL status request, sent by the poller's timer
+static bool isStatusRequest(const char* buffer, size_t length)
+{
+	return (length == 1) && (buffer[0] == '?');
+}
+
+static void writeVarint(string& to, uint64_t v)
+{
+	char bytes[10];
+	int n = 0;
+	do {
+		bytes[n] = (char)(v & 0x7f);
+		v >>= 7;
+		if (v != 0) {
+			bytes[n] |= 0x80;
+		}
+		n++;
+	} while (v != 0);
+	to.append(bytes, n);
+}
+
+static bool readVarint(ifstream& file, uint64_t* v)
+{
+	*v = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = file.get();
+		if (c == EOF) {
+			return false;
+		}
+		*v |= (uint64_t)(c & 0x7f) << shift;
+		if ((c & 0x80) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*********************************************************************
+
+CaptureSerialLink
+
+*********************************************************************/
+
+CaptureSerialLink::CaptureSerialLink(SerialLink* link, const char* filename)
+	: link(link), file(filename, ios::binary | ios::trunc), stopping(false)
+{
+	if (!file.is_open()) {
+		cout << "Could not open serial capture " << filename << endl;
+		return;
+	}
+
+	uint16_t version = CAPTURE_VERSION;
+	uint16_t reserved = 0;
+	uint64_t start = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+	file.write("GSCP", 4);
+	file.write((char*)&version, sizeof(version));
+	file.write((char*)&reserved, sizeof(reserved));
+	file.write((char*)&start, sizeof(start));
+
+	file.flush();
+	prev = steady_clock::now();
+	writer = thread(&CaptureSerialLink::Write, this);
+}
+
+CaptureSerialLink::~CaptureSerialLink()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	if (writer.joinable()) {
+		writer.join();
+	}
+	file.close();
+	delete link;
+}
+
+void CaptureSerialLink::Record(uint8_t direction, const char* buffer, unsigned int length)
+{
+	lock_guard<mutex> guard(lock);
+	if (!file.is_open()) {
+		return;
+	}
+
+	steady_clock::time_point now = steady_clock::now();
+	pending.push_back((char)direction);
+	writeVarint(pending, duration_cast<nanoseconds>(now - prev).count());
+	writeVarint(pending, length);
+	pending.append(buffer, length);
+	prev = now;
+}
+
+void CaptureSerialLink::Write()
+{
+	Trace::NameThread("serial capture");
+	string writing;
+	unique_lock<mutex> guard(lock);
+	bool last = false;
+	while (!last) {
+		wake.wait_for(guard, milliseconds(CAPTURE_FLUSH_MS), [this]() { return stopping; });
+		last = stopping;
+		writing.swap(pending);
+		guard.unlock();
+
+		//keep the capture usable if the run is stopped with control + C
+		if (!writing.empty()) {
+			file.write(writing.data(), writing.size());
+			file.flush();
+			writing.clear();
+		}
+		guard.lock();
+	}
+}
+
+int CaptureSerialLink::ReadData(char* buffer, unsigned int nbChar)
+{
+	int read_result = link->ReadData(buffer, nbChar);
+	if (read_result > 0) {
+		Record(CAPTURE_FROM_DEVICE, buffer, read_result);
+	}
+	return read_result;
+}
+
+bool CaptureSerialLink::WriteData(const char* buffer, unsigned int nbChar)
+{
+	Record(CAPTURE_TO_DEVICE, buffer, nbChar);
+	return link->WriteData(buffer, nbChar);
+}
+
+bool CaptureSerialLink::IsConnected()
+{
+	return link->IsConnected();
+}
+
+/*********************************************************************
+
+ReplaySerialLink
+
+*********************************************************************/
+
+ReplaySerialLink::ReplaySerialLink(const char* filename, ReplayMode mode)
+	: mode(mode), loaded(false), nextIn(0), inOffset(0), nextOut(0), writes(0), mismatches(0)
+{
+	ifstream file(filename, ios::binary);
+	char magic[4];
+	uint16_t version, reserved;
+	uint64_t start;
+
+	file.read(magic, 4);
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&reserved, sizeof(reserved));
+	file.read((char*)&start, sizeof(start));
+	if (!file || (memcmp(magic, "GSCP", 4) != 0) || (version != CAPTURE_VERSION)) {
+		cout << "Not a serial capture: " << filename << endl;
+		return;
+	}
+
+	int writesBefore = 0;
+	int64_t sinceWrite = 0;
+	while (true) {
+		int direction = file.get();
+		uint64_t delta, length;
+		if ((direction == EOF) || !readVarint(file, &delta) || !readVarint(file, &length)) {
+			break;
+		}
+
+		Chunk chunk;
+		chunk.direction = (uint8_t)direction;
+		chunk.data.resize(length);
+		if (length > 0) {
+			file.read(&chunk.data[0], length);
+		}
+		if (!file) {
+			break;		// truncated last record
+		}
+
+		sinceWrite += delta;
+		chunk.writesBefore = writesBefore;
+		chunk.sinceWrite = sinceWrite;
+
+		if ((direction == CAPTURE_TO_DEVICE) && isStatusRequest(chunk.data.data(), chunk.data.size())) {
+			continue;
+		}
+		if (direction == CAPTURE_TO_DEVICE) {
+			outbound.push_back(chunk);
+			writesBefore++;
+			sinceWrite = 0;
+		}
+		else {
+			inbound.push_back(chunk);
+		}
+	}
+
+	loaded = true;
+	lastWrite = steady_clock::now();
+	cout << "Replaying " << filename << ": " << inbound.size() << " reads, " << outbound.size() << " writes" << endl;
+}
+
+bool ReplaySerialLink::Due(const Chunk& chunk)
+{
+	if (chunk.writesBefore > writes) {
+		return false;
+	}
+	if ((mode == REPLAY_REALTIME) && (chunk.writesBefore == writes)) {
+		return steady_clock::now() - lastWrite >= nanoseconds(chunk.sinceWrite);
+	}
+	return true;
+}
+
+int ReplaySerialLink::ReadData(char* buffer, unsigned int nbChar)
+{
+	lock_guard<mutex> guard(lock);
+
+	unsigned int count = 0;
+	while ((count < nbChar) && (nextIn < inbound.size()) && Due(inbound[nextIn])) {
+		const string& data = inbound[nextIn].data;
+		size_t n = data.size() - inOffset;
+		if (n > nbChar - count) {
+			n = nbChar - count;
+		}
+		memcpy(buffer + count, data.data() + inOffset, n);
+		count += (unsigned int)n;
+		inOffset += n;
+		if (inOffset == data.size()) {
+			nextIn++;
+			inOffset = 0;
+		}
+	}
+	return count;
+}
+
+bool ReplaySerialLink::WriteData(const char* buffer, unsigned int nbChar)
+{
+	lock_guard<mutex> guard(lock);
+
+	if (isStatusRequest(buffer, nbChar)) {
+		return true;
+	}
+	if ((nextOut >= outbound.size()) || (outbound[nextOut].data.compare(0, string::npos, buffer, nbChar) != 0)) {
+		mismatches++;
+	}
+	if (nextOut < outbound.size()) {
+		nextOut++;
+	}
+	writes++;
+	lastWrite = steady_clock::now();
+	return true;
+}
+
+bool ReplaySerialLink::IsConnected()
+{
+	lock_guard<mutex> guard(lock);
+	return loaded && (nextIn < inbound.size());
+}
@@ -0,0 +1,114 @@
+/* ************************************************************
+SerialCapture.h
+**************************************************************
+
+Record / replay of the Arduino serial stream.
+
+CaptureSerialLink sits in front of another link and appends every chunk
+read or written to a binary capture file. Chunks are only copied into a
+buffer on the calling thread; a writer thread of its own puts the buffer
+in the file and flushes it every CAPTURE_FLUSH_MS, so a run stopped with
+control + C loses at most that much of the capture. ReplaySerialLink plays such a
+file back in place of the COM port so the contact state machine and the
+gantry sequence can be rerun on a machine without the rig.
+
+Capture file layout (little endian):
+
+	header:	"GSCP"  uint16 version  uint16 reserved  uint64 start time (ns, system clock)
+	record:	uint8 direction (0 = from Arduino, 1 = to Arduino)
+			varint time since previous record (ns)
+			varint length
+			length bytes
+
+Replay is causal: a chunk that was received after the Nth write is only
+handed out once the app has made N writes. GRBL status requests (a lone
+'?', see GrblStatus.h) are sent on a timer rather than by the control
+sequence, so they are left out of the write count on both sides and are
+not matched against the capture. In REPLAY_REALTIME mode it is
+also held back by the delay that followed that write in the capture; in
+REPLAY_FAST mode it is released immediately.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SerialLink.h"
+
+#define CAPTURE_FROM_DEVICE             0
+#define CAPTURE_TO_DEVICE               1
+
+class CaptureSerialLink : public SerialLink {
+public:
+	//Takes ownership of link
+	CaptureSerialLink(SerialLink* link, const char* filename);
+	~CaptureSerialLink();
+
+	int ReadData(char* buffer, unsigned int nbChar);
+	bool WriteData(const char* buffer, unsigned int nbChar);
+	bool IsConnected();
+
+	bool IsRecording() { return file.is_open(); }
+
+private:
+	void Record(uint8_t direction, const char* buffer, unsigned int length);
+	void Write();
+
+	SerialLink* link;
+	std::ofstream file;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::string pending;		// records not yet in the file
+	bool stopping;
+	std::chrono::steady_clock::time_point prev;
+	std::thread writer;
+};
+
+enum ReplayMode {
+	REPLAY_REALTIME,
+	REPLAY_FAST
+};
+
+class ReplaySerialLink : public SerialLink {
+public:
+	ReplaySerialLink(const char* filename, ReplayMode mode);
+
+	int ReadData(char* buffer, unsigned int nbChar);
+	bool WriteData(const char* buffer, unsigned int nbChar);
+
+	//False once every captured chunk has been delivered
+	bool IsConnected();
+
+	bool IsLoaded() { return loaded; }
+
+	//Writes that did not match the capture (the app diverged from the recording)
+	int Mismatches() { return mismatches; }
+
+private:
+	struct Chunk {
+		uint8_t direction;
+		int writesBefore;		// writes recorded before this chunk
+		int64_t sinceWrite;		// ns since the last write (or start)
+		std::string data;
+	};
+
+	bool Due(const Chunk& chunk);
+
+	ReplayMode mode;
+	bool loaded;
+	std::vector<Chunk> inbound;
+	std::vector<Chunk> outbound;
+	size_t nextIn;
+	size_t inOffset;			// bytes of inbound[nextIn] already delivered
+	size_t nextOut;
+	int writes;
+	int mismatches;
+	std::chrono::steady_clock::time_point lastWrite;
+	std::mutex lock;
+};
@@ -0,0 +1,177 @@
+/* ************************************************************
+SerialDemux.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <cstring>
+#include "SerialDemux.h"
+#include "Trace.h"
+
+using namespace std;
+
+#define DEMUX_READ_LENGTH               255
+#define DEMUX_IDLE_MS                   1
+
+SerialDemux::SerialDemux(SerialLink* link)
+	: link(link), running(true), connected(true)
+{
+	for (int i = 0; i < MESSAGE_TYPES; i++) {
+		mailbox[i].dropped = 0;
+	}
+	reader = thread(&SerialDemux::Reader, this);
+}
+
+SerialDemux::~SerialDemux()
+{
+	running = false;
+	reader.join();
+	delete link;
+}
+
+//Four 0/1 characters
+static bool isContact(const string& line)
+{
+	return (line.size() == 4) && (line.find_first_not_of("01") == string::npos);
+}
+
+//A float as Serial.println prints it, which always has its decimal
+//point; a contact state never does, so no line is both
+static bool isMagnet(const string& line)
+{
+	return (line.find('.') != string::npos) && (line.find_first_not_of("0123456789.-+ ") == string::npos) &&
+		(line.find_first_of("0123456789") != string::npos);
+}
+
+MessageType SerialDemux::Classify(const string& line)
+{
+	if (isContact(line)) {
+		return MESSAGE_CONTACT;
+	}
+	if (isMagnet(line)) {
+		return MESSAGE_MAGNET;
+	}
+	if (!line.empty() && (line[0] == '<') && (line.back() == '>')) {
+		return MESSAGE_STATUS;
+	}
+	if (line.compare(0, 11, "done moving") == 0) {
+		return MESSAGE_MOTION;
+	}
+	return MESSAGE_OTHER;
+}
+
+void SerialDemux::Deliver(const string& line)
+{
+	Trace::Instant("serial in", line.c_str());
+	Mailbox& box = mailbox[Classify(line)];
+	{
+		lock_guard<mutex> guard(box.lock);
+		if (box.messages.size() >= DEMUX_MAILBOX_SIZE) {
+			box.messages.pop_front();
+			box.dropped++;
+		}
+		box.messages.push_back(line);
+	}
+	box.arrived.notify_all();
+}
+
+void SerialDemux::Reader()
+{
+	char incoming[DEMUX_READ_LENGTH];
+	string line;
+	Trace::NameThread("serial reader");
+
+	while (running) {
+		if (!link->IsConnected()) {
+			connected = false;
+			break;
+		}
+
+		int read_result = link->ReadData(incoming, DEMUX_READ_LENGTH);
+		if (read_result <= 0) {
+			this_thread::sleep_for(chrono::milliseconds(DEMUX_IDLE_MS));
+			continue;
+		}
+
+		for (int i = 0; i < read_result; i++) {
+			char c = incoming[i];
+			if ((c == '\n') || (c == '\r') || (c == '\0')) {
+				if (!line.empty()) {
+					Deliver(line);
+					line.clear();
+				}
+			}
+			else {
+				line.push_back(c);
+			}
+		}
+	}
+
+	//wake anyone still waiting so they can see the link is gone
+	for (int i = 0; i < MESSAGE_TYPES; i++) {
+		lock_guard<mutex> guard(mailbox[i].lock);
+		mailbox[i].arrived.notify_all();
+	}
+}
+
+bool SerialDemux::Wait(MessageType type, string* message, int timeout)
+{
+	Mailbox& box = mailbox[type];
+	unique_lock<mutex> guard(box.lock);
+	box.arrived.wait_for(guard, chrono::milliseconds(timeout), [&] { return !box.messages.empty() || !connected; });
+	if (box.messages.empty()) {
+		return false;
+	}
+	*message = box.messages.front();
+	box.messages.pop_front();
+	return true;
+}
+
+bool SerialDemux::WaitLatest(MessageType type, string* message, int timeout)
+{
+	Mailbox& box = mailbox[type];
+	unique_lock<mutex> guard(box.lock);
+	box.arrived.wait_for(guard, chrono::milliseconds(timeout), [&] { return !box.messages.empty() || !connected; });
+	if (box.messages.empty()) {
+		return false;
+	}
+	*message = box.messages.back();
+	box.messages.clear();
+	return true;
+}
+
+void SerialDemux::Flush(MessageType type)
+{
+	lock_guard<mutex> guard(mailbox[type].lock);
+	mailbox[type].messages.clear();
+}
+
+int SerialDemux::Dropped(MessageType type)
+{
+	lock_guard<mutex> guard(mailbox[type].lock);
+	return mailbox[type].dropped;
+}
+
+int SerialDemux::ReadData(char* buffer, unsigned int nbChar)
+{
+	string message;
+	if ((nbChar == 0) || !Wait(MESSAGE_OTHER, &message, 0)) {
+		return 0;
+	}
+	unsigned int n = (message.size() < nbChar - 1) ? (unsigned int)message.size() : nbChar - 1;
+	memcpy(buffer, message.data(), n);
+	buffer[n] = '\0';
+	return n;
+}
+
+bool SerialDemux::WriteData(const char* buffer, unsigned int nbChar)
+{
+	lock_guard<mutex> guard(writeLock);
+	return link->WriteData(buffer, nbChar);
+}
+
+bool SerialDemux::IsConnected()
+{
+	return connected;
+}
@@ -0,0 +1,85 @@
+/* ************************************************************
+SerialDemux.h
+**************************************************************
+
+Single reader for the Arduino link.
+
+A background thread owns every ReadData call. Incoming bytes are split
+into lines and each line is sorted by type into its own mailbox, so a
+wait loop for "done moving" can no longer swallow a contact state and
+the magnet check no longer needs flush reads beforehand.
+
+	MESSAGE_CONTACT		four 0/1 characters, reply to "data"
+	MESSAGE_MOTION		"done moving", reply to "wait"
+	MESSAGE_MAGNET		a number with a decimal point, reply to "maga" / "magb"
+	MESSAGE_STATUS		"<...>", GRBL status report, reply to '?'
+	MESSAGE_OTHER		anything else (still readable through ReadData)
+
+Writes go straight through to the link.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "SerialLink.h"
+
+enum MessageType {
+	MESSAGE_CONTACT,
+	MESSAGE_MOTION,
+	MESSAGE_MAGNET,
+	MESSAGE_STATUS,
+	MESSAGE_OTHER,
+	MESSAGE_TYPES
+};
+
+#define DEMUX_MAILBOX_SIZE              64
+
+class SerialDemux : public SerialLink {
+public:
+	//Takes ownership of link and starts the reader thread
+	SerialDemux(SerialLink* link);
+	~SerialDemux();
+
+	//Oldest message of this type, waits up to timeout ms
+	bool Wait(MessageType type, std::string* message, int timeout);
+
+	//Newest message of this type (older ones are dropped), waits up to timeout ms
+	bool WaitLatest(MessageType type, std::string* message, int timeout);
+
+	//Drop everything queued for this type
+	void Flush(MessageType type);
+
+	//Messages dropped because a mailbox was full
+	int Dropped(MessageType type);
+
+	static MessageType Classify(const std::string& line);
+
+	//SerialLink: ReadData hands out MESSAGE_OTHER lines
+	int ReadData(char* buffer, unsigned int nbChar);
+	bool WriteData(const char* buffer, unsigned int nbChar);
+	bool IsConnected();
+
+private:
+	struct Mailbox {
+		std::mutex lock;
+		std::condition_variable arrived;
+		std::deque<std::string> messages;
+		int dropped;
+	};
+
+	void Reader();
+	void Deliver(const std::string& line);
+
+	SerialLink* link;
+	Mailbox mailbox[MESSAGE_TYPES];
+	std::mutex writeLock;
+	std::atomic<bool> running;
+	std::atomic<bool> connected;
+	std::thread reader;
+};
@@ -0,0 +1,43 @@
+/* ************************************************************
+SerialLink.h
+**************************************************************
+
+Byte stream to the gantry Arduino.
+
+The app talks to the Arduino only through ReadData / WriteData /
+IsConnected, so anything that can play that part (the real COM port, a
+capture wrapper or a replayed capture) implements SerialLink.
+*/
+
+#pragma once
+
+#include "SerialClass.h"
+
+class SerialLink {
+public:
+	virtual ~SerialLink() {}
+
+	//Returns the number of bytes read, 0 if nothing is waiting
+	virtual int ReadData(char* buffer, unsigned int nbChar) = 0;
+	virtual bool WriteData(const char* buffer, unsigned int nbChar) = 0;
+	virtual bool IsConnected() = 0;
+};
+
+/*********************************************************************
+
+HardwareSerialLink: the Arduino COM port (owns the Serial object)
+
+*********************************************************************/
+
+class HardwareSerialLink : public SerialLink {
+public:
+	HardwareSerialLink(const char* portName) : port(new Serial(portName)) {}
+	~HardwareSerialLink() { delete port; }
+
+	int ReadData(char* buffer, unsigned int nbChar) { return port->ReadData(buffer, nbChar); }
+	bool WriteData(const char* buffer, unsigned int nbChar) { return port->WriteData((char*)buffer, nbChar); }
+	bool IsConnected() { return port->IsConnected(); }
+
+private:
+	Serial* port;
+};
@@ -0,0 +1,431 @@
+/* ************************************************************
+SimulatedDevices.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#define _USE_MATH_DEFINES
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "SimulatedDevices.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*********************************************************************
+
+SimulatedArduino
+
+*********************************************************************/
+
+SimulatedArduino::SimulatedArduino()
+	: feedRate(GantrySettings().travelSpeed), acceleration(GantrySettings().travelAcceleration), servoSpeed(400), firgelliTime(8), magnetFree(2.0f), magnetContact(1.3f), magnetNoise(0.01f), hangAfter(-1), jogging(false),
+	commands(0), contactState("0000"), x(0), z(0), fromX(0), fromZ(0), moveRamp(0), servo(120), servoFrom(120), magnets(false),
+	firgelli(0), firgelliFrom(0), chatterRate(0), chatterCount(0), random(1)
+{
+	moveStart = Clock::now();
+	moveEnd = moveStart;
+	servoStart = moveStart;
+	firgelliStart = moveStart;
+	lastChatter = moveStart;
+}
+
+void SimulatedArduino::SetContactState(const char* state)
+{
+	lock_guard<mutex> guard(lock);
+	contactState = state;
+}
+
+void SimulatedArduino::SetChatter(double rate)
+{
+	lock_guard<mutex> guard(lock);
+	chatterRate = rate;
+	lastChatter = Clock::now();
+}
+
+void SimulatedArduino::Position(float* px, float* pz)
+{
+	lock_guard<mutex> guard(lock);
+	CurrentPosition(Clock::now(), px, pz);
+}
+
+float SimulatedArduino::Servo()
+{
+	lock_guard<mutex> guard(lock);
+	return ServoPosition(Clock::now());
+}
+
+float SimulatedArduino::Firgelli()
+{
+	lock_guard<mutex> guard(lock);
+	return Extension(Clock::now());
+}
+
+float SimulatedArduino::ServoPosition(Clock::time_point now)
+{
+	float step = servoSpeed * duration<float>(now - servoStart).count();
+	if (step >= fabs(servo - servoFrom)) {
+		return (float)servo;
+	}
+	return servoFrom + ((servo > servoFrom) ? step : -step);
+}
+
+//Fraction of a move done t seconds into it, accelerating for the first
+//and decelerating for the last ramp seconds
+static float rampFraction(float t, float total, float ramp)
+{
+	if (ramp <= 0) {
+		return t / total;
+	}
+	float peak = 1 / (total - ramp);
+	if (t < ramp) {
+		return 0.5f * peak / ramp * t * t;
+	}
+	if (t > total - ramp) {
+		return 1 - 0.5f * peak / ramp * (total - t) * (total - t);
+	}
+	return peak * (t - ramp / 2);
+}
+
+void SimulatedArduino::CurrentPosition(Clock::time_point now, float* px, float* pz)
+{
+	//queued jog increments start as soon as the previous move ends
+	while ((now >= moveEnd) && !jogs.empty()) {
+		Jog jog = jogs.front();
+		jogs.pop_front();
+		fromX = x;
+		fromZ = z;
+		x += jog.dx;
+		z += jog.dz;
+		moveStart = moveEnd;
+		moveRamp = 0;
+		moveEnd = moveStart + duration_cast<Clock::duration>(duration<float>(sqrt(jog.dx * jog.dx + jog.dz * jog.dz) / jog.speed));
+	}
+
+	if (now >= moveEnd) {
+		*px = x;
+		*pz = z;
+		return;
+	}
+	float f = rampFraction(duration<float>(now - moveStart).count(), duration<float>(moveEnd - moveStart).count(), moveRamp);
+	*px = fromX + (x - fromX) * f;
+	*pz = fromZ + (z - fromZ) * f;
+}
+
+bool SimulatedArduino::Moving()
+{
+	lock_guard<mutex> guard(lock);
+	float px, pz;
+	Clock::time_point now = Clock::now();
+	CurrentPosition(now, &px, &pz);
+	return now < moveEnd;
+}
+
+float SimulatedArduino::Extension(Clock::time_point now)
+{
+	float e = firgelliFrom + firgelli * duration<float>(now - firgelliStart).count() / firgelliTime;
+	return min(1.0f, max(0.0f, e));
+}
+
+void SimulatedArduino::Send(const string& text, Clock::time_point due)
+{
+	Reply reply;
+	reply.due = due;
+	reply.text = text + "\r\n";
+	pending.push_back(reply);
+}
+
+void SimulatedArduino::Command(const string& command)
+{
+	Clock::time_point now = Clock::now();
+	commands++;
+
+	if ((command.compare(0, 5, "moveX") == 0) || (command.compare(0, 5, "moveZ") == 0)) {
+		float dx = 0, dz = 0;
+		const char* p = command.c_str() + 4;
+		while (true) {
+			char axis = *p;
+			char* end;
+			float v = strtof(p + 1, &end);
+			if (axis == 'X') dx = v;
+			if (axis == 'Z') dz = v;
+			if (*end != ',') break;
+			p = end + 1;
+		}
+		CurrentPosition(now, &fromX, &fromZ);
+		x = fromX + dx;
+		z = fromZ + dz;
+		moveStart = now;
+
+		//trapezoid, or a triangle if the move is too short to reach feedRate
+		float d = sqrt(dx * dx + dz * dz);
+		float seconds = d / feedRate;
+		moveRamp = 0;
+		if (acceleration > 0) {
+			moveRamp = feedRate / acceleration;
+			if (d >= feedRate * moveRamp) {
+				seconds += moveRamp;
+			}
+			else {
+				moveRamp = sqrt(d / acceleration);
+				seconds = 2 * moveRamp;
+			}
+		}
+		moveEnd = now + duration_cast<Clock::duration>(duration<float>(seconds));
+	}
+	else if (jogging && (command.compare(0, 4, "jogZ") == 0)) {
+		Jog jog = { 0, 0, feedRate };
+		const char* p = command.c_str() + 3;
+		while (true) {
+			char axis = *p;
+			char* end;
+			float v = strtof(p + 1, &end);
+			if (axis == 'X') jog.dx = v;
+			if (axis == 'Z') jog.dz = v;
+			if ((axis == 'F') && (v > 0)) jog.speed = v / 60;
+			if (*end != ',') break;
+			p = end + 1;
+		}
+		if (now >= moveEnd) {
+			float px, pz;
+			CurrentPosition(now, &px, &pz);
+			moveEnd = now;
+		}
+		jogs.push_back(jog);
+	}
+	else if (jogging && (command == "jstp")) {
+		//GRBL decelerates; close enough to stop where it is
+		float px, pz;
+		CurrentPosition(now, &px, &pz);
+		jogs.clear();
+		x = fromX = px;
+		z = fromZ = pz;
+		moveEnd = now;
+	}
+	else if (command.compare(0, 4, "rots") == 0) {
+		servoFrom = ServoPosition(now);
+		servoStart = now;
+		servo = atoi(command.c_str() + 4);
+	}
+	else if (command == "mgon") {
+		magnets = true;
+	}
+	else if (command == "mgof") {
+		magnets = false;
+	}
+	else if ((command == "yneg") || (command == "ypos") || (command == "ystp")) {
+		firgelliFrom = Extension(now);
+		firgelliStart = now;
+		firgelli = (command == "yneg") ? 1 : (command == "ypos") ? -1 : 0;
+	}
+	else if (command == "stop") {
+		moveEnd = now;
+	}
+	else if (command == "data") {
+		Send(contactState, now + milliseconds(2));
+	}
+	else if ((command == "maga") || (command == "magb")) {
+		normal_distribution<float> noise(0, magnetNoise);
+		bool holding = magnets && (Extension(now) >= 1.0f);
+		char reading[16];
+		snprintf(reading, sizeof(reading), "%.3f", (holding ? magnetContact : magnetFree) + noise(random));
+		Send(reading, now + milliseconds(2));
+	}
+	else if (command == "wait") {
+		Clock::time_point end = moveEnd;
+		for (size_t i = 0; i < jogs.size(); i++) {
+			end += duration_cast<Clock::duration>(duration<float>(sqrt(jogs[i].dx * jogs[i].dx + jogs[i].dz * jogs[i].dz) / jogs[i].speed));
+		}
+		Send("done moving", max(now, end) + milliseconds(5));
+	}
+}
+
+bool SimulatedArduino::WriteData(const char* buffer, unsigned int nbChar)
+{
+	lock_guard<mutex> guard(lock);
+	Clock::time_point now = Clock::now();
+
+	//a hung board takes the bytes and never answers
+	if ((hangAfter >= 0) && (commands >= hangAfter)) {
+		return true;
+	}
+
+	//'?' is a real-time GRBL command, answered wherever it appears
+	for (unsigned int i = 0; i < nbChar; i++) {
+		if (buffer[i] == '?') {
+			float px, pz;
+			CurrentPosition(now, &px, &pz);
+			bool moving = now < moveEnd;
+			char report[96];
+			snprintf(report, sizeof(report), "<%s|MPos:%.3f,0.000,%.3f|FS:%d,0>", moving ? "Run" : "Idle", px, pz, moving ? (int)(feedRate * 60) : 0);
+			Send(report, now + milliseconds(1));
+		}
+		else {
+			input.push_back(buffer[i]);
+		}
+	}
+
+	while (!input.empty()) {
+		//"wait" is sent without a carriage return
+		if (input.compare(0, 4, "wait") == 0) {
+			input.erase(0, 4);
+			Command("wait");
+			continue;
+		}
+		size_t end = input.find('\r');
+		if (end == string::npos) {
+			break;
+		}
+		string command = input.substr(0, end);
+		input.erase(0, end + 1);
+		if (!command.empty()) {
+			Command(command);
+		}
+	}
+	return true;
+}
+
+void SimulatedArduino::Chatter(Clock::time_point now)
+{
+	if (chatterRate <= 0) {
+		return;
+	}
+	int due = (int)(duration<double>(now - lastChatter).count() * chatterRate);
+	for (int i = 0; i < due; i++) {
+		switch (chatterCount++ % 3) {
+		case 0: Send((chatterCount % 2) ? "0100" : "0000", now); break;
+		case 1: Send("1.900", now); break;
+		case 2: Send("done moving", now); break;
+		}
+	}
+	if (due > 0) {
+		lastChatter = now;
+	}
+}
+
+int SimulatedArduino::ReadData(char* buffer, unsigned int nbChar)
+{
+	lock_guard<mutex> guard(lock);
+	Clock::time_point now = Clock::now();
+
+	Chatter(now);
+	for (size_t i = 0; i < pending.size();) {
+		if (pending[i].due <= now) {
+			output += pending[i].text;
+			pending.erase(pending.begin() + i);
+		}
+		else {
+			i++;
+		}
+	}
+
+	unsigned int n = (unsigned int)min<size_t>(nbChar, output.size());
+	memcpy(buffer, output.data(), n);
+	output.erase(0, n);
+	return n;
+}
+
+/*********************************************************************
+
+SimulatedTracking
+
+*********************************************************************/
+
+SimulatedTracking::SimulatedTracking(SimulatedArduino* gantry)
+	: frameRate(120), markers(14), spacing(0.05f), speed(0.05f), amplitude(0.03f),
+	wavelength(0.5f), frequency(0.5f), noise(0.0005f), gantry(gantry), frame(0), random(2)
+{
+	start = Clock::now();
+	for (int i = 0; i < rigidBodies; i++) {
+		enabled[i] = true;
+	}
+}
+
+bool SimulatedTracking::Initialize()
+{
+	start = Clock::now();
+	frame = 0;
+	return true;
+}
+
+bool SimulatedTracking::Update()
+{
+	frame = (long long)(duration<double>(Clock::now() - start).count() * frameRate);
+	return true;
+}
+
+double SimulatedTracking::FrameTimeStamp()
+{
+	return frame / frameRate;
+}
+
+void SimulatedTracking::FrameMarkers(float* x, float* y, float* z, int count)
+{
+	//Head at the front, moving along +x, wave in z
+	float t = (float)FrameTimeStamp();
+	float k = 2 * (float)M_PI / wavelength;
+	float w = 2 * (float)M_PI * frequency;
+	normal_distribution<float> jitter(0, noise);
+
+	for (int i = 0; i < count; i++) {
+		float s = speed * t - i * spacing;
+		x[i] = s + jitter(random);
+		y[i] = 0.02f + jitter(random);
+		z[i] = amplitude * sin(k * s - w * t) + jitter(random);
+	}
+}
+
+void SimulatedTracking::RigidBodyLocation(int index, RigidBodyPose* pose)
+{
+	*pose = RigidBodyPose();
+	pose->qw = 1;
+
+	switch (index) {
+	case 0:
+		//gantry head, machine mm to tracking m through the rails' frame
+		if (gantry != NULL) {
+			float gx, gz;
+			gantry->Position(&gx, &gz);
+			gantryFrame.ToTracking(gx, gz, &pose->x, &pose->z);
+			pose->x += (float)gantryFrame.origin[0];
+			pose->z += (float)gantryFrame.origin[1];
+		}
+		pose->y = 0.3f;
+		break;
+	case 1:
+		pose->x = 0.4f;
+		pose->z = 0.1f;
+		break;
+	case 2:
+		pose->x = 0.4f;
+		pose->z = -0.1f;
+		break;
+	}
+
+	normal_distribution<float> jitter(0, noise);
+	pose->x += jitter(random);
+	pose->y += jitter(random);
+	pose->z += jitter(random);
+}
+
+bool SimulatedTracking::IsRigidBodyTracked(int index)
+{
+	return (index >= 0) && (index < rigidBodies) && enabled[index];
+}
+
+bool SimulatedTracking::RigidBodyEnabled(int index)
+{
+	return (index >= 0) && (index < rigidBodies) && enabled[index];
+}
+
+void SimulatedTracking::SetRigidBodyEnabled(int index, bool enable)
+{
+	if ((index >= 0) && (index < rigidBodies)) {
+		enabled[index] = enable;
+	}
+}
@@ -0,0 +1,164 @@
+/* ************************************************************
+SimulatedDevices.h
+**************************************************************
+
+Stand-ins for the rig hardware so the app can run without it.
+
+SimulatedArduino plays the part of GantryControl.ino on the serial link.
+It answers the commands the app sends (see GantryCommand.h) with the same
+replies as the real firmware, with simulated travel times:
+
+	data			contact state, e.g. "0100"
+	maga / magb		magnet reading in volts, low once the magnets are on
+					and the Firgelli is down
+	wait			"done moving" once the current move has finished
+	?				GRBL status report, e.g. "<Run|MPos:10.000,0.000,-4.000|FS:25,0>"
+
+Optional chatter interleaves unsolicited contact, magnet and motion lines
+at a fixed rate so consumers of the serial demultiplexer can be exercised
+under load. It is off by default since a stray "done moving" would end a
+real wait early. hangAfter makes the board stop answering after a number
+of commands, the way a hung or unplugged Arduino does, to exercise what
+happens when a batch loses the gantry partway. jogZ and jstp are ignored
+unless jogging is set, as GantryControl.ino does not pass them to GRBL
+yet.
+
+SimulatedTracking stands in for Motive. It produces frames at a fixed
+camera rate with a row of markers along a snake that slithers forward
+with a travelling wave, plus rigid bodies for the gantry (following a
+SimulatedArduino if one is given) and the two contacts.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "ExperimentPlan.h"
+#include "GantryCalibration.h"
+#include "SerialLink.h"
+#include "TrackingBackend.h"
+
+class SimulatedArduino : public SerialLink {
+public:
+	SimulatedArduino();
+
+	int ReadData(char* buffer, unsigned int nbChar);
+	bool WriteData(const char* buffer, unsigned int nbChar);
+	bool IsConnected() { return true; }
+
+	//Contact state returned for "data"
+	void SetContactState(const char* state);
+
+	//Unsolicited lines per second (0 = off)
+	void SetChatter(double rate);
+
+	//Machine position in mm
+	void Position(float* x, float* z);
+	bool Moving();
+
+	//End effector servo position, following the last rots at servoSpeed
+	float Servo();
+	//Firgelli extension, 0 fully up to 1 fully down
+	float Firgelli();
+
+	float feedRate;			// gantry travel speed, mm/s
+	float acceleration;		// mm/s^2 for move commands, 0 reaches feedRate at once
+	float servoSpeed;		// servo positions per second
+	float firgelliTime;		// seconds for a full Firgelli stroke
+	float magnetFree;		// magnet reading with nothing attached, V
+	float magnetContact;	// magnet reading holding the snake, V
+	float magnetNoise;		// std deviation of the magnet reading, V
+	int hangAfter;			// commands answered before the board stops answering, -1 never
+	bool jogging;			// pass jogZ and jstp to GRBL, which the rig's sketch doesn't yet
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Reply {
+		Clock::time_point due;
+		std::string text;
+	};
+
+	struct Jog {
+		float dx, dz;
+		float speed;		// mm/s
+	};
+
+	void Command(const std::string& command);
+	void Send(const std::string& text, Clock::time_point due);
+	void Chatter(Clock::time_point now);
+	float Extension(Clock::time_point now);
+	float ServoPosition(Clock::time_point now);
+	void CurrentPosition(Clock::time_point now, float* px, float* pz);
+
+	std::mutex lock;
+	std::string input;
+	std::string output;
+	std::vector<Reply> pending;
+
+	int commands;			// commands received
+	std::string contactState;
+	float x, z;
+	float fromX, fromZ;
+	Clock::time_point moveStart;
+	Clock::time_point moveEnd;
+	float moveRamp;			// s spent accelerating and again decelerating, 0 for jogs
+	std::deque<Jog> jogs;	// queued behind the current move
+	int servo;
+	float servoFrom;
+	Clock::time_point servoStart;
+	bool magnets;
+	int firgelli;			// 1 lowering, -1 raising, 0 stopped
+	float firgelliFrom;		// extension when the last y command was sent, 0 (up) to 1 (down)
+	Clock::time_point firgelliStart;
+
+	double chatterRate;
+	Clock::time_point lastChatter;
+	int chatterCount;
+	std::mt19937 random;
+};
+
+class SimulatedTracking : public TrackingBackend {
+public:
+	SimulatedTracking(SimulatedArduino* gantry = NULL);
+
+	bool Initialize();
+	bool LoadProject(const char* path) { return true; }
+	void Shutdown() {}
+
+	bool Update();
+	double FrameTimeStamp();
+	int FrameMarkerCount() { return markers; }
+	void FrameMarkers(float* x, float* y, float* z, int count);
+
+	void RigidBodyLocation(int index, RigidBodyPose* pose);
+	bool IsRigidBodyTracked(int index);
+	bool RigidBodyEnabled(int index);
+	void SetRigidBodyEnabled(int index, bool enabled);
+	void FlushCameraQueues() {}
+
+	double frameRate;		// camera frames per second
+	int markers;			// markers along the snake
+	float spacing;			// marker spacing, m
+	float speed;			// forward speed of the snake, m/s
+	float amplitude;		// lateral wave amplitude, m
+	float wavelength;		// m
+	float frequency;		// wave frequency, Hz
+	float noise;			// std deviation of marker positions, m
+	GantryCalibration gantryFrame;	// where the rails really are, nominal unless set
+
+	static const int rigidBodies = 5;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	SimulatedArduino* gantry;
+	Clock::time_point start;
+	long long frame;
+	bool enabled[rigidBodies];
+	std::mt19937 random;
+};
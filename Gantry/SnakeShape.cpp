@@ -0,0 +1,168 @@
+/* ************************************************************
+SnakeShape.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "SnakeShape.h"
+
+using namespace std;
+
+SnakeShapeEstimator::SnakeShapeEstimator()
+	: minMarkers(3), minSpeed(0.005f), velocityTime(0.1f), havePrevious(false), resets(0)
+{
+}
+
+void SnakeShapeEstimator::Reset()
+{
+	havePrevious = false;
+	resets = latest.Count();
+}
+
+bool SnakeShapeEstimator::Latest(SnakeShape* shape) const
+{
+	if (latest.Count() == resets) {
+		return false;
+	}
+	return latest.Load(shape);
+}
+
+//A x = b by Cramer's rule, false if A is (nearly) singular
+static bool solve3(const double A[3][3], const double b[3], double x[3])
+{
+	double det = A[0][0] * (A[1][1] * A[2][2] - A[1][2] * A[2][1])
+		- A[0][1] * (A[1][0] * A[2][2] - A[1][2] * A[2][0])
+		+ A[0][2] * (A[1][0] * A[2][1] - A[1][1] * A[2][0]);
+	double scale = fabs(A[0][0] * A[1][1] * A[2][2]);
+	if (fabs(det) <= 1e-12 * scale) {
+		return false;
+	}
+	for (int c = 0; c < 3; c++) {
+		double M[3][3];
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				M[i][j] = (j == c) ? b[i] : A[i][j];
+			}
+		}
+		x[c] = (M[0][0] * (M[1][1] * M[2][2] - M[1][2] * M[2][1])
+			- M[0][1] * (M[1][0] * M[2][2] - M[1][2] * M[2][0])
+			+ M[0][2] * (M[1][0] * M[2][1] - M[1][1] * M[2][0])) / det;
+	}
+	return true;
+}
+
+bool SnakeShapeEstimator::Update(const MarkerFrame* frame)
+{
+	int n = frame->count;
+	if (n < minMarkers) {
+		return false;
+	}
+
+	SnakeShape shape;
+	shape.time = frame->time;
+	shape.sequence = frame->sequence;
+	shape.markers = n;
+
+	//center of mass
+	double mx = 0, my = 0, mz = 0;
+	for (int i = 0; i < n; i++) {
+		mx += frame->x[i];
+		my += frame->y[i];
+		mz += frame->z[i];
+	}
+	mx /= n;
+	my /= n;
+	mz /= n;
+	shape.x = (float)mx;
+	shape.y = (float)my;
+	shape.z = (float)mz;
+
+	//principal axis in x-z
+	double sxx = 0, sxz = 0, szz = 0;
+	for (int i = 0; i < n; i++) {
+		double dx = frame->x[i] - mx;
+		double dz = frame->z[i] - mz;
+		sxx += dx * dx;
+		sxz += dx * dz;
+		szz += dz * dz;
+	}
+	double angle = 0.5 * atan2(2 * sxz, sxx - szz);
+	double ax = cos(angle), az = sin(angle);
+
+	//center of mass velocity
+	shape.vx = 0;
+	shape.vz = 0;
+	if (havePrevious) {
+		double dt = shape.time - previous.time;
+		shape.vx = previous.vx;
+		shape.vz = previous.vz;
+		if (dt > 0) {
+			double alpha = dt / (velocityTime + dt);
+			shape.vx += (float)(alpha * ((mx - previous.x) / dt - previous.vx));
+			shape.vz += (float)(alpha * ((mz - previous.z) / dt - previous.vz));
+		}
+	}
+
+	//point the axis the way the snake is going
+	double speed = sqrt(shape.vx * shape.vx + shape.vz * shape.vz);
+	if (speed > minSpeed) {
+		if (ax * shape.vx + az * shape.vz < 0) {
+			ax = -ax;
+			az = -az;
+		}
+	}
+	else if (havePrevious) {
+		double px = cos(previous.heading * M_PI / 180), pz = sin(previous.heading * M_PI / 180);
+		if (ax * px + az * pz < 0) {
+			ax = -ax;
+			az = -az;
+		}
+	}
+	shape.heading = (float)(atan2(az, ax) * 180 / M_PI);
+
+	//circle s^2 + w^2 + D s + E w + F = 0 through the markers in body
+	//coordinates, least squares on the algebraic distance
+	double A[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+	double B[3] = { 0, 0, 0 };
+	double smin = 0, smax = 0, w2 = 0;
+	for (int i = 0; i < n; i++) {
+		double dx = frame->x[i] - mx;
+		double dz = frame->z[i] - mz;
+		double s = dx * ax + dz * az;
+		double w = dz * ax - dx * az;
+		double row[3] = { s, w, 1 };
+		double r2 = s * s + w * w;
+		for (int j = 0; j < 3; j++) {
+			for (int k = 0; k < 3; k++) {
+				A[j][k] += row[j] * row[k];
+			}
+			B[j] -= row[j] * r2;
+		}
+		w2 += w * w;
+		smin = min(smin, s);
+		smax = max(smax, s);
+	}
+	shape.length = (float)(smax - smin);
+	shape.width = (float)sqrt(w2 / n);
+
+	//a straight snake gives a huge circle, collinear markers no circle at all
+	double circle[3];
+	shape.curvature = 0;
+	if (solve3(A, B, circle)) {
+		double cs = -circle[0] / 2, cw = -circle[1] / 2;
+		double r2 = cs * cs + cw * cw - circle[2];
+		if (r2 > 0) {
+			shape.curvature = (float)((cw > 0 ? 1 : -1) / sqrt(r2));
+		}
+	}
+
+	previous = shape;
+	havePrevious = true;
+	latest.Store(shape);
+	return true;
+}
@@ -0,0 +1,65 @@
+/* ************************************************************
+SnakeShape.h
+**************************************************************
+
+Online estimate of the snake's pose from one frame of markers, so the
+controller and the logger have center of mass, heading and curvature
+during a run instead of only after the fact.
+
+Everything is in the floor (x-z) plane of the tracking space:
+
+1.	Center of mass is the mean of the visible markers.
+2.	The body axis is the principal axis of the markers (2x2 PCA). Its
+	sign is chosen to point the way the center of mass is moving, or to
+	agree with the last heading while the snake is standing still.
+3.	A circle is fitted to the markers (algebraic least squares, one 3x3
+	solve). One over its radius is the body's mean bend: a full wave
+	gives a huge circle and so a curvature near zero. The RMS lateral
+	offset from the axis measures how wide the wave is.
+
+Marker order does not matter, so the estimate works on raw or labeled
+frames and costs a few microseconds for a snake's worth of markers. The
+estimator runs on the tracking thread and publishes through a
+LatestValue, so any thread can read the newest shape without waiting.
+*/
+
+#pragma once
+
+#include "LatestValue.h"
+#include "MarkerFrame.h"
+
+struct SnakeShape {
+	double time;		// camera time stamp of the frame
+	unsigned sequence;	// frame sequence number
+	int markers;		// markers used
+	float x, y, z;		// center of mass, m
+	float heading;		// deg, body axis in x-z, 0 along +x, 90 along +z
+	float curvature;	// 1/m, of the fitted circle, positive bending toward heading + 90 deg
+	float length;		// m, extent along the body axis
+	float width;		// m, RMS lateral offset from the body axis
+	float vx, vz;		// m/s, smoothed center of mass velocity
+};
+
+class SnakeShapeEstimator {
+public:
+	SnakeShapeEstimator();
+
+	void Reset();
+
+	//Estimates the shape of frame and publishes it; false if there were
+	//too few markers
+	bool Update(const MarkerFrame* frame);
+
+	//Newest shape, false if none has been estimated since Reset
+	bool Latest(SnakeShape* shape) const;
+
+	int minMarkers;		// fewest markers worth estimating from
+	float minSpeed;		// m/s, slower than this the heading keeps its last sign
+	float velocityTime;	// s, time constant of the velocity smoothing
+
+private:
+	LatestValue<SnakeShape> latest;
+	bool havePrevious;
+	SnakeShape previous;
+	unsigned resets;	// count at the last Reset, shapes from before are stale
+};
@@ -0,0 +1,53 @@
+/* ************************************************************
+SpscQueue.h
+**************************************************************
+
+Bounded lock-free queue for exactly one producer thread and one consumer
+thread. SIZE must be a power of two. Push fails instead of blocking when
+the queue is full, Pop fails when it is empty.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t SIZE>
+class SpscQueue {
+	static_assert((SIZE & (SIZE - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+	SpscQueue() : head(0), tail(0) {}
+
+	//Producer thread only
+	bool Push(const T& value) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == SIZE) {
+			return false;
+		}
+		slots[t & (SIZE - 1)] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer thread only
+	bool Pop(T* value) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		*value = slots[h & (SIZE - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t Size() const {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+private:
+	//producer and consumer indices on separate cache lines
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+	alignas(64) T slots[SIZE];
+};
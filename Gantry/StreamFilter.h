@@ -0,0 +1,103 @@
+/* ************************************************************
+StreamFilter.h
+**************************************************************
+
+N-channel streaming filter used for the magnet (hall) readings.
+
+Each channel is an exponential moving average with gain 0.25. After the
+first few warm-up samples, a sample that differs from the filtered value
+by more than 0.3 is rejected as an outlier and the filtered value is held.
+This is the same filter that used to be copied by hand for every magnet
+channel in main().
+
+The filter also keeps a short window of the filtered values so callers
+can ask whether the reading has settled (windowed standard deviation of
+every channel below a tolerance) instead of sampling a fixed number of
+times.
+*/
+
+#pragma once
+
+#include <cmath>
+
+template <int N, int WINDOW = 5>
+class StreamFilter {
+public:
+
+	StreamFilter(float gain = 0.25f, float reject = 0.3f, int warmup = 4)
+		: gain(gain), reject(reject), warmup(warmup)
+	{
+		Reset();
+	}
+
+	void Reset() {
+		count = 0;
+		head = 0;
+		for (int c = 0; c < N; c++) {
+			value[c] = 0;
+			for (int w = 0; w < WINDOW; w++) {
+				history[c][w] = 0;
+			}
+		}
+	}
+
+	//Feed one sample per channel
+	void Update(const float* samples) {
+		for (int c = 0; c < N; c++) {
+			if (count == 0) {
+				value[c] = samples[c];
+			}
+			if ((count < warmup) || (std::abs(samples[c] - value[c]) < reject)) {
+				value[c] += (samples[c] - value[c]) * gain;
+			}//else it stays the same as before
+			history[c][head] = value[c];
+		}
+		head = (head + 1) % WINDOW;
+		count++;
+	}
+
+	float Value(int channel) const { return value[channel]; }
+
+	int Count() const { return count; }
+
+	//Standard deviation of the last WINDOW filtered values of a channel
+	float Spread(int channel) const {
+		int n = (count < WINDOW) ? count : WINDOW;
+		if (n < 2) {
+			return INFINITY;
+		}
+		float mean = 0;
+		for (int w = 0; w < n; w++) {
+			mean += history[channel][w];
+		}
+		mean /= n;
+		float var = 0;
+		for (int w = 0; w < n; w++) {
+			var += (history[channel][w] - mean) * (history[channel][w] - mean);
+		}
+		return std::sqrt(var / (n - 1));
+	}
+
+	//True once the warm-up is over and every channel has stopped moving
+	bool Settled(float tolerance) const {
+		if (count < warmup + WINDOW) {
+			return false;
+		}
+		for (int c = 0; c < N; c++) {
+			if (Spread(c) > tolerance) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	float gain;
+	float reject;
+	int warmup;
+
+	int count;
+	int head;
+	float value[N];
+	float history[N][WINDOW];
+};
@@ -0,0 +1,305 @@
+/* ************************************************************
+Trace.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Trace.h"
+
+using namespace std;
+
+struct TraceChunk {
+	TraceEvent events[TRACE_CHUNK_EVENTS];
+	atomic<int> count;		// events written, published to Export
+	unsigned generation;	// trace the chunk belongs to
+	int thread;
+	char name[TRACE_NAME_LENGTH];	// of the thread, under poolLock
+	bool spare;				// back in the pool
+};
+
+struct TraceThread {
+	int id;
+	char name[TRACE_NAME_LENGTH];
+	TraceChunk* chunk;		// being written
+	unsigned generation;	// trace chunk was taken for
+};
+
+//Hands the thread's entry back when the thread exits, so a thread per
+//reset stage does not leave an entry behind for every stage it ran
+struct TraceThreadHandle {
+	TraceThread* thread;
+
+	TraceThreadHandle() : thread(NULL) {}
+	~TraceThreadHandle();
+};
+
+static atomic<bool> recording(false);
+static atomic<unsigned> generation(0);
+static atomic<uint64_t> dropped(0);
+static atomic<int64_t> epoch(0);
+
+//chunk pool and the entries of threads that have exited, only touched
+//under poolLock
+static mutex poolLock;
+static vector<TraceChunk*> chunks;
+static vector<TraceChunk*> spareChunks;
+static vector<TraceThread*> spareThreads;
+static int threadIds = 0;
+
+static thread_local TraceThreadHandle self;
+
+static int64_t traceNow()
+{
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Copies up to length - 1 characters and terminates
+static void copyText(char* to, const char* from, int length)
+{
+	int i = 0;
+	if (from != NULL) {
+		for (; (i < length - 1) && (from[i] != '\0'); i++) {
+			to[i] = from[i];
+		}
+	}
+	to[i] = '\0';
+}
+
+static TraceThread* joinTrace()
+{
+	lock_guard<mutex> guard(poolLock);
+	TraceThread* thread;
+	if (!spareThreads.empty()) {
+		thread = spareThreads.back();
+		spareThreads.pop_back();
+	}
+	else {
+		thread = new TraceThread();
+	}
+	//a new id even for a reused entry, so events from the thread before stay its own
+	thread->id = ++threadIds;
+	snprintf(thread->name, sizeof(thread->name), "thread %d", thread->id);
+	thread->chunk = NULL;
+	thread->generation = 0;
+	self.thread = thread;
+	return thread;
+}
+
+TraceThreadHandle::~TraceThreadHandle()
+{
+	if (thread == NULL) {
+		return;
+	}
+	//the chunk stays with its trace until Start hands it back to the pool
+	lock_guard<mutex> guard(poolLock);
+	thread->chunk = NULL;
+	spareThreads.push_back(thread);
+	thread = NULL;
+}
+
+static TraceChunk* takeChunk(TraceThread* thread, unsigned current)
+{
+	lock_guard<mutex> guard(poolLock);
+	thread->generation = current;
+	TraceChunk* chunk = NULL;
+	if (!spareChunks.empty()) {
+		chunk = spareChunks.back();
+		spareChunks.pop_back();
+	}
+	else if (chunks.size() < TRACE_MAX_CHUNKS) {
+		chunk = new TraceChunk();
+		chunks.push_back(chunk);
+	}
+	if (chunk != NULL) {
+		chunk->count.store(0, memory_order_relaxed);
+		chunk->generation = current;
+		chunk->thread = thread->id;
+		copyText(chunk->name, thread->name, TRACE_NAME_LENGTH);
+		chunk->spare = false;
+	}
+	return chunk;
+}
+
+static void record(char phase, const char* name, const char* detail)
+{
+	if (!recording.load(memory_order_relaxed)) {
+		return;
+	}
+	TraceThread* thread = (self.thread != NULL) ? self.thread : joinTrace();
+	unsigned current = generation.load(memory_order_acquire);
+	TraceChunk* chunk = thread->chunk;
+	if ((chunk == NULL) || (thread->generation != current) || (chunk->count.load(memory_order_relaxed) == TRACE_CHUNK_EVENTS)) {
+		chunk = thread->chunk = takeChunk(thread, current);
+		if (chunk == NULL) {
+			dropped.fetch_add(1, memory_order_relaxed);
+			return;
+		}
+	}
+
+	int n = chunk->count.load(memory_order_relaxed);
+	TraceEvent& event = chunk->events[n];
+	event.t = traceNow();
+	event.phase = phase;
+	copyText(event.name, name, TRACE_NAME_LENGTH);
+	copyText(event.detail, detail, TRACE_DETAIL_LENGTH);
+	chunk->count.store(n + 1, memory_order_release);
+}
+
+/*********************************************************************
+
+Trace
+
+*********************************************************************/
+
+void Trace::Start()
+{
+	lock_guard<mutex> guard(poolLock);
+	unsigned next = generation.load(memory_order_relaxed) + 1;
+	//the last trace's chunks may still be finishing an event, older ones cannot
+	for (size_t i = 0; i < chunks.size(); i++) {
+		if (!chunks[i]->spare && (chunks[i]->generation + 1 < next)) {
+			chunks[i]->spare = true;
+			spareChunks.push_back(chunks[i]);
+		}
+	}
+	dropped.store(0, memory_order_relaxed);
+	epoch.store(traceNow(), memory_order_relaxed);
+	generation.store(next, memory_order_release);
+	recording.store(true, memory_order_release);
+}
+
+void Trace::Stop()
+{
+	recording.store(false, memory_order_release);
+}
+
+bool Trace::Recording()
+{
+	return recording.load(memory_order_relaxed);
+}
+
+void Trace::Begin(const char* name, const char* detail)
+{
+	record('B', name, detail);
+}
+
+void Trace::End()
+{
+	record('E', "", NULL);
+}
+
+void Trace::Instant(const char* name, const char* detail)
+{
+	record('i', name, detail);
+}
+
+void Trace::NameThread(const char* name)
+{
+	TraceThread* thread = (self.thread != NULL) ? self.thread : joinTrace();
+	lock_guard<mutex> guard(poolLock);
+	copyText(thread->name, name, TRACE_NAME_LENGTH);
+	if (thread->chunk != NULL) {
+		copyText(thread->chunk->name, name, TRACE_NAME_LENGTH);
+	}
+}
+
+uint64_t Trace::Dropped()
+{
+	return dropped.load(memory_order_relaxed);
+}
+
+//Writes text as a JSON string
+static void writeString(FILE* file, const char* text)
+{
+	fputc('"', file);
+	for (const char* p = text; *p != '\0'; p++) {
+		unsigned char c = (unsigned char)*p;
+		if ((c == '"') || (c == '\\')) {
+			fputc('\\', file);
+			fputc(c, file);
+		}
+		else if (c < 0x20) {
+			//the carriage return ending a gantry command, among others
+			fprintf(file, "\\u%04x", c);
+		}
+		else {
+			fputc(c, file);
+		}
+	}
+	fputc('"', file);
+}
+
+bool Trace::Export(const char* path)
+{
+	vector<TraceChunk*> current;
+	vector<TraceThread> names;
+	{
+		//threads that wrote to the trace, named as their last chunk was
+		lock_guard<mutex> guard(poolLock);
+		unsigned now = generation.load(memory_order_relaxed);
+		for (size_t i = 0; i < chunks.size(); i++) {
+			if (!chunks[i]->spare && (chunks[i]->generation == now)) {
+				current.push_back(chunks[i]);
+				TraceThread name;
+				name.id = chunks[i]->thread;
+				copyText(name.name, chunks[i]->name, TRACE_NAME_LENGTH);
+				bool seen = false;
+				for (size_t k = 0; k < names.size(); k++) {
+					if (names[k].id == name.id) {
+						names[k] = name;
+						seen = true;
+					}
+				}
+				if (!seen) {
+					names.push_back(name);
+				}
+			}
+		}
+	}
+
+	FILE* file = fopen(path, "w");
+	if (file == NULL) {
+		printf("Trace: cannot write %s\n", path);
+		return false;
+	}
+	int64_t start = epoch.load(memory_order_relaxed);
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	bool first = true;
+	for (size_t i = 0; i < names.size(); i++) {
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", names[i].id);
+		writeString(file, names[i].name);
+		fprintf(file, "}}");
+		first = false;
+	}
+	for (size_t i = 0; i < current.size(); i++) {
+		int count = current[i]->count.load(memory_order_acquire);
+		for (int k = 0; k < count; k++) {
+			const TraceEvent& event = current[i]->events[k];
+			fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+			writeString(file, event.name);
+			//microseconds, to the nanosecond
+			fprintf(file, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d", event.phase, (event.t - start) / 1000.0, current[i]->thread);
+			if (event.phase == 'i') {
+				fprintf(file, ",\"s\":\"t\"");
+			}
+			if (event.detail[0] != '\0') {
+				fprintf(file, ",\"args\":{\"detail\":");
+				writeString(file, event.detail);
+				fprintf(file, "}");
+			}
+			fprintf(file, "}");
+			first = false;
+		}
+	}
+	fprintf(file, "\n]}\n");
+	bool written = !ferror(file);
+	fclose(file);
+	return written;
+}
@@ -0,0 +1,74 @@
+/* ************************************************************
+Trace.h
+**************************************************************
+
+Timeline of where a trial's time goes, from every thread, written out
+as a Chrome trace (load the .json in ui.perfetto.dev or chrome://tracing).
+
+	TraceScope scope("pickup move");        span to the end of the block
+	Trace::Begin("run"); ... Trace::End();  span over code that is not one block
+	Trace::Instant("command", "moveZ150");  point event, e.g. a serial command
+
+Spans nest per thread. Names and details are copied (up to 31 and 23
+characters), so they may come from strings that do not outlive the
+trace.
+
+Each thread writes its own chunks of events with no lock; a chunk is
+taken from a shared pool, under a lock, once every TRACE_CHUNK_EVENTS
+events. A thread's entry goes back to the pool when the thread exits
+and the next thread to start reuses it, under a new id, so short lived
+threads (a reset stage each) cost nothing once gone.
+
+Timestamps are steady_clock nanoseconds. Nothing is recorded between
+Stop and Start, and a call costs one atomic load then.
+
+Start begins a new trace. The chunks of the trace before the last are
+reused, so a thread still finishing an event in the last trace is never
+written over. Export can be called while threads go on recording; it
+writes what has been recorded so far. Past TRACE_MAX_CHUNKS chunks in
+use, events are dropped and counted.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define TRACE_CHUNK_EVENTS              256
+#define TRACE_MAX_CHUNKS                4096
+#define TRACE_NAME_LENGTH               32
+#define TRACE_DETAIL_LENGTH             23
+
+struct TraceEvent {
+	int64_t t;				// steady_clock ns
+	char name[TRACE_NAME_LENGTH];
+	char detail[TRACE_DETAIL_LENGTH];
+	char phase;				// 'B' begin, 'E' end, 'i' instant
+};
+
+class Trace {
+public:
+	//Starts a new trace, dropping the one before
+	static void Start();
+	static void Stop();
+	static bool Recording();
+
+	static void Begin(const char* name, const char* detail = NULL);
+	static void End();
+	static void Instant(const char* name, const char* detail = NULL);
+
+	//Name the calling thread shows under
+	static void NameThread(const char* name);
+
+	//Writes the current trace as Chrome trace JSON
+	static bool Export(const char* path);
+	//Events dropped in the current trace for want of chunks
+	static uint64_t Dropped();
+};
+
+//Span from construction to the end of the enclosing block
+class TraceScope {
+public:
+	TraceScope(const char* name, const char* detail = NULL) { Trace::Begin(name, detail); }
+	~TraceScope() { Trace::End(); }
+};
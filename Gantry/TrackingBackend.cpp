@@ -0,0 +1,319 @@
+/* ************************************************************
+TrackingBackend.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include "NPTrackingTools.h"
+#include "TrackingBackend.h"
+#include "TrialLog.h"
+
+using namespace std;
+
+/*********************************************************************
+
+MotiveBackend
+
+*********************************************************************/
+
+bool MotiveBackend::Initialize()
+{
+	return TT_Initialize() == NPRESULT_SUCCESS;
+}
+
+bool MotiveBackend::LoadProject(const char* path)
+{
+	NPRESULT result = TT_LoadProject(path);
+	if (result != NPRESULT_SUCCESS) {
+		printf("Error loading %s: %s\n", path, TT_GetResultString(result));
+		return false;
+	}
+	return true;
+}
+
+void MotiveBackend::Shutdown()
+{
+	TT_Shutdown();
+}
+
+bool MotiveBackend::Update()
+{
+	return TT_Update() == NPRESULT_SUCCESS;
+}
+
+double MotiveBackend::FrameTimeStamp()
+{
+	return TT_FrameTimeStamp();
+}
+
+int MotiveBackend::FrameMarkerCount()
+{
+	return TT_FrameMarkerCount();
+}
+
+void MotiveBackend::FrameMarkers(float* x, float* y, float* z, int count)
+{
+	//the SDK only has per marker accessors
+	for (int i = 0; i < count; i++) {
+		x[i] = TT_FrameMarkerX(i);
+		y[i] = TT_FrameMarkerY(i);
+		z[i] = TT_FrameMarkerZ(i);
+	}
+}
+
+void MotiveBackend::RigidBodyLocation(int index, RigidBodyPose* pose)
+{
+	TT_RigidBodyLocation(index, &pose->x, &pose->y, &pose->z, &pose->qx, &pose->qy, &pose->qz, &pose->qw, &pose->yaw, &pose->pitch, &pose->roll);
+}
+
+bool MotiveBackend::IsRigidBodyTracked(int index)
+{
+	return TT_IsRigidBodyTracked(index);
+}
+
+bool MotiveBackend::RigidBodyEnabled(int index)
+{
+	return TT_RigidBodyEnabled(index);
+}
+
+void MotiveBackend::SetRigidBodyEnabled(int index, bool enabled)
+{
+	TT_SetRigidBodyEnabled(index, enabled);
+}
+
+void MotiveBackend::FlushCameraQueues()
+{
+	TT_FlushCameraQueues();
+}
+
+/*********************************************************************
+
+ReplayTrackingBackend
+
+*********************************************************************/
+
+ReplayTrackingBackend::ReplayTrackingBackend(const char* filename, ReplayMode mode)
+	: mode(mode), started(false), current(0)
+{
+	size_t length = strlen(filename);
+	TrialLogReader log;
+	if ((length > 4) && (strcmp(filename + length - 4, ".gtl") == 0) && log.Open(filename)) {
+		for (int c = 0; c < log.Chunks(); c++) {
+			const TrialLogChunk& chunk = log.Chunk(c);
+			for (int i = 0; i < chunk.rows; i++) {
+				AddMarker(chunk.time[i], chunk.x[i], chunk.y[i], chunk.z[i]);
+			}
+		}
+		first.push_back((int)mx.size());
+		printf("Tracking replay: %d frames from %s\n", (int)times.size(), filename);
+		return;
+	}
+
+	ifstream file(filename);
+	if (!file.is_open()) {
+		printf("Tracking replay: can't open %s\n", filename);
+		return;
+	}
+
+	//Lines look like "12.345678,\t\t3,\t\t0.1,\t\t0.2,\t\t0.3,\t\t0100",
+	//anything else (headers) is skipped. Markers of one frame share a time.
+	string line;
+	while (getline(file, line)) {
+		double t;
+		int id;
+		float x, y, z;
+		if (sscanf(line.c_str(), "%lf ,%d ,%f ,%f ,%f", &t, &id, &x, &y, &z) != 5) {
+			continue;
+		}
+		AddMarker(t, x, y, z);
+	}
+	first.push_back((int)mx.size());
+
+	printf("Tracking replay: %d frames from %s\n", (int)times.size(), filename);
+}
+
+void ReplayTrackingBackend::AddMarker(double t, float x, float y, float z)
+{
+	if (times.empty() || (t != times.back())) {
+		times.push_back(t);
+		first.push_back((int)mx.size());
+	}
+	mx.push_back(x);
+	my.push_back(y);
+	mz.push_back(z);
+}
+
+bool ReplayTrackingBackend::Initialize()
+{
+	started = false;
+	current = 0;
+	return IsLoaded();
+}
+
+bool ReplayTrackingBackend::Update()
+{
+	if (!IsLoaded()) {
+		return false;
+	}
+
+	//The clock starts with the first Update
+	if (!started) {
+		started = true;
+		start = chrono::steady_clock::now();
+		return true;
+	}
+
+	int last = (int)times.size() - 1;
+	if (mode == REPLAY_FAST) {
+		if (current < last) {
+			current++;
+		}
+		return true;
+	}
+
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	while ((current < last) && (times[current + 1] - times[0] <= elapsed)) {
+		current++;
+	}
+	return true;
+}
+
+double ReplayTrackingBackend::FrameTimeStamp()
+{
+	return IsLoaded() ? times[current] : 0;
+}
+
+int ReplayTrackingBackend::FrameMarkerCount()
+{
+	return IsLoaded() ? first[current + 1] - first[current] : 0;
+}
+
+void ReplayTrackingBackend::FrameMarkers(float* x, float* y, float* z, int count)
+{
+	int offset = first[current];
+	for (int i = 0; i < count; i++) {
+		x[i] = mx[offset + i];
+		y[i] = my[offset + i];
+		z[i] = mz[offset + i];
+	}
+}
+
+void ReplayTrackingBackend::RigidBodyLocation(int index, RigidBodyPose* pose)
+{
+	*pose = RigidBodyPose();
+	pose->qw = 1;
+}
+
+/*********************************************************************
+
+ImpairedTracking
+
+*********************************************************************/
+
+ImpairedTracking::ImpairedTracking(TrackingBackend* source, unsigned seed)
+	: noise(0), occlusion(0), occlusionFrames(5), dropRate(0), source(source), random(seed),
+	haveFrame(false), sourceTime(0), time(0), dropped(0)
+{
+}
+
+bool ImpairedTracking::Hide(int* hidden)
+{
+	if (*hidden > 0) {
+		(*hidden)--;
+		return true;
+	}
+	if (uniform_real_distribution<float>(0, 1)(random) < occlusion) {
+		//geometric, so the mean is occlusionFrames
+		float p = 1 / max(occlusionFrames, 1.0f);
+		*hidden = geometric_distribution<int>(p)(random);
+		return true;
+	}
+	return false;
+}
+
+bool ImpairedTracking::Update()
+{
+	if (!source->Update()) {
+		return false;
+	}
+
+	double t = source->FrameTimeStamp();
+	if (haveFrame && (t == sourceTime)) {
+		return true;
+	}
+	sourceTime = t;
+
+	//a lost frame leaves the previous one showing, so the next time stamp jumps
+	if (haveFrame && (uniform_real_distribution<float>(0, 1)(random) < dropRate)) {
+		dropped++;
+		return true;
+	}
+
+	int n = source->FrameMarkerCount();
+	rawX.resize(n);
+	rawY.resize(n);
+	rawZ.resize(n);
+	if (n > 0) {
+		source->FrameMarkers(&rawX[0], &rawY[0], &rawZ[0], n);
+	}
+	if ((int)hiddenMarkers.size() < n) {
+		hiddenMarkers.resize(n, 0);
+	}
+
+	normal_distribution<float> jitter(0, noise);
+	x.clear();
+	y.clear();
+	z.clear();
+	for (int i = 0; i < n; i++) {
+		if (Hide(&hiddenMarkers[i])) {
+			continue;
+		}
+		x.push_back(rawX[i] + ((noise > 0) ? jitter(random) : 0));
+		y.push_back(rawY[i] + ((noise > 0) ? jitter(random) : 0));
+		z.push_back(rawZ[i] + ((noise > 0) ? jitter(random) : 0));
+	}
+
+	for (size_t k = 0; k < hiddenBodies.size(); k++) {
+		Hide(&hiddenBodies[k]);
+	}
+
+	time = t;
+	haveFrame = true;
+	return true;
+}
+
+void ImpairedTracking::FrameMarkers(float* xOut, float* yOut, float* zOut, int count)
+{
+	count = min(count, (int)x.size());
+	for (int i = 0; i < count; i++) {
+		xOut[i] = x[i];
+		yOut[i] = y[i];
+		zOut[i] = z[i];
+	}
+}
+
+void ImpairedTracking::RigidBodyLocation(int index, RigidBodyPose* pose)
+{
+	source->RigidBodyLocation(index, pose);
+	if (noise > 0) {
+		normal_distribution<float> jitter(0, noise);
+		pose->x += jitter(random);
+		pose->y += jitter(random);
+		pose->z += jitter(random);
+	}
+}
+
+bool ImpairedTracking::IsRigidBodyTracked(int index)
+{
+	//bodies are occluded frame by frame from the first time they are asked about
+	if ((int)hiddenBodies.size() <= index) {
+		hiddenBodies.resize(index + 1, 0);
+	}
+	return (hiddenBodies[index] == 0) && source->IsRigidBodyTracked(index);
+}
@@ -0,0 +1,159 @@
+/* ************************************************************
+TrackingBackend.h
+**************************************************************
+
+The part of the OptiTrack (NPTrackingTools) API the app uses, behind an
+interface so tracking code can run against a simulated or replayed
+source as well as Motive.
+
+MotiveBackend forwards to the TT_* functions. Rigid body indices are the
+ones from the Motive project: 0 gantry, 1 and 2 snake contacts.
+
+ReplayTrackingBackend plays back the markers from a trial log (.gtl) or
+a CSV trial file (time, marker ID, x, y, z, contact per line). It has no
+rigid bodies.
+SimulatedTracking (SimulatedDevices.h) generates a moving snake.
+
+ImpairedTracking wraps any of them and adds what real cameras do to the
+data: extra noise, markers occluded for a few frames, dropped frames and
+rigid bodies losing track. MockNPTrackingTools.cpp puts the same sources
+behind the TT_* functions themselves.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include "SerialCapture.h"
+
+struct RigidBodyPose {
+	float x, y, z;
+	float qx, qy, qz, qw;
+	float yaw, pitch, roll;
+};
+
+class TrackingBackend {
+public:
+	virtual ~TrackingBackend() {}
+
+	virtual bool Initialize() = 0;
+	virtual bool LoadProject(const char* path) = 0;
+	virtual void Shutdown() = 0;
+
+	//Fetches the next frame, false on error
+	virtual bool Update() = 0;
+	virtual double FrameTimeStamp() = 0;
+	virtual int FrameMarkerCount() = 0;
+
+	//Copies the first count markers of the current frame
+	virtual void FrameMarkers(float* x, float* y, float* z, int count) = 0;
+
+	virtual void RigidBodyLocation(int index, RigidBodyPose* pose) = 0;
+	virtual bool IsRigidBodyTracked(int index) = 0;
+	virtual bool RigidBodyEnabled(int index) = 0;
+	virtual void SetRigidBodyEnabled(int index, bool enabled) = 0;
+	virtual void FlushCameraQueues() = 0;
+};
+
+class MotiveBackend : public TrackingBackend {
+public:
+	bool Initialize();
+	bool LoadProject(const char* path);
+	void Shutdown();
+
+	bool Update();
+	double FrameTimeStamp();
+	int FrameMarkerCount();
+	void FrameMarkers(float* x, float* y, float* z, int count);
+
+	void RigidBodyLocation(int index, RigidBodyPose* pose);
+	bool IsRigidBodyTracked(int index);
+	bool RigidBodyEnabled(int index);
+	void SetRigidBodyEnabled(int index, bool enabled);
+	void FlushCameraQueues();
+};
+
+class ReplayTrackingBackend : public TrackingBackend {
+public:
+	//REPLAY_REALTIME follows the recorded time stamps, REPLAY_FAST steps
+	//one frame per Update
+	ReplayTrackingBackend(const char* filename, ReplayMode mode = REPLAY_REALTIME);
+
+	bool IsLoaded() { return !times.empty(); }
+	bool Finished() { return IsLoaded() && (current == (int)times.size() - 1); }
+
+	bool Initialize();
+	bool LoadProject(const char* path) { return true; }
+	void Shutdown() {}
+
+	bool Update();
+	double FrameTimeStamp();
+	int FrameMarkerCount();
+	void FrameMarkers(float* x, float* y, float* z, int count);
+
+	void RigidBodyLocation(int index, RigidBodyPose* pose);
+	bool IsRigidBodyTracked(int index) { return false; }
+	bool RigidBodyEnabled(int index) { return false; }
+	void SetRigidBodyEnabled(int index, bool enabled) {}
+	void FlushCameraQueues() {}
+
+private:
+	void AddMarker(double t, float x, float y, float z);
+
+	ReplayMode mode;
+	bool started;
+	std::chrono::steady_clock::time_point start;
+	int current;
+	std::vector<double> times;
+	std::vector<int> first;		// index of each frame's first marker, plus one past the end
+	std::vector<float> mx, my, mz;
+};
+
+class ImpairedTracking : public TrackingBackend {
+public:
+	//source is not owned
+	ImpairedTracking(TrackingBackend* source, unsigned seed = 1);
+
+	bool Initialize() { return source->Initialize(); }
+	bool LoadProject(const char* path) { return source->LoadProject(path); }
+	void Shutdown() { source->Shutdown(); }
+
+	bool Update();
+	double FrameTimeStamp() { return time; }
+	int FrameMarkerCount() { return (int)x.size(); }
+	void FrameMarkers(float* x, float* y, float* z, int count);
+
+	//One marker of the current frame, index < FrameMarkerCount()
+	float MarkerX(int index) const { return x[index]; }
+	float MarkerY(int index) const { return y[index]; }
+	float MarkerZ(int index) const { return z[index]; }
+
+	void RigidBodyLocation(int index, RigidBodyPose* pose);
+	bool IsRigidBodyTracked(int index);
+	bool RigidBodyEnabled(int index) { return source->RigidBodyEnabled(index); }
+	void SetRigidBodyEnabled(int index, bool enabled) { source->SetRigidBodyEnabled(index, enabled); }
+	void FlushCameraQueues() { source->FlushCameraQueues(); }
+
+	//Source frames that were never passed on
+	unsigned Dropped() const { return dropped; }
+
+	float noise;			// m, extra std deviation added to every coordinate
+	float occlusion;		// chance per frame that a visible marker or rigid body is hidden
+	float occlusionFrames;	// mean frames it then stays hidden
+	float dropRate;			// chance per frame that the whole frame is lost
+
+private:
+	bool Hide(int* hidden);
+
+	TrackingBackend* source;
+	std::mt19937 random;
+	bool haveFrame;
+	double sourceTime;
+	double time;
+	unsigned dropped;
+	std::vector<float> rawX, rawY, rawZ;
+	std::vector<float> x, y, z;
+	std::vector<int> hiddenMarkers;
+	std::vector<int> hiddenBodies;
+};
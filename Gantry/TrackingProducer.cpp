@@ -0,0 +1,116 @@
+/* ************************************************************
+TrackingProducer.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <chrono>
+#include "Trace.h"
+#include "TrackingProducer.h"
+
+using namespace std;
+
+TrackingProducer::TrackingProducer(TrackingBackend* backend, MarkerFramePool* pool)
+	: pollInterval(1), backend(backend), pool(pool), labeler(NULL), shape(NULL), updateTimes(NULL), running(false), frames(0), dropped(0)
+{
+}
+
+TrackingProducer::~TrackingProducer()
+{
+	Stop();
+}
+
+void TrackingProducer::Start()
+{
+	if (!running) {
+		running = true;
+		producer = thread(&TrackingProducer::Run, this);
+	}
+}
+
+void TrackingProducer::Stop()
+{
+	if (running) {
+		running = false;
+		producer.join();
+	}
+
+	//Frames nobody picked up go back to the pool
+	MarkerFrame* frame;
+	while (queue.Pop(&frame)) {
+		pool->Release(frame);
+	}
+}
+
+bool TrackingProducer::Pop(MarkerFrame** frame)
+{
+	return queue.Pop(frame);
+}
+
+bool TrackingProducer::Latest(MarkerFrame** frame)
+{
+	MarkerFrame* newest = NULL;
+	MarkerFrame* next;
+	while (queue.Pop(&next)) {
+		if (newest != NULL) {
+			pool->Release(newest);
+		}
+		newest = next;
+	}
+	if (newest == NULL) {
+		return false;
+	}
+	*frame = newest;
+	return true;
+}
+
+void TrackingProducer::Run()
+{
+	double prev_t = -1;
+	Trace::NameThread("tracking");
+
+	while (running) {
+		chrono::steady_clock::time_point updateStart = chrono::steady_clock::now();
+		if (!backend->Update()) {
+			this_thread::sleep_for(chrono::milliseconds(pollInterval));
+			continue;
+		}
+
+		//Update returns straight away when the camera has nothing new
+		double t = backend->FrameTimeStamp();
+		if (t == prev_t) {
+			this_thread::sleep_for(chrono::milliseconds(pollInterval));
+			continue;
+		}
+		prev_t = t;
+		if (updateTimes != NULL) {
+			updateTimes->Record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - updateStart).count());
+		}
+
+		//a new camera frame, to when it is queued
+		TraceScope scope("frame");
+		MarkerFrame* frame = pool->Acquire();
+		if (frame == NULL) {
+			dropped++;
+			continue;
+		}
+
+		FillMarkerFrame(backend, pool, frame);
+		if (labeler != NULL) {
+			labeler->Label(frame);
+		}
+		frame->sequence = frames + dropped;
+		if (shape != NULL) {
+			shape->Update(frame);
+		}
+
+		if (queue.Push(frame)) {
+			frames++;
+		}
+		else {
+			pool->Release(frame);
+			dropped++;
+		}
+	}
+}
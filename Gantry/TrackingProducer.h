@@ -0,0 +1,78 @@
+/* ************************************************************
+TrackingProducer.h
+**************************************************************
+
+Camera acquisition on its own thread.
+
+The producer calls the tracking backend's Update at camera rate, copies
+each new frame into a MarkerFrame from the pool, stamps it and pushes it
+onto a lock-free single producer / single consumer queue. The control
+loop pops frames whenever it gets round to it and never waits on the
+camera.
+
+If the consumer falls behind, or the pool runs out of frames, new frames
+are dropped and counted rather than blocking the camera thread. While
+the producer is running no other thread may use the backend.
+
+With a labeler attached, marker IDs are assigned on the producer thread
+before the frame is queued, so they are stable from frame to frame. With
+a shape estimator attached, every queued frame also updates the snake's
+center of mass, heading and curvature. With an update histogram attached,
+the time each Update took that brought a new frame is recorded in it.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include "LoopStats.h"
+#include "MarkerFrame.h"
+#include "MarkerTracker.h"
+#include "SnakeShape.h"
+#include "SpscQueue.h"
+#include "TrackingBackend.h"
+
+#define TRACKING_QUEUE_SIZE             8
+
+class TrackingProducer {
+public:
+	//The pool needs more frames than the queue holds
+	TrackingProducer(TrackingBackend* backend, MarkerFramePool* pool);
+	~TrackingProducer();
+
+	void Start();
+	void Stop();
+
+	//Only change the labeler while stopped; NULL leaves IDs as Motive's indices
+	void SetLabeler(MarkerTracker* tracker) { labeler = tracker; }
+	void SetShapeEstimator(SnakeShapeEstimator* estimator) { shape = estimator; }
+	//Only while stopped; written on the producer thread
+	void SetUpdateTimes(LatencyHistogram* histogram) { updateTimes = histogram; }
+
+	//Oldest queued frame, false if none. Hand it back with Release.
+	bool Pop(MarkerFrame** frame);
+	void Release(MarkerFrame* frame) { pool->Release(frame); }
+
+	//Newest queued frame, releasing any older ones
+	bool Latest(MarkerFrame** frame);
+
+	//Frames queued / dropped since construction
+	unsigned Frames() const { return frames; }
+	unsigned Dropped() const { return dropped; }
+
+	int pollInterval;	// ms to wait before polling again when there is no new frame
+
+private:
+	void Run();
+
+	TrackingBackend* backend;
+	MarkerFramePool* pool;
+	MarkerTracker* labeler;
+	SnakeShapeEstimator* shape;
+	LatencyHistogram* updateTimes;
+	SpscQueue<MarkerFrame*, TRACKING_QUEUE_SIZE> queue;
+	std::atomic<bool> running;
+	std::atomic<unsigned> frames;
+	std::atomic<unsigned> dropped;
+	std::thread producer;
+};
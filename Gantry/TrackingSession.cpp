@@ -0,0 +1,87 @@
+/* ************************************************************
+TrackingSession.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <cstdio>
+#include "Trace.h"
+#include "TrackingSession.h"
+
+TrackingSession::TrackingSession(TrackingBackend* backend, int rigidBodies)
+	: backend(backend), rigidBodies(rigidBodies), open(false), profile(PROFILE_NONE), mask(0), changes(0)
+{
+}
+
+TrackingSession::~TrackingSession()
+{
+	Close();
+}
+
+bool TrackingSession::Open(const char* project)
+{
+	if (open) {
+		return true;
+	}
+	if (!backend->Initialize()) {
+		printf("Tracking: initialize failed\n");
+		return false;
+	}
+	if (!backend->LoadProject(project)) {
+		backend->Shutdown();
+		return false;
+	}
+	open = true;
+
+	//start from whatever the project file left enabled
+	mask = 0;
+	for (int i = 0; i < rigidBodies; i++) {
+		if (backend->RigidBodyEnabled(i)) {
+			mask |= 1u << i;
+		}
+	}
+	profile = PROFILE_NONE;
+	return true;
+}
+
+void TrackingSession::Close()
+{
+	if (open) {
+		backend->Shutdown();
+		open = false;
+		profile = PROFILE_NONE;
+	}
+}
+
+void TrackingSession::SetProfile(TrackingProfile wanted)
+{
+	if (wanted == profile) {
+		return;
+	}
+	TraceScope scope("tracking profile", (wanted == PROFILE_RIGID_BODIES) ? "rigid bodies" : "raw markers");
+	unsigned all = (rigidBodies >= 32) ? ~0u : (1u << rigidBodies) - 1;
+	ApplyMask((wanted == PROFILE_RIGID_BODIES) ? all : 0);
+	profile = wanted;
+}
+
+void TrackingSession::SetRigidBodyEnabled(int index, bool enabled)
+{
+	unsigned wanted = enabled ? (mask | (1u << index)) : (mask & ~(1u << index));
+	if (wanted != mask) {
+		ApplyMask(wanted);
+		profile = PROFILE_NONE;
+	}
+}
+
+void TrackingSession::ApplyMask(unsigned wanted)
+{
+	unsigned changed = wanted ^ mask;
+	for (int i = 0; i < rigidBodies; i++) {
+		if (changed & (1u << i)) {
+			backend->SetRigidBodyEnabled(i, (wanted >> i) & 1);
+			changes++;
+		}
+	}
+	mask = wanted;
+}
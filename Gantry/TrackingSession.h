@@ -0,0 +1,62 @@
+/* ************************************************************
+TrackingSession.h
+**************************************************************
+
+One tracking session for the whole batch of trials.
+
+Motive is initialized and the project loaded once, in Open. Between the
+snake run and the gantry moves only the set of enabled rigid bodies
+changes, through a profile:
+
+	PROFILE_RAW_MARKERS		all rigid bodies off, so every marker ends up
+							in the frame data written to the trial log
+	PROFILE_RIGID_BODIES	all rigid bodies on (0 gantry, 1 and 2 snake
+							contacts, ...)
+
+The enable state of each body is cached as a bit mask, so switching
+profile only touches the bodies that actually change and asking for the
+profile already in force costs nothing.
+*/
+
+#pragma once
+
+#include "TrackingBackend.h"
+
+enum TrackingProfile {
+	PROFILE_NONE,
+	PROFILE_RAW_MARKERS,
+	PROFILE_RIGID_BODIES
+};
+
+class TrackingSession {
+public:
+	//rigidBodies is how many bodies the project defines (at most 32)
+	TrackingSession(TrackingBackend* backend, int rigidBodies);
+	~TrackingSession();
+
+	bool Open(const char* project);
+	void Close();
+	bool IsOpen() { return open; }
+
+	void SetProfile(TrackingProfile profile);
+	TrackingProfile Profile() { return profile; }
+
+	void SetRigidBodyEnabled(int index, bool enabled);
+	bool RigidBodyEnabled(int index) { return (mask >> index) & 1; }
+	unsigned EnabledMask() { return mask; }
+
+	//Enable / disable calls made on the backend
+	int Changes() { return changes; }
+
+	TrackingBackend* Backend() { return backend; }
+
+private:
+	void ApplyMask(unsigned wanted);
+
+	TrackingBackend* backend;
+	int rigidBodies;
+	bool open;
+	TrackingProfile profile;
+	unsigned mask;
+	int changes;
+};
@@ -0,0 +1,462 @@
+/* ************************************************************
+TrialLog.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include "TrialLog.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static_assert(sizeof(TrialLogHeader) == 256, "TrialLogHeader layout");
+static_assert(sizeof(TrialLogChunkHeader) == 16, "TrialLogChunkHeader layout");
+static_assert(sizeof(TrialLogIndexEntry) == 32, "TrialLogIndexEntry layout");
+
+#define TRIAL_LOG_TRAILER_SIZE          16
+
+static uint64_t pad8(uint64_t bytes)
+{
+	return (bytes + 7) & ~(uint64_t)7;
+}
+
+static uint64_t chunkBytes(uint64_t rows)
+{
+	//time, then id, x, y, z and contact at 4 bytes a row
+	return sizeof(TrialLogChunkHeader) + pad8(rows * sizeof(double)) + 5 * pad8(rows * 4);
+}
+
+static void copyField(char* field, size_t size, const char* text)
+{
+	memset(field, 0, size);
+	if (text != NULL) {
+		strncpy(field, text, size - 1);
+	}
+}
+
+/*********************************************************************
+
+TrialLog
+
+*********************************************************************/
+
+TrialLog::TrialLog()
+	: rows(0)
+{
+}
+
+TrialLog::~TrialLog()
+{
+	Close();
+}
+
+bool TrialLog::Open(const string& filename, int trial, const char* project, int markers)
+{
+	Close();
+
+	file.open(filename, ios::binary | ios::trunc);
+	if (!file.is_open()) {
+		printf("Can't open trial log %s\n", filename.c_str());
+		return false;
+	}
+
+	TrialLogHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "GTRL", 4);
+	header.version = TRIAL_LOG_VERSION;
+	header.headerSize = sizeof(TrialLogHeader);
+	header.trial = trial;
+	header.markers = markers;
+	header.startTime = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+	copyField(header.units, sizeof(header.units), "m");
+	copyField(header.project, sizeof(header.project), project);
+	copyField(header.name, sizeof(header.name), filename.c_str());
+	file.write((const char*)&header, sizeof(header));
+
+	rows = 0;
+	index.clear();
+	annotations.clear();
+	time.reserve(TRIAL_LOG_CHUNK_ROWS);
+	id.reserve(TRIAL_LOG_CHUNK_ROWS);
+	x.reserve(TRIAL_LOG_CHUNK_ROWS);
+	y.reserve(TRIAL_LOG_CHUNK_ROWS);
+	z.reserve(TRIAL_LOG_CHUNK_ROWS);
+	contact.reserve(4 * TRIAL_LOG_CHUNK_ROWS);
+	return true;
+}
+
+void TrialLog::Close()
+{
+	if (!file.is_open()) {
+		return;
+	}
+	WriteChunk();
+
+	uint64_t footer = file.tellp();
+	uint32_t count = (uint32_t)index.size();
+	file.write("GIDX", 4);
+	file.write((const char*)&count, sizeof(count));
+	if (count > 0) {
+		file.write((const char*)index.data(), count * sizeof(TrialLogIndexEntry));
+	}
+
+	count = (uint32_t)annotations.size();
+	file.write((const char*)&count, sizeof(count));
+	for (size_t i = 0; i < annotations.size(); i++) {
+		uint32_t length = (uint32_t)annotations[i].text.size();
+		file.write((const char*)&annotations[i].row, sizeof(uint64_t));
+		file.write((const char*)&length, sizeof(length));
+		file.write(annotations[i].text.data(), length);
+	}
+
+	uint32_t zero = 0;
+	file.write((const char*)&footer, sizeof(footer));
+	file.write("GEND", 4);
+	file.write((const char*)&zero, sizeof(zero));
+	file.close();
+}
+
+void TrialLog::Append(double t, int markerId, float px, float py, float pz, const char* state)
+{
+	time.push_back(t);
+	id.push_back(markerId);
+	x.push_back(px);
+	y.push_back(py);
+	z.push_back(pz);
+
+	char packed[4] = { 0, 0, 0, 0 };
+	for (int i = 0; (i < 4) && (state[i] != '\0'); i++) {
+		packed[i] = state[i];
+	}
+	contact.insert(contact.end(), packed, packed + 4);
+
+	rows++;
+	if (time.size() >= TRIAL_LOG_CHUNK_ROWS) {
+		WriteChunk();
+	}
+}
+
+void TrialLog::AppendFrame(const MarkerFrame* frame, const char* state)
+{
+	for (int i = 0; i < frame->count; i++) {
+		Append(frame->time, frame->id[i], frame->x[i], frame->y[i], frame->z[i], state);
+	}
+}
+
+void TrialLog::Annotate(const string& text)
+{
+	TrialLogAnnotation annotation;
+	annotation.row = rows;
+	annotation.text = text;
+	annotations.push_back(annotation);
+}
+
+void TrialLog::Annotate(const char* key, double value)
+{
+	//same formatting as writing the value to the old CSV stream
+	ostringstream text;
+	text << key << ",\t\t" << value;
+	Annotate(text.str());
+}
+
+void TrialLog::WriteChunk()
+{
+	uint32_t count = (uint32_t)time.size();
+	if (count == 0) {
+		return;
+	}
+
+	TrialLogIndexEntry entry;
+	entry.offset = file.tellp();
+	entry.rows = count;
+	entry.reserved = 0;
+	entry.firstTime = time.front();
+	entry.lastTime = time.back();
+	index.push_back(entry);
+
+	TrialLogChunkHeader header;
+	memcpy(header.magic, "GCHK", 4);
+	header.rows = count;
+	header.firstRow = rows - count;
+	file.write((const char*)&header, sizeof(header));
+
+	static const char zeros[8] = { 0 };
+	uint64_t column = count * sizeof(double);
+	file.write((const char*)time.data(), column);
+	file.write(zeros, pad8(column) - column);
+
+	column = count * 4;
+	const char* columns[5] = { (const char*)id.data(), (const char*)x.data(), (const char*)y.data(), (const char*)z.data(), contact.data() };
+	for (int i = 0; i < 5; i++) {
+		file.write(columns[i], column);
+		file.write(zeros, pad8(column) - column);
+	}
+
+	//one write per chunk, not per row
+	file.flush();
+
+	time.clear();
+	id.clear();
+	x.clear();
+	y.clear();
+	z.clear();
+	contact.clear();
+}
+
+/*********************************************************************
+
+TrialLogReader
+
+*********************************************************************/
+
+TrialLogReader::TrialLogReader()
+	: data(NULL), size(0), mapping(NULL), header(NULL), rows(0), complete(false)
+{
+}
+
+TrialLogReader::~TrialLogReader()
+{
+	Close();
+}
+
+bool TrialLogReader::Map(const char* filename)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(file, &length) || (length.QuadPart == 0)) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE view = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (view == NULL) {
+		return false;
+	}
+	data = (const char*)MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL) {
+		CloseHandle(view);
+		return false;
+	}
+	mapping = view;
+	size = length.QuadPart;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if ((fstat(fd, &st) != 0) || (st.st_size == 0)) {
+		::close(fd);
+		return false;
+	}
+	void* view = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+	data = (const char*)view;
+	size = st.st_size;
+#endif
+	return true;
+}
+
+void TrialLogReader::Close()
+{
+	if (data != NULL) {
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+		CloseHandle((HANDLE)mapping);
+#else
+		munmap((void*)data, size);
+#endif
+	}
+	data = NULL;
+	size = 0;
+	mapping = NULL;
+	header = NULL;
+	chunks.clear();
+	annotations.clear();
+	rows = 0;
+	complete = false;
+}
+
+bool TrialLogReader::Open(const char* filename)
+{
+	Close();
+	if (!Map(filename)) {
+		printf("Can't map trial log %s\n", filename);
+		return false;
+	}
+
+	header = (const TrialLogHeader*)data;
+	if ((size < sizeof(TrialLogHeader)) || (memcmp(header->magic, "GTRL", 4) != 0) ||
+		(header->version != TRIAL_LOG_VERSION) || (header->headerSize > size)) {
+		printf("%s is not a trial log\n", filename);
+		Close();
+		return false;
+	}
+
+	complete = ReadFooter();
+	if (!complete) {
+		//no footer, walk the chunks
+		chunks.clear();
+		annotations.clear();
+		TrialLogChunk chunk;
+		uint64_t offset = header->headerSize;
+		while (ReadChunk(offset, &chunk)) {
+			chunks.push_back(chunk);
+			offset += chunkBytes(chunk.rows);
+		}
+	}
+
+	rows = 0;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		rows += chunks[i].rows;
+	}
+	return true;
+}
+
+bool TrialLogReader::ReadChunk(uint64_t offset, TrialLogChunk* chunk)
+{
+	if ((offset % 8 != 0) || (offset + sizeof(TrialLogChunkHeader) > size)) {
+		return false;
+	}
+	const TrialLogChunkHeader* chunkHeader = (const TrialLogChunkHeader*)(data + offset);
+	if ((memcmp(chunkHeader->magic, "GCHK", 4) != 0) || (offset + chunkBytes(chunkHeader->rows) > size)) {
+		return false;
+	}
+
+	uint64_t rowCount = chunkHeader->rows;
+	const char* column = data + offset + sizeof(TrialLogChunkHeader);
+	chunk->rows = (int)rowCount;
+	chunk->firstRow = chunkHeader->firstRow;
+	chunk->time = (const double*)column;
+	column += pad8(rowCount * sizeof(double));
+	chunk->id = (const int32_t*)column;
+	column += pad8(rowCount * 4);
+	chunk->x = (const float*)column;
+	column += pad8(rowCount * 4);
+	chunk->y = (const float*)column;
+	column += pad8(rowCount * 4);
+	chunk->z = (const float*)column;
+	column += pad8(rowCount * 4);
+	chunk->contact = column;
+	return true;
+}
+
+bool TrialLogReader::ReadFooter()
+{
+	if (size < (uint64_t)header->headerSize + TRIAL_LOG_TRAILER_SIZE) {
+		return false;
+	}
+	const char* trailer = data + size - TRIAL_LOG_TRAILER_SIZE;
+	uint64_t footer;
+	memcpy(&footer, trailer, sizeof(footer));
+	if ((memcmp(trailer + 8, "GEND", 4) != 0) || (footer + 8 > size - TRIAL_LOG_TRAILER_SIZE) ||
+		(memcmp(data + footer, "GIDX", 4) != 0)) {
+		return false;
+	}
+
+	const char* p = data + footer + 4;
+	const char* end = trailer;
+	uint32_t count;
+	memcpy(&count, p, sizeof(count));
+	p += sizeof(count);
+	if ((uint64_t)(end - p) < (uint64_t)count * sizeof(TrialLogIndexEntry)) {
+		return false;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		TrialLogIndexEntry entry;
+		memcpy(&entry, p, sizeof(entry));
+		p += sizeof(entry);
+
+		TrialLogChunk chunk;
+		if (!ReadChunk(entry.offset, &chunk) || ((uint32_t)chunk.rows != entry.rows)) {
+			return false;
+		}
+		chunks.push_back(chunk);
+	}
+
+	if (end - p < (ptrdiff_t)sizeof(count)) {
+		return false;
+	}
+	memcpy(&count, p, sizeof(count));
+	p += sizeof(count);
+	for (uint32_t i = 0; i < count; i++) {
+		TrialLogAnnotation annotation;
+		uint32_t length;
+		if (end - p < (ptrdiff_t)(sizeof(uint64_t) + sizeof(length))) {
+			return false;
+		}
+		memcpy(&annotation.row, p, sizeof(uint64_t));
+		memcpy(&length, p + sizeof(uint64_t), sizeof(length));
+		p += sizeof(uint64_t) + sizeof(length);
+		if ((uint64_t)(end - p) < length) {
+			return false;
+		}
+		annotation.text.assign(p, length);
+		p += length;
+		annotations.push_back(annotation);
+	}
+	return true;
+}
+
+/*********************************************************************
+
+CSV export
+
+*********************************************************************/
+
+bool TrialLogToCsv(const char* logFile, const char* csvFile)
+{
+	TrialLogReader reader;
+	if (!reader.Open(logFile)) {
+		return false;
+	}
+
+	ofstream csv(csvFile);
+	if (!csv.is_open()) {
+		printf("Can't open %s\n", csvFile);
+		return false;
+	}
+
+	//Same layout as the old per-marker lines, annotations where they were written
+	const vector<TrialLogAnnotation>& annotations = reader.Annotations();
+	size_t next = 0;
+	uint64_t row = 0;
+	for (int c = 0; c < reader.Chunks(); c++) {
+		const TrialLogChunk& chunk = reader.Chunk(c);
+		for (int i = 0; i < chunk.rows; i++, row++) {
+			while ((next < annotations.size()) && (annotations[next].row <= row)) {
+				csv << annotations[next++].text << '\n';
+			}
+			const char* state = chunk.contact + 4 * i;
+			csv << to_string(chunk.time[i]) << ",\t\t" << to_string(chunk.id[i]) << ",\t\t" << chunk.x[i] << ",\t\t" << chunk.y[i] << ",\t\t" << chunk.z[i] << ",\t\t" << string(state, strnlen(state, 4)) << '\n';
+		}
+	}
+	while (next < annotations.size()) {
+		csv << annotations[next++].text << '\n';
+	}
+
+	if (!reader.Complete()) {
+		printf("%s has no index (trial did not finish), recovered %llu rows\n", logFile, (unsigned long long)reader.Rows());
+	}
+	return true;
+}
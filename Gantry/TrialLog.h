@@ -0,0 +1,157 @@
+/* ************************************************************
+TrialLog.h
+**************************************************************
+
+Binary columnar log of one trial, replacing the per-marker CSV lines.
+
+Rows (time, marker ID, x, y, z, contact state) are buffered and written
+a chunk at a time, each column stored contiguously. The file is only
+ever appended to; the index of chunks and the text annotations ("Final
+Angle", initial conditions, ...) go in a footer written by Close. All
+columns are 8 byte aligned within the file so a reader can map it and
+use the columns in place.
+
+File layout (little endian):
+
+	TrialLogHeader						256 bytes
+	chunk:	TrialLogChunkHeader			16 bytes
+			double time[rows]			camera time stamp, s
+			int32 id[rows]				marker ID
+			float x[rows], y[rows], z[rows]
+			char contact[rows][4]		contact state, e.g. "0100"
+										(every column padded to 8 bytes)
+	...
+	footer:	"GIDX"  uint32 chunks  TrialLogIndexEntry[chunks]
+			uint32 annotations  { uint64 row  uint32 length  text }[annotations]
+	trailer: uint64 footer offset  "GEND"  uint32 0
+
+If the app dies before Close there is no footer; TrialLogReader then
+recovers the chunks by walking them from the header (annotations are
+lost). TrialLogToCsv writes the file back out in the old CSV layout.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "MarkerFrame.h"
+
+#define TRIAL_LOG_VERSION               1
+#define TRIAL_LOG_CHUNK_ROWS            4096
+
+struct TrialLogHeader {
+	char magic[4];			// "GTRL"
+	uint16_t version;
+	uint16_t headerSize;	// sizeof(TrialLogHeader)
+	uint32_t trial;
+	uint32_t markers;		// markers on the snake
+	uint64_t startTime;		// ns since epoch (system clock)
+	char units[8];			// position units, "m"
+	char project[96];		// Motive project
+	char name[128];			// trial file name
+};
+
+struct TrialLogChunkHeader {
+	char magic[4];			// "GCHK"
+	uint32_t rows;
+	uint64_t firstRow;
+};
+
+struct TrialLogIndexEntry {
+	uint64_t offset;		// of the TrialLogChunkHeader
+	uint32_t rows;
+	uint32_t reserved;
+	double firstTime;
+	double lastTime;
+};
+
+struct TrialLogAnnotation {
+	uint64_t row;			// rows written before the annotation
+	std::string text;
+};
+
+class TrialLog {
+public:
+	TrialLog();
+	~TrialLog();
+
+	bool Open(const std::string& filename, int trial, const char* project, int markers);
+	void Close();
+	bool IsOpen() { return file.is_open(); }
+
+	void Append(double t, int id, float x, float y, float z, const char* contact);
+
+	//All markers of a frame with their IDs
+	void AppendFrame(const MarkerFrame* frame, const char* contact);
+
+	//A line of text kept in order with the rows, e.g. "Final Angle,\t\t93.5"
+	void Annotate(const std::string& text);
+	void Annotate(const char* key, double value);
+
+	uint64_t Rows() { return rows; }
+
+private:
+	void WriteChunk();
+
+	std::ofstream file;
+	uint64_t rows;
+
+	//current chunk, one vector per column
+	std::vector<double> time;
+	std::vector<int32_t> id;
+	std::vector<float> x, y, z;
+	std::vector<char> contact;
+
+	std::vector<TrialLogIndexEntry> index;
+	std::vector<TrialLogAnnotation> annotations;
+};
+
+//One chunk's columns, pointing into the mapped file
+struct TrialLogChunk {
+	int rows;
+	uint64_t firstRow;
+	const double* time;
+	const int32_t* id;
+	const float* x;
+	const float* y;
+	const float* z;
+	const char* contact;	// 4 chars per row, not terminated
+};
+
+class TrialLogReader {
+public:
+	TrialLogReader();
+	~TrialLogReader();
+
+	bool Open(const char* filename);
+	void Close();
+
+	const TrialLogHeader* Header() { return header; }
+	int Chunks() { return (int)chunks.size(); }
+	const TrialLogChunk& Chunk(int i) { return chunks[i]; }
+	uint64_t Rows() { return rows; }
+	const std::vector<TrialLogAnnotation>& Annotations() { return annotations; }
+
+	//False if the footer was missing and the chunks were recovered by scanning
+	bool Complete() { return complete; }
+
+private:
+	bool Map(const char* filename);
+	bool ReadChunk(uint64_t offset, TrialLogChunk* chunk);
+	bool ReadFooter();
+
+	const char* data;
+	uint64_t size;
+	void* mapping;
+
+	const TrialLogHeader* header;
+	std::vector<TrialLogChunk> chunks;
+	std::vector<TrialLogAnnotation> annotations;
+	uint64_t rows;
+	bool complete;
+};
+
+//Writes a trial log out in the CSV layout the app used to write directly
+bool TrialLogToCsv(const char* logFile, const char* csvFile);
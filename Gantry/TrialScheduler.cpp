@@ -0,0 +1,153 @@
+/* ************************************************************
+TrialScheduler.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+#include "MoveDuration.h"
+#include "TrialScheduler.h"
+
+using namespace std;
+
+/*********************************************************************
+
+TrialScheduler
+
+*********************************************************************/
+
+TrialScheduler::TrialScheduler(const MoveDuration* durations)
+	: driftX(0), driftZ(0), priorTrials(2), lookahead(0.5), optimize(true), durations(durations),
+	sumX(0), sumZ(0), observed(0)
+{
+}
+
+int TrialScheduler::Add(float machineX, float machineZ)
+{
+	InitialCondition condition;
+	condition.index = (int)conditions.size();
+	condition.x = machineX;
+	condition.z = machineZ;
+	conditions.push_back(condition);
+	run.push_back(false);
+	return condition.index;
+}
+
+int TrialScheduler::Remaining() const
+{
+	return (int)count(run.begin(), run.end(), false);
+}
+
+void TrialScheduler::Observe(float startX, float startZ, float endX, float endZ)
+{
+	sumX += endX - startX;
+	sumZ += endZ - startZ;
+	observed++;
+}
+
+void TrialScheduler::PredictEnd(const InitialCondition& condition, float* x, float* z) const
+{
+	//the prior drift counts as priorTrials trials until real ones outweigh it
+	double weight = priorTrials + observed;
+	double meanX = driftX, meanZ = driftZ;
+	if (weight > 0) {
+		meanX = (driftX * priorTrials + sumX) / weight;
+		meanZ = (driftZ * priorTrials + sumZ) / weight;
+	}
+	*x = (float)(condition.x + meanX);
+	*z = (float)(condition.z + meanZ);
+}
+
+double TrialScheduler::Cost(float fromX, float fromZ, const InitialCondition& to) const
+{
+	if (durations != NULL) {
+		return durations->Move(to.x - fromX, to.z - fromZ);
+	}
+	return hypot(to.x - fromX, to.z - fromZ);
+}
+
+double TrialScheduler::PathCost(float x, float z, const vector<int>& order) const
+{
+	double total = 0;
+	for (size_t i = 0; i < order.size(); i++) {
+		const InitialCondition& condition = conditions[order[i]];
+		total += ((i == 0) ? 1 : lookahead) * Cost(x, z, condition);
+		PredictEnd(condition, &x, &z);
+	}
+	return total;
+}
+
+vector<int> TrialScheduler::Plan(float x, float z) const
+{
+	//nearest first from where the snake is, then from each predicted end
+	vector<int> order;
+	vector<bool> taken = run;
+	float fromX = x, fromZ = z;
+	int left = Remaining();
+	while (left-- > 0) {
+		int best = -1;
+		double bestCost = 0;
+		for (size_t i = 0; i < conditions.size(); i++) {
+			if (taken[i]) {
+				continue;
+			}
+			double cost = Cost(fromX, fromZ, conditions[i]);
+			if ((best < 0) || (cost < bestCost)) {
+				best = (int)i;
+				bestCost = cost;
+			}
+		}
+		taken[best] = true;
+		order.push_back(best);
+		PredictEnd(conditions[best], &fromX, &fromZ);
+	}
+
+	if (!optimize) {
+		return order;
+	}
+
+	//2-opt; the cost is not symmetric with a drift, so every candidate
+	//order is costed in full
+	double cost = PathCost(x, z, order);
+	bool improved = true;
+	while (improved) {
+		improved = false;
+		for (size_t i = 0; i + 1 < order.size(); i++) {
+			for (size_t j = i + 1; j < order.size(); j++) {
+				reverse(order.begin() + i, order.begin() + j + 1);
+				double reversed = PathCost(x, z, order);
+				if (reversed < cost - 1e-9) {
+					cost = reversed;
+					improved = true;
+				}
+				else {
+					reverse(order.begin() + i, order.begin() + j + 1);
+				}
+			}
+		}
+	}
+	return order;
+}
+
+bool TrialScheduler::Next(float x, float z, InitialCondition* next)
+{
+	vector<int> order = Plan(x, z);
+	if (order.empty()) {
+		return false;
+	}
+	run[order[0]] = true;
+	*next = conditions[order[0]];
+	return true;
+}
+
+bool TrialScheduler::Take(int index, InitialCondition* condition)
+{
+	if ((index < 0) || (index >= (int)conditions.size()) || run[index]) {
+		return false;
+	}
+	run[index] = true;
+	*condition = conditions[index];
+	return true;
+}
@@ -0,0 +1,85 @@
+/* ************************************************************
+TrialScheduler.h
+**************************************************************
+
+Order in which the initial conditions of an experiment are run, chosen
+to keep the gantry's carry from where one trial leaves the snake to the
+start of the next one short.
+
+The design is the set of start positions that must each be run once,
+in machine mm from the tracking origin (X = -Xic, Z = Zic in the app).
+Trials used to take them in design order, so every reset carried the
+snake from wherever it stopped to a start that had nothing to do with
+it.
+
+Where a trial ends is predicted as its start plus the mean displacement
+of the trials seen so far (a prior drift until there are some). The
+cost of running condition b after condition a is the gantry move from
+a's predicted end to b. The pickup leg, from where the gantry is left
+to where the snake stopped, is about the same whatever the order, so
+only the carry is counted. Legs after the next one start from predicted
+ends only, so they count for less.
+
+At every drop-off Next plans the remaining conditions from where the
+snake really is: nearest first, then 2-opt (reversing any stretch of
+the order that makes it shorter) until nothing improves. The first
+condition of that plan is set up and removed from the design, so every
+condition is run exactly once however the plan changes on the way.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class MoveDuration;
+
+struct InitialCondition {
+	int index;			// position in the design
+	float x, z;			// machine mm from the tracking origin
+};
+
+class TrialScheduler {
+public:
+	//Costs are s of gantry move when durations is given, mm otherwise
+	TrialScheduler(const MoveDuration* durations = NULL);
+
+	//Adds a condition to the design, returns its index
+	int Add(float machineX, float machineZ);
+	//Conditions not run yet
+	int Remaining() const;
+	//Condition added as index
+	const InitialCondition& Condition(int index) const { return conditions[index]; }
+
+	//A trial that started at start ended at end (machine mm)
+	void Observe(float startX, float startZ, float endX, float endZ);
+	//Where a trial from condition is expected to leave the snake
+	void PredictEnd(const InitialCondition& condition, float* x, float* z) const;
+
+	//Remaining conditions in the order to run them, the snake at (x, z)
+	std::vector<int> Plan(float x, float z) const;
+	//Cost of running the conditions in order from the snake at (x, z),
+	//legs after the first weighted by lookahead
+	double PathCost(float x, float z, const std::vector<int>& order) const;
+
+	//Condition to set up next with the snake at (x, z); false if the
+	//design is done
+	bool Next(float x, float z, InitialCondition* next);
+	//Marks a condition run without planning, for a start chosen by hand;
+	//false if it has been run already
+	bool Take(int index, InitialCondition* condition);
+
+	float driftX, driftZ;	// mm, displacement expected before any trial is seen
+	int priorTrials;		// trials the drift counts as
+	double lookahead;		// weight of the legs after the next one
+	bool optimize;			// 2-opt after the nearest-first order
+
+private:
+	double Cost(float fromX, float fromZ, const InitialCondition& to) const;
+
+	const MoveDuration* durations;
+	std::vector<InitialCondition> conditions;
+	std::vector<bool> run;
+	double sumX, sumZ;		// mm, displacement summed over the trials seen
+	int observed;
+};
@@ -0,0 +1,170 @@
+/* ************************************************************
+VisualServo.cpp
+**************************************************************
+*/
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+#include "GantryCommand.h"
+#include "SerialDemux.h"
+#include "Trace.h"
+#include "VisualServo.h"
+
+using namespace std;
+
+VisualServo::VisualServo(TrackingBackend* tracking, SerialDemux* SP, GrblStatusPoller* grbl, GantryEstimator* estimator)
+	: jog(false), gain(2), maxSpeed(25), minSpeed(1), tolerance(0.001f), period(0.05), settleTime(0.2), timeout(30),
+	tracking(tracking), SP(SP), grbl(grbl), estimator(estimator)
+{
+}
+
+bool VisualServo::Align(float targetX, float targetZ, ServoResult* result)
+{
+	TraceScope scope("alignment");
+	result->aligned = false;
+	result->jogs = 0;
+	result->moves = 0;
+	result->samples = 0;
+	return jog ? alignByJogs(targetX, targetZ, result) : alignByMoves(targetX, targetZ, result);
+}
+
+bool VisualServo::sample(double now, float targetX, float targetZ, GantryEstimate* estimate, ServoResult* result)
+{
+	Trace::Instant("servo tick");
+	RigidBodyPose pose;
+	GrblStatus status;
+
+	tracking->Update();
+	if (tracking->IsRigidBodyTracked(0)) {
+		tracking->RigidBodyLocation(0, &pose);
+		estimator->AddTracking(now, pose.x, pose.z);
+		result->samples++;
+	}
+	if ((grbl != NULL) && grbl->Latest(&status)) {
+		estimator->AddGrbl(status);
+	}
+
+	if (!estimator->Estimate(now, estimate)) {
+		return false;
+	}
+	result->x = estimate->x;
+	result->z = estimate->z;
+	result->error = hypot(targetX - estimate->x, targetZ - estimate->z);
+	return true;
+}
+
+bool VisualServo::alignByJogs(float targetX, float targetZ, ServoResult* result)
+{
+	double start = GrblClock();
+	double within = -1;
+	chrono::steady_clock::time_point next = chrono::steady_clock::now();
+	GantryEstimate estimate;
+
+	while (true) {
+		double now = GrblClock();
+
+		if (sample(now, targetX, targetZ, &estimate, result)) {
+			float ex = targetX - estimate.x;
+			float ez = targetZ - estimate.z;
+
+			//where the jogs already queued will leave the gantry
+			float px, pz;
+			estimator->Pending(now, &px, &pz);
+			float rx = ex - px, rz = ez - pz;
+			float remaining = sqrt(rx * rx + rz * rz);
+			float queued = sqrt(px * px + pz * pz);
+
+			//on target, nothing left to send and nothing still running
+			if ((result->error < tolerance) && (remaining < tolerance / 4) && (queued < tolerance / 4) && (estimate.Sigma() < tolerance)) {
+				if (within < 0) {
+					within = now;
+				}
+				if (now - within >= settleTime) {
+					result->aligned = true;
+					break;
+				}
+			}
+			else {
+				within = -1;
+			}
+
+			if (remaining >= tolerance / 4) {
+				//one period's worth of travel, never past the target
+				float speed = min(max(gain * remaining * 1000, minSpeed), maxSpeed);
+				float step = min(speed * (float)period, remaining * 1000);
+				float dx = rx / remaining * step / 1000;
+				float dz = rz / remaining * step / 1000;
+				float machineX, machineZ;
+				estimator->calibration.ToMachine(dx, dz, &machineX, &machineZ);
+				SendCommand(SP, GantryCommand::Jog(machineZ, machineX, speed * 60));
+				estimator->AddCommand(now, machineX, machineZ, speed);
+				result->jogs++;
+			}
+		}
+
+		if (now - start > timeout) {
+			break;
+		}
+
+		next += chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(period));
+		this_thread::sleep_until(next);
+	}
+
+	//whatever is still queued is not wanted
+	SendCommand(SP, GantryCommand::JogCancel());
+	result->seconds = GrblClock() - start;
+	return result->aligned;
+}
+
+bool VisualServo::alignByMoves(float targetX, float targetZ, ServoResult* result)
+{
+	double start = GrblClock();
+	double still = start;
+	chrono::steady_clock::time_point next = chrono::steady_clock::now();
+	GantryEstimate estimate;
+	string motionMessage;
+
+	while (true) {
+		double now = GrblClock();
+
+		//only a confident estimate of a head at rest is worth a move
+		if (sample(now, targetX, targetZ, &estimate, result) && (now - still >= settleTime) &&
+			(estimate.Sigma() < tolerance)) {
+			if (result->error < tolerance) {
+				result->aligned = true;
+				break;
+			}
+
+			float machineX, machineZ;
+			estimator->calibration.ToMachine(targetX - estimate.x, targetZ - estimate.z, &machineX, &machineZ);
+			SendCommand(SP, GantryCommand::MoveZX(machineZ, machineX));
+			estimator->AddCommand(now, machineX, machineZ);
+			result->moves++;
+
+			SP->Flush(MESSAGE_MOTION);
+			SendCommand(SP, GantryCommand::Wait());
+			int left = (int)(1000 * (timeout - (GrblClock() - start)));
+			if ((left <= 0) || !SP->Wait(MESSAGE_MOTION, &motionMessage, left)) {
+				break;
+			}
+			still = GrblClock();
+			next = chrono::steady_clock::now();
+			continue;
+		}
+
+		if (now - start > timeout) {
+			break;
+		}
+
+		next += chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(period));
+		this_thread::sleep_until(next);
+	}
+
+	result->seconds = GrblClock() - start;
+	return result->aligned;
+}
@@ -0,0 +1,80 @@
+/* ************************************************************
+VisualServo.h
+**************************************************************
+
+Closed-loop gantry alignment: drives the gantry head onto a target in
+the tracking frame (the midpoint of the snake's contact rigid bodies),
+instead of a staircase of fixed moveX40 nudges with a second of waiting
+after each.
+
+Every period the controller reads rigid body 0 and the latest GRBL
+report into the GantryEstimator. How it then moves the head depends on
+jog.
+
+With jog off (the default), each correction is a relative moveZ..,X..,
+the command the sketch has always run. Once the head has been still for
+settleTime and the estimate is confident, the whole error goes out as
+one move, and the controller waits for "done moving" before it looks
+again. It stops when the estimate is within tolerance.
+
+With jog on, it takes the error between the target and where the
+gantry will be once the jogs already sent have run, and sends one jog
+increment along that error at a speed proportional to it (capped at
+maxSpeed). Increments last one period, so GRBL always has the next one
+queued and the gantry moves continuously, slowing down as it closes in.
+Once the estimate has stayed within tolerance for settleTime the
+remaining jogs are cancelled. This depends on GantryControl.ino (not in
+this tree) passing jogZ..,X..,F.. to GRBL as $J= and jstp as GRBL's jog
+cancel (see GantryCommand.h). Until the sketch on the rig is known to do
+that, leave VISUAL_SERVO_JOGS off in GantryApp.cpp; the sketch ignores
+both and the head would not move.
+
+The tracking backend is read directly, so the TrackingProducer must not
+be running.
+*/
+
+#pragma once
+
+#include "GantryEstimator.h"
+#include "GrblStatus.h"
+#include "SerialDemux.h"
+#include "TrackingBackend.h"
+
+struct ServoResult {
+	bool aligned;
+	float x, z;			// final estimate, m
+	float error;		// m, distance from the target at the end
+	double seconds;
+	int jogs;			// jog increments sent
+	int moves;			// corrective moves sent
+	int samples;		// tracking samples used
+};
+
+class VisualServo {
+public:
+	//grbl may be NULL; the estimator is shared with the rest of the app
+	VisualServo(TrackingBackend* tracking, SerialDemux* SP, GrblStatusPoller* grbl, GantryEstimator* estimator);
+
+	//Drives rigid body 0 onto (targetX, targetZ), false on timeout
+	bool Align(float targetX, float targetZ, ServoResult* result);
+
+	bool jog;			// stream jog increments instead of moves
+	float gain;			// 1/s, approach speed per unit of error
+	float maxSpeed;		// mm/s
+	float minSpeed;		// mm/s, errors that would need slower jogs are left alone
+	float tolerance;	// m
+	double period;		// s between tracking reads and jog increments
+	double settleTime;	// s within tolerance to end the jogs, or still before a move
+	double timeout;		// s
+
+private:
+	//Reads tracking and GRBL into the estimator; false until it has an estimate
+	bool sample(double now, float targetX, float targetZ, GantryEstimate* estimate, ServoResult* result);
+	bool alignByJogs(float targetX, float targetZ, ServoResult* result);
+	bool alignByMoves(float targetX, float targetZ, ServoResult* result);
+
+	TrackingBackend* tracking;
+	SerialDemux* SP;
+	GrblStatusPoller* grbl;
+	GantryEstimator* estimator;
+};